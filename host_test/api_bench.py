@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Banc de charge de l'API HTTP du noeud, côté client.
+
+Envoie des requêtes en boucle sur des connexions keep-alive (une par worker)
+et affiche par route p50 / p99 / max mesurés côté client, puis les mêmes
+centiles vus par le dispatcher (GET /iot/api_stats, remis à zéro au début).
+L'écart entre les deux = réseau + attente dans la tâche httpd.
+
+Le mélange par défaut contient deux POST à corps fixe (luminosité caméra à 0,
+directement puis via /iot/config) : ils passent par le pool de corps et les
+workers async. POST /iot/config écrit en flash à chaque appel ; --get-only
+les retire.
+
+    ./api_bench.py 192.168.4.1 -n 200 -c 4
+    ./api_bench.py node.local --route /iot/ping --route "POST /iot/camera"
+    ./api_bench.py node.local --route "POST /iot/camera" --body /iot/camera='{"contrast":1}'
+
+Bibliothèque standard uniquement.
+"""
+import argparse
+import http.client
+import json
+import sys
+import threading
+import time
+
+DEFAULT_ROUTES = [
+    ("GET", "/iot/ping"),
+    ("GET", "/iot/wifi_sta"),
+    ("GET", "/iot/wifi_status"),
+    ("GET", "/iot/mqtt"),
+    ("GET", "/iot/mqtt_status"),
+    ("GET", "/iot/config"),
+    ("POST", "/iot/camera"),
+    ("POST", "/iot/config"),
+]
+
+# Corps fixes, sans effet visible : la valeur par défaut du capteur
+POST_BODIES = {
+    "/iot/camera": '{"brightness":0}',
+    "/iot/config": '{"camera":{"brightness":0}}',
+}
+
+
+def parse_route(spec):
+    """"/iot/ping" ou "POST /iot/camera" -> (méthode, chemin)"""
+    parts = spec.split(None, 1)
+    if len(parts) == 2:
+        return parts[0].upper(), parts[1]
+    return "GET", spec
+
+
+def route_label(route):
+    method, path = route
+    return path if method == "GET" else f"{method} {path}"
+
+
+def percentile(samples, q):
+    if not samples:
+        return 0
+    ordered = sorted(samples)
+    index = max(0, min(len(ordered) - 1, (len(ordered) * q + 99) // 100 - 1))
+    return ordered[index]
+
+
+class Worker(threading.Thread):
+    def __init__(self, host, port, routes, bodies, count, timeout):
+        super().__init__(daemon=True)
+        self.host, self.port, self.routes, self.bodies = host, port, routes, bodies
+        self.count, self.timeout = count, timeout
+        self.latency = {r: [] for r in routes}
+        self.errors = {r: 0 for r in routes}
+
+    def connect(self):
+        return http.client.HTTPConnection(self.host, self.port, timeout=self.timeout)
+
+    def run(self):
+        conn = self.connect()
+        for i in range(self.count):
+            route = self.routes[i % len(self.routes)]
+            method, path = route
+            body = self.bodies.get(path) if method == "POST" else None
+            headers = {"Content-Type": "application/json"} if body is not None else {}
+            start = time.perf_counter()
+            try:
+                conn.request(method, path, body=body, headers=headers)
+                resp = conn.getresponse()
+                resp.read()
+                ok = resp.status < 400
+            except (OSError, http.client.HTTPException):
+                ok = False
+                conn.close()
+                conn = self.connect()
+            elapsed_us = int((time.perf_counter() - start) * 1e6)
+            if ok:
+                self.latency[route].append(elapsed_us)
+            else:
+                self.errors[route] += 1
+        conn.close()
+
+
+def fetch_json(host, port, path, timeout):
+    conn = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        conn.request("GET", path)
+        resp = conn.getresponse()
+        body = resp.read()
+        return json.loads(body) if resp.status == 200 else None
+    except (OSError, http.client.HTTPException, ValueError):
+        return None
+    finally:
+        conn.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("-n", "--requests", type=int, default=100, help="requêtes par worker")
+    parser.add_argument("-c", "--concurrency", type=int, default=2)
+    parser.add_argument("--route", action="append", dest="routes",
+                        help='"/chemin" ou "POST /chemin", répétable (défaut : GET courants + 2 POST)')
+    parser.add_argument("--body", action="append", default=[], metavar="CHEMIN=JSON",
+                        help="corps d'un POST, répétable")
+    parser.add_argument("--get-only", action="store_true", help="retire les POST du mélange")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    args = parser.parse_args()
+    routes = [parse_route(r) for r in args.routes] if args.routes else DEFAULT_ROUTES
+    if args.get_only:
+        routes = [r for r in routes if r[0] == "GET"]
+    bodies = dict(POST_BODIES)
+    for spec in args.body:
+        path, sep, body = spec.partition("=")
+        if not sep:
+            parser.error(f"--body {spec!r}: CHEMIN=JSON attendu")
+        bodies[path] = body
+    for method, path in routes:
+        if method == "POST" and path not in bodies:
+            parser.error(f"POST {path}: pas de corps, utiliser --body {path}=...")
+    if not routes:
+        parser.error("aucune route")
+
+    if fetch_json(args.host, args.port, "/iot/api_stats?reset=1", args.timeout) is None:
+        print("warning: /iot/api_stats unreachable, device-side figures unavailable", file=sys.stderr)
+
+    workers = [Worker(args.host, args.port, routes, bodies, args.requests, args.timeout)
+               for _ in range(args.concurrency)]
+    start = time.perf_counter()
+    for w in workers:
+        w.start()
+    for w in workers:
+        w.join()
+    wall = time.perf_counter() - start
+
+    device = (fetch_json(args.host, args.port, "/iot/api_stats", args.timeout) or {}).get("routes", {})
+
+    total = 0
+    print(f"{'route':<24} {'n':>6} {'err':>4} {'p50_us':>8} {'p99_us':>8} {'max_us':>8} | "
+          f"{'dev_p50':>8} {'dev_p99':>8} {'dev_max':>8}")
+    for route in routes:
+        samples = [s for w in workers for s in w.latency[route]]
+        errors = sum(w.errors[route] for w in workers)
+        total += len(samples) + errors
+        dev = device.get(route[1], {}).get(route[0], {})
+        print(f"{route_label(route):<24} {len(samples):>6} {errors:>4} {percentile(samples, 50):>8} "
+              f"{percentile(samples, 99):>8} {max(samples, default=0):>8} | "
+              f"{dev.get('p50_us', '-'):>8} {dev.get('p99_us', '-'):>8} {dev.get('max_us', '-'):>8}")
+    print(f"{total} requests in {wall:.2f} s ({total / wall:.1f} req/s, {args.concurrency} connections)")
+    return 0 if all(not any(w.errors.values()) for w in workers) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
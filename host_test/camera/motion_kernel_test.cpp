@@ -0,0 +1,191 @@
+/**
+ * motion::diff / motion::update_reference sur des grilles synthétiques de la
+ * taille de la sortie DC (QVGA / 8 = 40x30), mêmes paramètres que motion.cpp
+ * (blocs 4x4, seuil par défaut 12, référence à 1/4) :
+ *   scène statique bruitée     : aucun bloc changé
+ *   décalage global de lumière : compensé, aucun bloc changé
+ *   bloc qui se déplace        : exactement les blocs quittés et atteints
+ * puis convergence de la référence glissante.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "motion_kernel.h"
+
+using namespace camera;
+
+static int s_failures = 0;
+
+#define CHECK(cond)                                                   \
+    do                                                                \
+    {                                                                 \
+        if (!(cond))                                                  \
+        {                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            s_failures++;                                             \
+        }                                                             \
+    } while (0)
+
+namespace
+{
+    constexpr uint16_t W = 40;
+    constexpr uint16_t H = 30;
+    constexpr uint8_t BLOCK = 4;
+    constexpr uint8_t THRESHOLD = 12;
+    constexpr uint8_t SHIFT = 2;
+    using Grid = std::vector<uint8_t>;
+
+    uint8_t clamp(int v)
+    {
+        return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+
+    // Scène texturée (dégradés + motif), entre 40 et 200 : marge pour les décalages
+    Grid scene()
+    {
+        Grid g(W * H);
+        for (int y = 0; y < H; ++y)
+            for (int x = 0; x < W; ++x)
+                g[y * W + x] = (uint8_t)(40 + (x * 3 + y * 2) % 120 + ((x / 5 + y / 3) % 2) * 40);
+        return g;
+    }
+
+    // Bruit capteur ±amp, déterministe
+    Grid noisy(const Grid &src, int amp, unsigned seed)
+    {
+        srand(seed);
+        Grid g(src);
+        for (auto &p : g)
+            p = clamp(p + rand() % (2 * amp + 1) - amp);
+        return g;
+    }
+
+    Grid shifted(const Grid &src, int delta)
+    {
+        Grid g(src);
+        for (auto &p : g)
+            p = clamp(p + delta);
+        return g;
+    }
+
+    // Carré de size pixels à (x0, y0), niveau level
+    Grid with_square(const Grid &src, int x0, int y0, int size, uint8_t level)
+    {
+        Grid g(src);
+        for (int y = y0; y < y0 + size; ++y)
+            for (int x = x0; x < x0 + size; ++x)
+                g[y * W + x] = level;
+        return g;
+    }
+
+    motion::Result run(const Grid &ref, const Grid &cur)
+    {
+        return motion::diff(ref.data(), cur.data(), W, H, BLOCK, THRESHOLD);
+    }
+}
+
+static void test_static_scene()
+{
+    Grid ref = scene();
+    motion::Result same = run(ref, ref);
+    CHECK(same.total_blocks == (W / BLOCK) * (H / BLOCK));
+    CHECK(same.changed_blocks == 0);
+    CHECK(same.max_block_diff == 0);
+
+    for (unsigned seed = 1; seed <= 10; ++seed)
+    {
+        motion::Result r = run(ref, noisy(ref, 4, seed));
+        CHECK(r.changed_blocks == 0);
+        CHECK(r.max_block_diff <= 4u * 16);
+    }
+}
+
+static void test_brightness_shift()
+{
+    Grid ref = scene();
+    for (int delta : {-30, -12, 13, 25, 50})
+    {
+        motion::Result r = run(ref, shifted(ref, delta));
+        CHECK(r.changed_blocks == 0);
+        // compensation au 1/16 de niveau près
+        CHECK(r.max_block_diff <= 16);
+
+        motion::Result n = run(ref, noisy(shifted(ref, delta), 3, 100 + delta));
+        CHECK(n.changed_blocks == 0);
+    }
+    printf("brightness_shift: compensated up to +50 levels\n");
+}
+
+static void test_moving_block()
+{
+    Grid bg = scene();
+    // carré 8x8 aligné : 2x2 blocs, déplacé de 12 pixels vers la droite
+    Grid ref = with_square(bg, 8, 12, 8, 250);
+    Grid cur = with_square(bg, 20, 12, 8, 250);
+    motion::Result r = run(ref, cur);
+    // 4 blocs quittés + 4 blocs atteints
+    CHECK(r.changed_blocks == 8);
+    CHECK(r.max_block_diff > (uint32_t)THRESHOLD * 16);
+
+    // même mouvement avec bruit et variation de lumière
+    motion::Result n = run(ref, noisy(shifted(cur, 15), 3, 7));
+    CHECK(n.changed_blocks == 8);
+
+    // petit objet non aligné : au moins le bloc qui le contient
+    Grid dot = with_square(bg, 30, 5, 3, 250);
+    motion::Result d = run(bg, dot);
+    CHECK(d.changed_blocks >= 1 && d.changed_blocks <= 4);
+    printf("moving_block: %u/%u blocks changed, max diff %u/16\n", (unsigned)r.changed_blocks,
+           (unsigned)r.total_blocks, (unsigned)r.max_block_diff);
+}
+
+static void test_update_reference()
+{
+    Grid bg = scene();
+    Grid ref = with_square(bg, 8, 12, 8, 250);
+    Grid cur = with_square(bg, 20, 12, 8, 250);
+
+    // l'objet arrêté est absorbé par la référence : plus de mouvement après quelques images
+    int frames = 0;
+    while (run(ref, cur).changed_blocks > 0 && frames < 50)
+    {
+        motion::update_reference(ref.data(), cur.data(), ref.size(), SHIFT);
+        frames++;
+    }
+    CHECK(frames > 1);
+    CHECK(frames < 10);
+
+    // convergence exacte (arrondi vers cur)
+    for (int i = 0; i < 50; ++i)
+        motion::update_reference(ref.data(), cur.data(), ref.size(), SHIFT);
+    CHECK(ref == cur);
+
+    // shift 0 : copie
+    Grid copy = scene();
+    motion::update_reference(copy.data(), cur.data(), copy.size(), 0);
+    CHECK(copy == cur);
+    printf("update_reference: stopped object absorbed after %d frames\n", frames);
+}
+
+static void test_degenerate()
+{
+    Grid g = scene();
+    CHECK(motion::diff(g.data(), g.data(), W, H, 0, THRESHOLD).total_blocks == 0);
+    CHECK(motion::diff(g.data(), g.data(), 3, 3, BLOCK, THRESHOLD).total_blocks == 0);
+    // bords partiels ignorés : 42x30 -> toujours 10x7 blocs
+    Grid wide(42 * 30, 100);
+    CHECK(motion::diff(wide.data(), wide.data(), 42, 30, BLOCK, THRESHOLD).total_blocks == 70);
+}
+
+int main()
+{
+    test_static_scene();
+    test_brightness_shift();
+    test_moving_block();
+    test_update_reference();
+    test_degenerate();
+    if (s_failures)
+        fprintf(stderr, "%d check(s) failed\n", s_failures);
+    return s_failures ? 1 : 0;
+}
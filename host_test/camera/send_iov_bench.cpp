@@ -0,0 +1,240 @@
+/**
+ * Banc du cadrage MJPEG sur TCP loopback, source d'images factice :
+ *   three_send : ancien code, send() pour l'en-tête, le JPEG puis "\r\n"
+ *   sendmsg    : send_all_iov sur un vecteur de 3 éléments (camera.cpp)
+ * avec et sans Nagle. Le socket émetteur est réglé comme lwIP (MSS 1436,
+ * petit buffer d'envoi) ; un lecteur vide la connexion au plus vite.
+ *
+ * Par image : appels système d'envoi, attentes de place, segments TCP
+ * (tcpi_data_segs_out) et temps d'envoi. Le flux reçu est vérifié.
+ *
+ *   send_iov_bench [--quick] [--frames N]
+ */
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "send_iov.h"
+
+using camera::send_all_iov;
+using camera::WriteCounters;
+
+namespace
+{
+    constexpr int LWIP_MSS = 1436;
+    constexpr int LWIP_SND_BUF = 4 * LWIP_MSS;
+    constexpr int64_t DEADLINE_US = 3 * 1000 * 1000;
+
+    uint64_t fnv1a(uint64_t h, const void *data, size_t len)
+    {
+        auto *p = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < len; ++i)
+            h = (h ^ p[i]) * 0x100000001b3ULL;
+        return h;
+    }
+    constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+
+    // Images de 12 à 40 Ko, contenu pseudo-aléatoire (peu compressible comme un JPEG)
+    std::vector<std::string> fake_frames(size_t count)
+    {
+        std::vector<std::string> frames;
+        uint32_t x = 12345;
+        for (size_t i = 0; i < count; ++i)
+        {
+            x = x * 1103515245 + 12345;
+            std::string f(12 * 1024 + (x >> 8) % (28 * 1024), '\0');
+            for (auto &c : f)
+            {
+                x = x * 1103515245 + 12345;
+                c = (char)(x >> 16);
+            }
+            f[0] = (char)0xFF, f[1] = (char)0xD8;
+            f[f.size() - 2] = (char)0xFF, f[f.size() - 1] = (char)0xD9;
+            frames.push_back(std::move(f));
+        }
+        return frames;
+    }
+
+    // Ancien send_all de camera.cpp (un tampon, reprise sur EAGAIN) : send_all_iov
+    // sur un seul élément fait les mêmes appels et tient les mêmes compteurs
+    bool legacy_send_all(int fd, const void *data, size_t len, int64_t deadline_us, WriteCounters &counters)
+    {
+        struct iovec iov = {.iov_base = const_cast<void *>(data), .iov_len = len};
+        return send_all_iov(fd, &iov, 1, deadline_us, counters);
+    }
+
+    struct Connection
+    {
+        int tx = -1; // côté noeud (accept)
+        int rx = -1; // côté client
+    };
+
+    Connection connect_loopback(bool nodelay)
+    {
+        Connection c;
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        int mss = LWIP_MSS;
+        setsockopt(listener, IPPROTO_TCP, TCP_MAXSEG, &mss, sizeof(mss));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addr_len = sizeof(addr);
+        if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0 ||
+            getsockname(listener, (struct sockaddr *)&addr, &addr_len) != 0)
+        {
+            perror("listen");
+            exit(2);
+        }
+        c.rx = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(c.rx, IPPROTO_TCP, TCP_MAXSEG, &mss, sizeof(mss));
+        if (connect(c.rx, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            perror("connect");
+            exit(2);
+        }
+        c.tx = accept(listener, nullptr, nullptr);
+        close(listener);
+        int sndbuf = LWIP_SND_BUF;
+        setsockopt(c.tx, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        int flag = nodelay ? 1 : 0;
+        setsockopt(c.tx, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        return c;
+    }
+
+    uint32_t data_segs_out(int fd)
+    {
+        struct tcp_info info = {};
+        socklen_t len = sizeof(info);
+        if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0)
+            return 0;
+        return info.tcpi_data_segs_out;
+    }
+
+    struct Result
+    {
+        size_t frames = 0;
+        uint64_t bytes = 0;
+        uint32_t calls = 0;
+        uint32_t waits = 0;
+        uint32_t segments = 0;
+        int64_t send_us = 0;
+        bool ok = false;
+    };
+
+    Result run(const std::vector<std::string> &frames, bool vectored, bool nodelay)
+    {
+        Connection c = connect_loopback(nodelay);
+        uint64_t received_hash = FNV_OFFSET;
+        uint64_t received_bytes = 0;
+        std::thread reader([&]
+                           {
+                               char buf[16384];
+                               ssize_t n;
+                               while ((n = read(c.rx, buf, sizeof(buf))) > 0)
+                               {
+                                   received_hash = fnv1a(received_hash, buf, n);
+                                   received_bytes += n;
+                               } });
+
+        Result r;
+        uint64_t sent_hash = FNV_OFFSET;
+        uint32_t segs_before = data_segs_out(c.tx);
+        char headers[256];
+        static const char TRAILER[] = "\r\n";
+        r.ok = true;
+        for (const auto &f : frames)
+        {
+            int hdr_len = snprintf(headers, sizeof(headers),
+                                   "--%s\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
+                                   "frame", (unsigned)f.size());
+            WriteCounters counters;
+            int64_t start = esp_timer_get_time();
+            int64_t deadline = start + DEADLINE_US;
+            bool ok;
+            if (vectored)
+            {
+                struct iovec iov[3] = {
+                    {.iov_base = headers, .iov_len = (size_t)hdr_len},
+                    {.iov_base = const_cast<char *>(f.data()), .iov_len = f.size()},
+                    {.iov_base = const_cast<char *>(TRAILER), .iov_len = sizeof(TRAILER) - 1},
+                };
+                ok = send_all_iov(c.tx, iov, 3, deadline, counters);
+            }
+            else
+            {
+                ok = legacy_send_all(c.tx, headers, hdr_len, deadline, counters) &&
+                     legacy_send_all(c.tx, f.data(), f.size(), deadline, counters) &&
+                     legacy_send_all(c.tx, TRAILER, sizeof(TRAILER) - 1, deadline, counters);
+            }
+            r.send_us += esp_timer_get_time() - start;
+            if (!ok)
+            {
+                r.ok = false;
+                break;
+            }
+            sent_hash = fnv1a(sent_hash, headers, hdr_len);
+            sent_hash = fnv1a(sent_hash, f.data(), f.size());
+            sent_hash = fnv1a(sent_hash, TRAILER, sizeof(TRAILER) - 1);
+            r.frames++;
+            r.bytes += hdr_len + f.size() + sizeof(TRAILER) - 1;
+            r.calls += counters.calls;
+            r.waits += counters.waits;
+        }
+        // le lecteur a tout reçu une fois la connexion fermée : compte final
+        shutdown(c.tx, SHUT_WR);
+        reader.join();
+        r.segments = data_segs_out(c.tx) - segs_before;
+        close(c.tx);
+        close(c.rx);
+        r.ok = r.ok && received_bytes == r.bytes && received_hash == sent_hash;
+        return r;
+    }
+
+    void print(const char *name, bool nodelay, const Result &r)
+    {
+        double n = r.frames ? (double)r.frames : 1;
+        printf("%-10s %-7s %7zu %8.2f %7.2f %8.2f %9.1f %8.1f  %s\n", name, nodelay ? "nodelay" : "nagle",
+               r.frames, r.calls / n, r.waits / n, r.segments / n, r.send_us / n,
+               r.send_us ? r.bytes / (double)r.send_us : 0, r.ok ? "ok" : "FAILED");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    signal(SIGPIPE, SIG_IGN);
+    size_t count = 2000;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--quick") == 0)
+            count = 200;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            count = strtoul(argv[++i], nullptr, 10);
+    }
+    std::vector<std::string> frames = fake_frames(count);
+
+    printf("%-10s %-7s %7s %8s %7s %8s %9s %8s\n", "framing", "tcp", "frames", "calls/f", "waits/f",
+           "segs/f", "us/frame", "MB/s");
+    bool all_ok = true;
+    for (bool nodelay : {false, true})
+    {
+        Result legacy = run(frames, false, nodelay);
+        Result vectored = run(frames, true, nodelay);
+        print("three_send", nodelay, legacy);
+        print("sendmsg", nodelay, vectored);
+        all_ok = all_ok && legacy.ok && vectored.ok;
+        // hors attentes, un appel par image contre trois au minimum
+        all_ok = all_ok && vectored.calls - vectored.waits < legacy.calls - legacy.waits;
+    }
+    if (!all_ok)
+        fprintf(stderr, "stream mismatch or no syscall reduction\n");
+    return all_ok ? 0 : 1;
+}
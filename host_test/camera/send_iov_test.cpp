@@ -0,0 +1,174 @@
+/**
+ * send_all_iov sur un socketpair au buffer d'envoi minimal : le lecteur vide
+ * lentement, chaque sendmsg est partiel et la plupart renvoient EAGAIN. On
+ * vérifie que le flux reçu est exactement en-tête + image + fin, que les
+ * reprises traversent les frontières du vecteur, et que l'échéance ou un
+ * pair fermé arrêtent l'envoi.
+ */
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "send_iov.h"
+
+using camera::send_all_iov;
+using camera::WriteCounters;
+
+static int s_failures = 0;
+
+#define CHECK(cond)                                                   \
+    do                                                                \
+    {                                                                 \
+        if (!(cond))                                                  \
+        {                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            s_failures++;                                             \
+        }                                                             \
+    } while (0)
+
+static void make_pair(int fds[2], int buf_size)
+{
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        perror("socketpair");
+        _exit(2);
+    }
+    // le noyau arrondit au minimum autorisé : assez petit pour forcer des envois partiels
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+}
+
+// Lecteur lent : petits read espacés, jusqu'à la fermeture
+static std::string slow_read(int fd, size_t chunk, int pause_us)
+{
+    std::string out;
+    char buf[4096];
+    if (chunk > sizeof(buf))
+        chunk = sizeof(buf);
+    while (true)
+    {
+        ssize_t n = read(fd, buf, chunk);
+        if (n <= 0)
+            break;
+        out.append(buf, n);
+        std::this_thread::sleep_for(std::chrono::microseconds(pause_us));
+    }
+    return out;
+}
+
+static void test_partial_writes()
+{
+    int fds[2];
+    make_pair(fds, 1024);
+
+    std::string header = "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: 200000\r\n\r\n";
+    std::string jpeg(200000, '\0');
+    for (size_t i = 0; i < jpeg.size(); ++i)
+        jpeg[i] = (char)(i * 31 + (i >> 8));
+    std::string trailer = "\r\n";
+
+    std::string received;
+    std::thread reader([&]
+                       { received = slow_read(fds[1], 1500, 50); });
+
+    struct iovec iov[3] = {
+        {.iov_base = header.data(), .iov_len = header.size()},
+        {.iov_base = jpeg.data(), .iov_len = jpeg.size()},
+        {.iov_base = trailer.data(), .iov_len = trailer.size()},
+    };
+    WriteCounters counters;
+    bool ok = send_all_iov(fds[0], iov, 3, esp_timer_get_time() + 20 * 1000 * 1000, counters);
+    close(fds[0]);
+    reader.join();
+    close(fds[1]);
+
+    CHECK(ok);
+    CHECK(received == header + jpeg + trailer);
+    CHECK(counters.calls > 1);
+    CHECK(counters.waits > 0);
+    printf("partial_writes: %zu bytes, %u sendmsg, %u waits\n", received.size(),
+           (unsigned)counters.calls, (unsigned)counters.waits);
+}
+
+// Coupure au milieu d'un élément du vecteur : la reprise part du bon octet
+static void test_iov_boundaries()
+{
+    for (int buf : {1024, 2048, 4096})
+    {
+        int fds[2];
+        make_pair(fds, buf);
+        std::string parts[] = {std::string(777, 'a'), std::string(1, 'b'), std::string(5000, 'c'),
+                               std::string(3, 'd'), std::string(65536, 'e')};
+        std::string expected;
+        struct iovec iov[5];
+        for (int i = 0; i < 5; ++i)
+        {
+            iov[i] = {.iov_base = parts[i].data(), .iov_len = parts[i].size()};
+            expected += parts[i];
+        }
+        std::string received;
+        std::thread reader([&]
+                           { received = slow_read(fds[1], 333, 10); });
+        WriteCounters counters;
+        bool ok = send_all_iov(fds[0], iov, 5, esp_timer_get_time() + 20 * 1000 * 1000, counters);
+        close(fds[0]);
+        reader.join();
+        close(fds[1]);
+        CHECK(ok);
+        CHECK(received == expected);
+    }
+}
+
+// Lecteur absent : l'envoi doit abandonner à l'échéance, pas bloquer
+static void test_deadline()
+{
+    int fds[2];
+    make_pair(fds, 1024);
+    std::string data(1 << 20, 'x');
+    struct iovec iov = {.iov_base = data.data(), .iov_len = data.size()};
+    WriteCounters counters;
+    int64_t start = esp_timer_get_time();
+    bool ok = send_all_iov(fds[0], &iov, 1, start + 200 * 1000, counters);
+    int64_t elapsed = esp_timer_get_time() - start;
+    close(fds[0]);
+    close(fds[1]);
+
+    CHECK(!ok);
+    CHECK(elapsed >= 200 * 1000);
+    CHECK(elapsed < 1000 * 1000);
+    CHECK(counters.waits > 0);
+}
+
+// Pair fermé : erreur autre que EAGAIN, retour immédiat
+static void test_peer_closed()
+{
+    int fds[2];
+    make_pair(fds, 1024);
+    close(fds[1]);
+    std::string data(4096, 'x');
+    struct iovec iov = {.iov_base = data.data(), .iov_len = data.size()};
+    WriteCounters counters;
+    int64_t start = esp_timer_get_time();
+    bool ok = send_all_iov(fds[0], &iov, 1, start + 5 * 1000 * 1000, counters);
+    close(fds[0]);
+
+    CHECK(!ok);
+    CHECK(esp_timer_get_time() - start < 1000 * 1000);
+}
+
+int main()
+{
+    // lwIP n'envoie pas de SIGPIPE ; Linux oui
+    signal(SIGPIPE, SIG_IGN);
+    test_partial_writes();
+    test_iov_boundaries();
+    test_deadline();
+    test_peer_closed();
+    if (s_failures)
+        fprintf(stderr, "%d check(s) failed\n", s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,310 @@
+#include "broker_stub.h"
+#include <atomic>
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+#include "esp_timer.h"
+#include "mqtt_client.h"
+
+namespace
+{
+    struct Message
+    {
+        std::string topic;
+        std::string payload;
+        int qos;
+        int64_t due_us;
+    };
+
+    std::mutex s_config_mutex;
+    broker_stub::Config s_config;
+    broker_stub::Stats s_stats = {};
+
+    thread_local bool t_in_handler = false;
+    std::atomic<uint32_t> s_dispatch_allocs{0};
+}
+
+void *operator new(size_t size)
+{
+    if (t_in_handler)
+        s_dispatch_allocs++;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+struct esp_mqtt_client
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    esp_event_handler_t handler = nullptr;
+    void *handler_arg = nullptr;
+    bool persistent = false;
+
+    bool running = false;
+    bool connected = false;
+    int64_t connect_at_us = -1; // connexion planifiée
+    bool notify_disconnect = false;
+    bool session = false; // session broker existante
+    std::set<std::string> subscriptions;
+    std::deque<Message> in_flight;
+    std::deque<Message> outbox;
+    std::atomic<int> next_msg_id{1};
+    std::thread task;
+};
+
+namespace broker_stub
+{
+    void configure(const Config &config)
+    {
+        std::lock_guard<std::mutex> lock(s_config_mutex);
+        s_config = config;
+    }
+
+    Stats stats()
+    {
+        std::lock_guard<std::mutex> lock(s_config_mutex);
+        Stats s = s_stats;
+        s.dispatch_allocs = s_dispatch_allocs;
+        return s;
+    }
+
+    void reset_stats()
+    {
+        std::lock_guard<std::mutex> lock(s_config_mutex);
+        s_stats = {};
+        s_dispatch_allocs = 0;
+    }
+}
+
+static broker_stub::Config config()
+{
+    std::lock_guard<std::mutex> lock(s_config_mutex);
+    return s_config;
+}
+
+static void count(uint32_t broker_stub::Stats::*field, uint32_t n = 1)
+{
+    std::lock_guard<std::mutex> lock(s_config_mutex);
+    s_stats.*field += n;
+}
+
+static void dispatch(esp_mqtt_client *c, esp_mqtt_event_t &event)
+{
+    event.client = c;
+    t_in_handler = true;
+    c->handler(c->handler_arg, "MQTT_EVENTS", event.event_id, &event);
+    t_in_handler = false;
+}
+
+// mutex tenu ; message routé vers l'abonné (le client lui-même : boucle locale)
+static void route(esp_mqtt_client *c, const char *topic, const char *data, int len, int qos)
+{
+    if (!c->subscriptions.count(topic))
+        return;
+    c->in_flight.push_back({topic, std::string(data, len), qos, esp_timer_get_time() + config().latency_us});
+    c->cv.notify_all();
+}
+
+// "Tâche MQTT" : un seul thread livre tous les événements
+static void client_task(esp_mqtt_client *c)
+{
+    std::unique_lock<std::mutex> lock(c->mutex);
+    while (c->running)
+    {
+        int64_t now = esp_timer_get_time();
+        if (c->notify_disconnect)
+        {
+            c->notify_disconnect = false;
+            esp_mqtt_event_t event = {};
+            event.event_id = MQTT_EVENT_DISCONNECTED;
+            lock.unlock();
+            dispatch(c, event);
+            lock.lock();
+            continue;
+        }
+        if (!c->connected && c->connect_at_us >= 0 && now >= c->connect_at_us)
+        {
+            c->connect_at_us = -1;
+            c->connected = true;
+            bool present = c->persistent && c->session;
+            if (!present)
+                c->subscriptions.clear();
+            c->session = true;
+            // l'outbox part dès la connexion, avant les nouvelles publications
+            for (Message &m : c->outbox)
+                route(c, m.topic.c_str(), m.payload.data(), (int)m.payload.size(), m.qos);
+            c->outbox.clear();
+            count(&broker_stub::Stats::connects);
+
+            esp_mqtt_event_t event = {};
+            event.event_id = MQTT_EVENT_CONNECTED;
+            event.session_present = present;
+            lock.unlock();
+            dispatch(c, event);
+            lock.lock();
+            continue;
+        }
+        if (c->connected && !c->in_flight.empty() && c->in_flight.front().due_us <= now)
+        {
+            Message m = std::move(c->in_flight.front());
+            c->in_flight.pop_front();
+            esp_mqtt_event_t event = {};
+            event.event_id = MQTT_EVENT_DATA;
+            event.topic = m.topic.data();
+            event.topic_len = (int)m.topic.size();
+            event.data = m.payload.data();
+            event.data_len = (int)m.payload.size();
+            event.qos = m.qos;
+            count(&broker_stub::Stats::delivered);
+            lock.unlock();
+            dispatch(c, event);
+            lock.lock();
+            continue;
+        }
+
+        int64_t next = now + 10000;
+        if (c->connect_at_us >= 0 && c->connect_at_us < next)
+            next = c->connect_at_us;
+        if (c->connected && !c->in_flight.empty() && c->in_flight.front().due_us < next)
+            next = c->in_flight.front().due_us;
+        c->cv.wait_for(lock, std::chrono::microseconds(next > now ? next - now : 0));
+    }
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *cfg)
+{
+    auto *c = new esp_mqtt_client();
+    c->persistent = cfg->session.disable_clean_session;
+    return c;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t, esp_event_handler_t handler, void *arg)
+{
+    std::lock_guard<std::mutex> lock(c->mutex);
+    c->handler = handler;
+    c->handler_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t c)
+{
+    std::lock_guard<std::mutex> lock(c->mutex);
+    if (c->running)
+        return ESP_FAIL;
+    c->running = true;
+    c->connect_at_us = esp_timer_get_time() + (int64_t)config().connect_delay_ms * 1000;
+    c->task = std::thread(client_task, c);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t c)
+{
+    {
+        std::lock_guard<std::mutex> lock(c->mutex);
+        c->running = false;
+        c->cv.notify_all();
+    }
+    if (c->task.joinable())
+        c->task.join();
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t c)
+{
+    esp_mqtt_client_stop(c);
+    delete c;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t c)
+{
+    std::lock_guard<std::mutex> lock(c->mutex);
+    if (!c->connected)
+        return ESP_FAIL;
+    c->connected = false;
+    c->notify_disconnect = true;
+    // le broker garde le QoS 1 d'une session persistante, le reste est perdu
+    size_t before = c->in_flight.size();
+    if (c->persistent)
+    {
+        std::deque<Message> kept;
+        for (Message &m : c->in_flight)
+            if (m.qos > 0)
+                kept.push_back(std::move(m));
+        c->in_flight.swap(kept);
+    }
+    else
+    {
+        c->in_flight.clear();
+    }
+    count(&broker_stub::Stats::dropped_qos0, (uint32_t)(before - c->in_flight.size()));
+    count(&broker_stub::Stats::disconnects);
+    c->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t c)
+{
+    std::lock_guard<std::mutex> lock(c->mutex);
+    if (c->connected || c->connect_at_us >= 0)
+        return ESP_FAIL;
+    c->connect_at_us = esp_timer_get_time() + (int64_t)config().connect_delay_ms * 1000;
+    c->cv.notify_all();
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t c, const char *topic, const char *data, int len, int qos, int)
+{
+    // l'écriture bloque l'appelant, comme un send() sur une socket saturée
+    uint32_t write_us = config().write_us;
+    if (write_us)
+        std::this_thread::sleep_for(std::chrono::microseconds(write_us));
+    std::lock_guard<std::mutex> lock(c->mutex);
+    if (!c->connected)
+        return -1;
+    if (len <= 0)
+        len = (int)strlen(data);
+    route(c, topic, data, len, qos);
+    count(&broker_stub::Stats::accepted);
+    return c->next_msg_id++;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t c, const char *topic, const char *data, int len, int qos, int, bool)
+{
+    std::lock_guard<std::mutex> lock(c->mutex);
+    if (len <= 0)
+        len = (int)strlen(data);
+    if (c->connected)
+        route(c, topic, data, len, qos);
+    else
+        c->outbox.push_back({topic, std::string(data, len), qos, 0});
+    count(&broker_stub::Stats::outbox);
+    return c->next_msg_id++;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t c, const char *topic, int)
+{
+    std::lock_guard<std::mutex> lock(c->mutex);
+    if (!c->connected)
+        return -1;
+    c->subscriptions.insert(topic);
+    return c->next_msg_id++;
+}
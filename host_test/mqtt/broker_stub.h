@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Broker MQTT de substitution, dans le process : implémente l'API esp-mqtt
+ * utilisée par MqttClient. Une "tâche MQTT" (thread) livre les événements
+ * CONNECTED / DISCONNECTED / DATA au handler enregistré, dans l'ordre, comme
+ * esp-mqtt. Un message publié sur un topic abonné revient après latency_us.
+ *
+ * Session persistante (disable_clean_session) : abonnements et messages QoS 1
+ * en vol sont conservés à travers une reconnexion ; QoS 0 en vol est perdu.
+ *
+ * operator new est remplacé pour compter les allocations faites par le
+ * handler d'événements du client (dispatch_allocs).
+ */
+namespace broker_stub
+{
+    struct Config
+    {
+        uint32_t latency_us = 2000;      // aller-retour broker
+        uint32_t connect_delay_ms = 20;  // (re)connexion
+        uint32_t write_us = 0;           // durée d'un publish (socket lente)
+    };
+
+    struct Stats
+    {
+        uint32_t accepted;      // publish acceptés connecté
+        uint32_t outbox;        // enqueue hors connexion
+        uint32_t delivered;     // événements DATA livrés
+        uint32_t dropped_qos0;  // perdus à la déconnexion
+        uint32_t connects;
+        uint32_t disconnects;
+        uint32_t dispatch_allocs; // operator new appelés pendant le handler du client
+    };
+
+    void configure(const Config &config);
+    Stats stats();
+    void reset_stats();
+}
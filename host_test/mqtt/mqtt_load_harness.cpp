@@ -0,0 +1,308 @@
+/**
+ * Charge MQTT sur l'hôte : le vrai MqttClient (queue, tâche de publication,
+ * dispatch, reprise de session) contre le broker de substitution.
+ *
+ * Même protocole que MqttLoadGen : {"run","seq","t","pad"} publié sur un
+ * topic auquel le client est abonné ; chaque message revient par la boucle
+ * locale. Scénarios :
+ *   sustained : débit soutenu, aucune perte ni inversion attendue
+ *   stall     : écriture broker lente, la queue de publication déborde
+ *   storm     : reconnexions forcées en rafale, QoS 1 puis QoS 0
+ *   filter    : actionneur filtré par device_id, messages pour un autre noeud
+ *               écartés sans aucune allocation dans le dispatch
+ *
+ * Chaque run vérifie que toute perte est expliquée par un compteur
+ * (queue_dropped, publish_failed, offline_dropped, QoS 0 perdu au broker) et
+ * que le heap revient à son niveau de départ. Code de sortie != 0 sinon.
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include "MqttClient.hpp"
+#include "broker_stub.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "snapshot.h"
+#include "utils.h"
+
+// MqttClient publie sa config dans le cache des GET : sans objet ici
+namespace snapshot
+{
+    void publish(Key, const char *, size_t) {}
+}
+
+namespace
+{
+    constexpr const char *TOPIC = "iot/load/host";
+    constexpr const char *FILTER_TOPIC = "iot/load/filter";
+    std::atomic<uint32_t> s_actuator_calls{0};
+    // fuite tolérée entre début et fin d'un run (fragmentation de l'allocateur)
+    constexpr uint32_t HEAP_SLACK = 16 * 1024;
+
+    struct Scenario
+    {
+        const char *name;
+        uint32_t rate_hz;
+        uint32_t duration_s;
+        uint32_t size;
+        int qos;
+        uint32_t reconnects;
+        broker_stub::Config broker;
+    };
+
+    struct Result
+    {
+        uint32_t sent;
+        uint32_t rejected;
+        uint32_t received;
+        uint32_t out_of_order;
+        uint64_t latency_us_sum;
+        uint32_t latency_us_max;
+        uint32_t heap_min;
+        uint32_t elapsed_ms;
+    };
+
+    std::mutex s_mutex;
+    Result s_result;
+    uint32_t s_run = 0;
+    uint32_t s_last_seq = 0;
+
+    // Appelé depuis la tâche MQTT, comme MqttLoadGen::onLoopback
+    void on_loopback(const char *payload, int len)
+    {
+        size_t v_len = 0;
+        const char *run = utils::json_peek_raw(payload, len, "run", &v_len);
+        const char *seq = utils::json_peek_raw(payload, len, "seq", &v_len);
+        const char *t = utils::json_peek_raw(payload, len, "t", &v_len);
+        if (!run || !seq || !t)
+            return;
+
+        uint32_t latency = (uint32_t)(esp_timer_get_time() - strtoll(t, nullptr, 10));
+        uint32_t n = strtoul(seq, nullptr, 10);
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (strtoul(run, nullptr, 10) != s_run)
+            return;
+        s_result.received++;
+        if (n <= s_last_seq)
+            s_result.out_of_order++;
+        else
+            s_last_seq = n;
+        s_result.latency_us_sum += latency;
+        if (latency > s_result.latency_us_max)
+            s_result.latency_us_max = latency;
+    }
+
+    bool wait_connected(MqttClient &client, uint32_t timeout_ms)
+    {
+        for (uint32_t waited = 0; waited < timeout_ms; waited += 10)
+        {
+            if (client.isConnected())
+                return true;
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        return client.isConnected();
+    }
+
+    // Attend que la queue de publication et le broker soient vides
+    void drain(MqttClient &client)
+    {
+        for (int i = 0; i < 300 && client.queueUsage() > 0; ++i)
+            vTaskDelay(pdMS_TO_TICKS(10));
+        uint32_t received = 0;
+        for (int stable = 0; stable < 20;)
+        {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            std::lock_guard<std::mutex> lock(s_mutex);
+            stable = s_result.received == received ? stable + 1 : 0;
+            received = s_result.received;
+        }
+    }
+
+    bool run(MqttClient &client, const Scenario &sc, bool warmup = false)
+    {
+        broker_stub::configure(sc.broker);
+        if (!wait_connected(client, 2000))
+        {
+            printf("%-10s FAIL not connected\n", sc.name);
+            return false;
+        }
+        drain(client);
+        broker_stub::reset_stats();
+        client.resetMetrics();
+        uint32_t heap_start = esp_get_free_heap_size();
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_result = {};
+            s_result.heap_min = heap_start;
+            s_last_seq = 0;
+            s_run++;
+        }
+
+        char payload[CONFIG_IOT_MQTT_PUBLISH_PAYLOAD_MAX];
+        TickType_t period = pdMS_TO_TICKS(1000 / sc.rate_hz);
+        if (period == 0)
+            period = 1;
+        const uint32_t total = sc.rate_hz * sc.duration_s;
+        const uint32_t reconnect_every = sc.reconnects ? total / (sc.reconnects + 1) : 0;
+        int64_t start = esp_timer_get_time();
+        TickType_t wake = xTaskGetTickCount();
+
+        for (uint32_t seq = 1; seq <= total; ++seq)
+        {
+            int n = snprintf(payload, sizeof(payload), "{\"run\":%lu,\"seq\":%lu,\"t\":%lld,\"pad\":\"",
+                             (unsigned long)s_run, (unsigned long)seq, (long long)esp_timer_get_time());
+            while (n < (int)sc.size - 2)
+                payload[n++] = 'x';
+            payload[n++] = '"';
+            payload[n++] = '}';
+            payload[n] = '\0';
+
+            bool ok = client.publish(TOPIC, payload, sc.qos, false);
+            uint32_t heap = esp_get_free_heap_size();
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                ok ? s_result.sent++ : s_result.rejected++;
+                if (heap < s_result.heap_min)
+                    s_result.heap_min = heap;
+            }
+            if (reconnect_every && seq % reconnect_every == 0)
+                client.forceReconnect();
+            vTaskDelayUntil(&wake, period);
+        }
+        uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+        broker_stub::configure({});
+        wait_connected(client, 2000);
+        drain(client);
+
+        Result r;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            r = s_result;
+        }
+        MqttClient::Metrics m = client.getMetrics();
+        broker_stub::Stats b = broker_stub::stats();
+        uint32_t heap_end = esp_get_free_heap_size();
+        if (warmup)
+            return true;
+
+        uint32_t lost = r.sent > r.received ? r.sent - r.received : 0;
+        uint32_t explained = m.publish_failed + m.offline_dropped + b.dropped_qos0;
+        // le publisher iot/hosts passe aussi par la queue : compteurs client >= run
+        bool ok = r.rejected <= m.queue_dropped && lost <= explained &&
+                  heap_end + HEAP_SLACK >= heap_start;
+        if (sc.reconnects == 0)
+            ok = ok && r.out_of_order == 0;
+        if (sc.reconnects == 0 && sc.broker.write_us == 0)
+            ok = ok && lost == 0 && r.rejected == 0;
+
+        printf("%-10s %s rate %.0f/%u Hz  sent %u  rejected %u  received %u  lost %u (explained %u)  "
+               "out_of_order %u\n",
+               sc.name, ok ? "ok  " : "FAIL", elapsed_ms ? (double)r.sent * 1000 / elapsed_ms : 0.0,
+               (unsigned)sc.rate_hz, (unsigned)r.sent, (unsigned)r.rejected, (unsigned)r.received,
+               (unsigned)lost, (unsigned)explained, (unsigned)r.out_of_order);
+        printf("           latency avg %u max %u us  dispatch avg %u max %u us  queue_dropped %u  "
+               "publish_failed %u  offline q/d %u/%u  disconnects %u\n",
+               r.received ? (unsigned)(r.latency_us_sum / r.received) : 0u, (unsigned)r.latency_us_max,
+               m.received ? (unsigned)(m.dispatch_us_sum / m.received) : 0u, (unsigned)m.dispatch_us_max,
+               (unsigned)m.queue_dropped, (unsigned)m.publish_failed, (unsigned)m.offline_queued,
+               (unsigned)m.offline_dropped, (unsigned)m.disconnects);
+        printf("           heap start %u min %u end %u\n", (unsigned)heap_start, (unsigned)r.heap_min,
+               (unsigned)heap_end);
+        return ok;
+    }
+
+    // Attend que n messages de plus aient été remis ou filtrés par le client
+    void wait_dispatched(MqttClient &client, uint32_t n)
+    {
+        for (int i = 0; i < 300; ++i)
+        {
+            MqttClient::Metrics m = client.getMetrics();
+            if (m.received + m.filtered >= n)
+                return;
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+
+    bool run_filter(MqttClient &client, uint32_t count)
+    {
+        drain(client);
+        client.resetMetrics();
+        broker_stub::reset_stats();
+        s_actuator_calls = 0;
+
+        // payload > SSO : toute copie en std::string allouerait
+        char payload[160];
+        snprintf(payload, sizeof(payload), "{\"target\":\"000000000000\",\"cmd\":\"%080d\"}", 0);
+        for (uint32_t i = 0; i < count; ++i)
+            client.publish(FILTER_TOPIC, payload, 1, false);
+        wait_dispatched(client, count);
+        MqttClient::Metrics other = client.getMetrics();
+        uint32_t other_allocs = broker_stub::stats().dispatch_allocs;
+
+        // contrôle : adressés à ce noeud, le handler tourne et le dispatch alloue
+        snprintf(payload, sizeof(payload), "{\"target\":\"%s\",\"cmd\":\"%080d\"}", utils::device_id(), 0);
+        const uint32_t mine = 10;
+        for (uint32_t i = 0; i < mine; ++i)
+            client.publish(FILTER_TOPIC, payload, 1, false);
+        wait_dispatched(client, count + mine);
+        MqttClient::Metrics m = client.getMetrics();
+        uint32_t allocs = broker_stub::stats().dispatch_allocs;
+
+        bool ok = other.filtered == count && other.received == 0 && other_allocs == 0 &&
+                  m.received == mine && s_actuator_calls == mine && allocs > 0;
+        printf("%-10s %s %u for another node: filtered %u, dispatch allocations %u  |  %u for this node: "
+               "handled %u, allocations %u\n",
+               "filter", ok ? "ok  " : "FAIL", (unsigned)count, (unsigned)other.filtered, (unsigned)other_allocs,
+               (unsigned)mine, (unsigned)s_actuator_calls.load(), (unsigned)(allocs - other_allocs));
+        return ok;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // --quick : durées réduites pour ctest
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    uint32_t duration = quick ? 2 : 10;
+
+    auto &client = MqttClient::getInstance();
+    client.registerSubscriber(TOPIC, nullptr, [](const char *, const char *payload, int len) -> std::string
+                              {
+                                  on_loopback(payload, len);
+                                  return ""; });
+    client.registerMqttActuator(FILTER_TOPIC, "iot/load/filter/out", [](const cJSON *, cJSON *)
+                                { s_actuator_calls++; },
+                                MqttClient::MqttActuatorFilter::DEVICE_ID);
+    client.init();
+
+    broker_stub::Config slow_writer;
+    slow_writer.write_us = 150 * 1000; // > 100 ms d'attente de publish()
+    broker_stub::Config slow_connect;
+    slow_connect.connect_delay_ms = 50;
+
+    const Scenario scenarios[] = {
+        {"sustained", 200, duration, 128, 1, 0, {}},
+        {"stall", 50, duration, 128, 1, 0, slow_writer},
+        {"storm_qos1", 100, duration, 128, 1, 10, slow_connect},
+        {"storm_qos0", 100, duration, 128, 0, 10, slow_connect},
+    };
+
+    // premier passage : allocations uniques (threads, buffers stdio, publisher
+    // iot/hosts) hors mesure du heap
+    run(client, {"warmup", 200, 1, 128, 1, 0, {}}, true);
+
+    bool ok = true;
+    for (const auto &sc : scenarios)
+        ok &= run(client, sc);
+    ok &= run_filter(client, quick ? 200 : 2000);
+
+    fflush(stdout);
+    // les tâches MqttClient/EventBus ne s'arrêtent pas
+    _exit(ok ? 0 : 1);
+}
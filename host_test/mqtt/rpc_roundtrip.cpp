@@ -0,0 +1,322 @@
+/**
+ * Aller-retour RPC sur l'hôte : le vrai MqttRpc (pré-analyse, slots in-flight,
+ * workers, sweep des délais) derrière le vrai MqttClient, contre le broker de
+ * substitution. La requête part sur IOT_MQTT_RPC_REQUEST_TOPIC/<device_id>,
+ * revient par la boucle locale, et la réponse est lue sur un reply_to
+ * sous IOT_MQTT_RPC_RESPONSE_TOPIC/. Scénarios :
+ *   latency    : appels séquentiels, p50 / p99 / max de l'aller-retour
+ *   throughput : fenêtre de IOT_MQTT_RPC_MAX_INFLIGHT appels en vol
+ *   burst      : 3x la fenêtre d'un coup, l'excédent reçoit BUSY
+ *   timeout    : tous les workers bloqués, le TIMEOUT part quand même à l'heure
+ *   addressing : topic de flotte ignoré, reply_to hors préfixe refusé
+ *
+ * Chaque appel doit recevoir exactement une réponse. Code de sortie != 0 sinon.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "MqttClient.hpp"
+#include "MqttRpc.h"
+#include "broker_stub.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "snapshot.h"
+#include "utils.h"
+
+// MqttClient publie sa config dans le cache des GET : sans objet ici
+namespace snapshot
+{
+    void publish(Key, const char *, size_t) {}
+}
+
+namespace
+{
+    constexpr const char *REPLY_TOPIC = CONFIG_IOT_MQTT_RPC_RESPONSE_TOPIC "/host-test";
+    constexpr const char *FORBIDDEN_TOPIC = "iot/led/host";
+    constexpr uint32_t SLOW_TIMEOUT_MS = 200;
+
+    struct Reply
+    {
+        int64_t at_us;
+        int code; // 0 = result
+        std::string topic;
+    };
+
+    std::mutex s_mutex;
+    std::condition_variable s_cv;
+    std::map<uint32_t, Reply> s_replies;
+    uint32_t s_duplicates = 0;
+    uint32_t s_next_id = 1;
+    std::atomic<uint32_t> s_forbidden{0};
+    std::string s_request_topic;
+    std::string s_default_topic;
+
+    void on_reply(const char *topic, const char *payload, int len)
+    {
+        size_t v_len = 0;
+        const char *id = utils::json_peek_raw(payload, len, "id", &v_len);
+        if (!id)
+            return;
+        Reply reply = {esp_timer_get_time(), 0, topic};
+        const char *error = utils::json_peek_raw(payload, len, "error", &v_len);
+        if (error)
+        {
+            const char *code = utils::json_peek_raw(error, v_len, "code", &v_len);
+            reply.code = code ? atoi(code) : -1;
+        }
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!s_replies.emplace((uint32_t)strtoul(id, nullptr, 10), reply).second)
+            s_duplicates++;
+        s_cv.notify_all();
+    }
+
+    uint32_t call(MqttClient &client, const char *method, const char *params,
+                  const char *reply_to = REPLY_TOPIC, const char *topic = nullptr)
+    {
+        uint32_t id;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            id = s_next_id++;
+        }
+        char payload[256];
+        snprintf(payload, sizeof(payload), "{\"id\":%lu,\"method\":\"%s\",\"params\":%s,\"reply_to\":\"%s\"}",
+                 (unsigned long)id, method, params, reply_to);
+        client.publish(topic ? topic : s_request_topic.c_str(), payload, 1, false);
+        return id;
+    }
+
+    bool wait_reply(uint32_t id, uint32_t timeout_ms, Reply *out = nullptr)
+    {
+        std::unique_lock<std::mutex> lock(s_mutex);
+        bool found = s_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [id]
+                                   { return s_replies.count(id) > 0; });
+        if (found && out)
+            *out = s_replies[id];
+        return found;
+    }
+
+    uint32_t percentile(std::vector<uint32_t> samples, uint32_t q)
+    {
+        if (samples.empty())
+            return 0;
+        std::sort(samples.begin(), samples.end());
+        size_t index = (samples.size() * q + 99) / 100;
+        return samples[index ? index - 1 : 0];
+    }
+
+    bool wait_connected(MqttClient &client, uint32_t timeout_ms)
+    {
+        for (uint32_t waited = 0; waited < timeout_ms && !client.isConnected(); waited += 10)
+            vTaskDelay(pdMS_TO_TICKS(10));
+        return client.isConnected();
+    }
+
+    bool test_latency(MqttClient &client, uint32_t count)
+    {
+        std::vector<uint32_t> rtt;
+        uint32_t errors = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            int64_t start = esp_timer_get_time();
+            Reply reply;
+            if (!wait_reply(call(client, "echo", "{\"n\":1}"), 1000, &reply) || reply.code != 0)
+            {
+                errors++;
+                continue;
+            }
+            rtt.push_back((uint32_t)(reply.at_us - start));
+        }
+        bool ok = errors == 0;
+        printf("latency    %s %u calls  rtt p50 %u p99 %u max %u us\n", ok ? "ok  " : "FAIL", (unsigned)count,
+               (unsigned)percentile(rtt, 50), (unsigned)percentile(rtt, 99),
+               (unsigned)(rtt.empty() ? 0 : *std::max_element(rtt.begin(), rtt.end())));
+        return ok;
+    }
+
+    bool test_throughput(MqttClient &client, uint32_t duration_ms)
+    {
+        constexpr uint32_t WINDOW = CONFIG_IOT_MQTT_RPC_MAX_INFLIGHT;
+        uint32_t done = 0, errors = 0, lost = 0;
+        int64_t start = esp_timer_get_time();
+        int64_t end = start + (int64_t)duration_ms * 1000;
+        while (esp_timer_get_time() < end)
+        {
+            uint32_t ids[WINDOW];
+            for (uint32_t &id : ids)
+                id = call(client, "echo", "{\"n\":2}");
+            for (uint32_t id : ids)
+            {
+                Reply reply;
+                if (!wait_reply(id, 1000, &reply))
+                    lost++;
+                else if (reply.code != 0)
+                    errors++;
+                else
+                    done++;
+            }
+        }
+        double elapsed_s = (esp_timer_get_time() - start) / 1e6;
+        bool ok = lost == 0 && errors == 0 && done > 0;
+        printf("throughput %s %u calls in %.2f s (%.0f calls/s, window %u)  errors %u  lost %u\n",
+               ok ? "ok  " : "FAIL", (unsigned)done, elapsed_s, done / elapsed_s, (unsigned)WINDOW,
+               (unsigned)errors, (unsigned)lost);
+        return ok;
+    }
+
+    // Plus d'appels que de slots : chaque appel reçoit un résultat ou BUSY, jamais rien
+    bool test_burst(MqttClient &client)
+    {
+        constexpr uint32_t COUNT = 3 * CONFIG_IOT_MQTT_RPC_MAX_INFLIGHT;
+        uint32_t ids[COUNT];
+        for (uint32_t &id : ids)
+            id = call(client, "sleep", "{\"ms\":20}");
+        uint32_t ok_count = 0, busy = 0, other = 0, lost = 0;
+        for (uint32_t id : ids)
+        {
+            Reply reply;
+            if (!wait_reply(id, 2000, &reply))
+                lost++;
+            else if (reply.code == 0)
+                ok_count++;
+            else if (reply.code == MqttRpc::BUSY)
+                busy++;
+            else
+                other++;
+        }
+        bool ok = lost == 0 && other == 0 && busy > 0 && ok_count >= CONFIG_IOT_MQTT_RPC_MAX_INFLIGHT;
+        printf("burst      %s %u calls  ok %u  busy %u  other %u  lost %u\n", ok ? "ok  " : "FAIL",
+               (unsigned)COUNT, (unsigned)ok_count, (unsigned)busy, (unsigned)other, (unsigned)lost);
+        return ok;
+    }
+
+    // Workers occupés bien au-delà du délai : le TIMEOUT vient du sweep, pas des workers
+    bool test_timeout(MqttClient &client)
+    {
+        constexpr uint32_t COUNT = CONFIG_IOT_MQTT_RPC_WORKERS + 1;
+        constexpr uint32_t SLEEP_MS = 5 * SLOW_TIMEOUT_MS;
+        char params[32];
+        snprintf(params, sizeof(params), "{\"ms\":%u}", (unsigned)SLEEP_MS);
+        int64_t start = esp_timer_get_time();
+        uint32_t ids[COUNT];
+        for (uint32_t &id : ids)
+            id = call(client, "slow", params);
+
+        uint32_t timeouts = 0;
+        uint32_t worst_ms = 0;
+        for (uint32_t id : ids)
+        {
+            Reply reply;
+            if (wait_reply(id, SLEEP_MS, &reply) && reply.code == MqttRpc::TIMEOUT)
+            {
+                timeouts++;
+                worst_ms = std::max(worst_ms, (uint32_t)((reply.at_us - start) / 1000));
+            }
+        }
+        // délai + période du sweep (100 ms) + deux passages par le broker
+        bool ok = timeouts == COUNT && worst_ms < SLOW_TIMEOUT_MS + 250;
+        printf("timeout    %s %u/%u TIMEOUT replies, last after %u ms (timeout %u ms, workers busy %u ms)\n",
+               ok ? "ok  " : "FAIL", (unsigned)timeouts, (unsigned)COUNT, (unsigned)worst_ms,
+               (unsigned)SLOW_TIMEOUT_MS, (unsigned)SLEEP_MS);
+
+        // les handlers finissent : leur réponse tardive ne doit pas partir en double
+        vTaskDelay(pdMS_TO_TICKS(SLEEP_MS + 200));
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_duplicates)
+        {
+            printf("timeout    FAIL %u duplicate replies\n", (unsigned)s_duplicates);
+            ok = false;
+        }
+        return ok;
+    }
+
+    bool test_addressing(MqttClient &client)
+    {
+        // topic de flotte : aucun noeud ne l'écoute plus
+        uint32_t fleet = call(client, "echo", "{}", REPLY_TOPIC, CONFIG_IOT_MQTT_RPC_REQUEST_TOPIC);
+        bool fleet_ignored = !wait_reply(fleet, 300);
+
+        // reply_to hors préfixe : refusé, réponse sur le topic par défaut du noeud
+        Reply reply;
+        uint32_t id = call(client, "echo", "{}", FORBIDDEN_TOPIC);
+        bool refused = wait_reply(id, 1000, &reply) && reply.code == MqttRpc::INVALID_REQUEST &&
+                       reply.topic == s_default_topic;
+        vTaskDelay(pdMS_TO_TICKS(100));
+        bool ok = fleet_ignored && refused && s_forbidden == 0;
+        printf("addressing %s fleet topic ignored %s  reply_to %s refused %s  published there %u\n",
+               ok ? "ok  " : "FAIL", fleet_ignored ? "yes" : "no", FORBIDDEN_TOPIC, refused ? "yes" : "no",
+               (unsigned)s_forbidden.load());
+        return ok;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // --quick : durées réduites pour ctest
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+
+    s_request_topic = std::string(CONFIG_IOT_MQTT_RPC_REQUEST_TOPIC) + "/" + utils::device_id();
+    s_default_topic = std::string(CONFIG_IOT_MQTT_RPC_RESPONSE_TOPIC) + "/" + utils::device_id();
+
+    auto &rpc = MqttRpc::getInstance();
+    rpc.registerMethod("echo", [](const cJSON *params, cJSON *result)
+                       {
+                           cJSON_AddItemToObject(result, "params", params ? cJSON_Duplicate(params, true) : cJSON_CreateNull());
+                           return ESP_OK; });
+    auto sleep_handler = [](const cJSON *params, cJSON *)
+    {
+        const cJSON *ms = params ? cJSON_GetObjectItemCaseSensitive(params, "ms") : nullptr;
+        if (!cJSON_IsNumber(ms))
+            return ESP_ERR_INVALID_ARG;
+        vTaskDelay(pdMS_TO_TICKS((uint32_t)ms->valuedouble));
+        return ESP_OK;
+    };
+    rpc.registerMethod("sleep", sleep_handler);
+    rpc.registerMethod("slow", sleep_handler, SLOW_TIMEOUT_MS);
+
+    // MqttRpc démarre sur BOOT_CAN_START, comme sur la cible ; ses abonnements
+    // doivent exister avant la connexion
+    Event evt = {};
+    evt.type = EventType::BOOT_CAN_START;
+    EventBus::getInstance().emit(evt);
+    for (int i = 0; i < 200 && !rpc.hasMethod("rpc.list"); ++i)
+        vTaskDelay(pdMS_TO_TICKS(10));
+
+    auto &client = MqttClient::getInstance();
+    auto reply_cb = [](const char *topic, const char *payload, int len) -> std::string
+    {
+        on_reply(topic, payload, len);
+        return "";
+    };
+    client.registerSubscriber(REPLY_TOPIC, nullptr, reply_cb);
+    client.registerSubscriber(s_default_topic.c_str(), nullptr, reply_cb);
+    client.registerSubscriber(FORBIDDEN_TOPIC, nullptr, [](const char *, const char *, int) -> std::string
+                              {
+                                  s_forbidden++;
+                                  return ""; });
+    broker_stub::Config broker;
+    broker.latency_us = 500;
+    broker_stub::configure(broker);
+    client.init();
+
+    bool ok = rpc.hasMethod("rpc.list") && wait_connected(client, 2000);
+    if (!ok)
+        printf("setup      FAIL rpc not started or not connected\n");
+    ok = ok && test_latency(client, quick ? 100 : 1000);
+    ok &= test_throughput(client, quick ? 1000 : 5000);
+    ok &= test_burst(client);
+    ok &= test_timeout(client);
+    ok &= test_addressing(client);
+
+    fflush(stdout);
+    // les tâches MqttClient/MqttRpc/EventBus ne s'arrêtent pas
+    _exit(ok ? 0 : 1);
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <cstddef>
+#include "esp_err.h"
+
+// Types seulement : les headers inclus par les modules testés les nomment
+typedef struct httpd_req httpd_req_t;
+typedef void *httpd_handle_t;
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <malloc.h>
+#include <mutex>
+#include <thread>
+#include "esp_err.h"
+#include "esp_mac.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+// budget équivalent au heap interne d'un ESP32
+static constexpr uint32_t HEAP_BUDGET = 300 * 1024;
+static uint32_t s_heap_min = HEAP_BUDGET;
+
+int64_t esp_timer_get_time()
+{
+    static const int64_t start = []
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }();
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - start;
+}
+
+uint32_t esp_get_free_heap_size()
+{
+    size_t used = mallinfo2().uordblks;
+    uint32_t free = used < HEAP_BUDGET ? HEAP_BUDGET - (uint32_t)used : 0;
+    if (free < s_heap_min)
+        s_heap_min = free;
+    return free;
+}
+
+uint32_t esp_get_minimum_free_heap_size()
+{
+    esp_get_free_heap_size();
+    return s_heap_min;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t)
+{
+    static const uint8_t HOST_MAC[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    for (int i = 0; i < 6; ++i)
+        mac[i] = HOST_MAC[i];
+    return ESP_OK;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    static char buf[16];
+    snprintf(buf, sizeof(buf), "0x%x", code);
+    return buf;
+}
+
+struct esp_timer
+{
+    esp_timer_create_args_t args;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool running = false;
+    std::thread thread;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (!args || !args->callback || !out)
+        return ESP_ERR_INVALID_ARG;
+    *out = new esp_timer();
+    (*out)->args = *args;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (timer->running)
+        return ESP_ERR_INVALID_STATE;
+    timer->running = true;
+    timer->thread = std::thread([timer, period_us]
+                                {
+                                    auto next = std::chrono::steady_clock::now();
+                                    std::unique_lock<std::mutex> lock(timer->mutex);
+                                    while (timer->running)
+                                    {
+                                        next += std::chrono::microseconds(period_us);
+                                        if (timer->cv.wait_until(lock, next, [timer] { return !timer->running; }))
+                                            break;
+                                        lock.unlock();
+                                        timer->args.callback(timer->args.arg);
+                                        lock.lock();
+                                    } });
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    {
+        std::lock_guard<std::mutex> lock(timer->mutex);
+        if (!timer->running)
+            return ESP_ERR_INVALID_STATE;
+        timer->running = false;
+        timer->cv.notify_all();
+    }
+    timer->thread.join();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer->running)
+        return ESP_ERR_INVALID_STATE;
+    delete timer;
+    return ESP_OK;
+}
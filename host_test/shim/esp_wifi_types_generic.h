@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t rssi;
+    int authmode;
+} wifi_ap_record_t;
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+// FreeRTOS réduit à ce qu'utilisent les modules testés, sur threads POSIX.
+// Tick de 1 ms.
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTICKS_TO_MS(t) ((uint32_t)(t))
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7fffffff
@@ -0,0 +1,113 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+struct QueueDefinition
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+
+static std::chrono::milliseconds wait_for(TickType_t ticks)
+{
+    // portMAX_DELAY : l'équivalent d'une attente infinie
+    return std::chrono::milliseconds(ticks == portMAX_DELAY ? 24L * 3600 * 1000 : (long)ticks);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    auto *q = new QueueDefinition();
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait)
+{
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!q->cv.wait_for(lock, wait_for(wait), [&]
+                        { return q->items.size() < q->length; }))
+        return pdFALSE;
+    const auto *bytes = static_cast<const uint8_t *>(item);
+    q->items.emplace_back(bytes, bytes + q->item_size);
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait)
+{
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!q->cv.wait_for(lock, wait_for(wait), [&]
+                        { return !q->items.empty(); }))
+        return pdFALSE;
+    memcpy(item, q->items.front().data(), q->item_size);
+    q->items.pop_front();
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    std::lock_guard<std::mutex> lock(q->mutex);
+    return q->items.size();
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *, uint32_t, void *arg, UBaseType_t, TaskHandle_t *handle)
+{
+    std::thread thread(fn, arg);
+    if (handle)
+        *handle = reinterpret_cast<TaskHandle_t>(thread.native_handle());
+    thread.detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t)
+{
+    return xTaskCreate(fn, name, stack, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task)
+        pthread_exit(nullptr);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t)
+{
+    return 0;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks ? ticks : 1));
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period)
+{
+    *previous_wake += period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*previous_wake - now) > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(*previous_wake - now));
+}
@@ -0,0 +1,20 @@
+#pragma once
+// Configuration des builds hôte : seules les options lues par le code testé
+
+#define CONFIG_IOT_HOSTNAME "host"
+#define CONFIG_IOT_MQTT_BROKER_ENABLE 1
+#define CONFIG_IOT_MQTT_BROKER_URI "mqtt://stand-in"
+#define CONFIG_IOT_MQTT_BROKER_USERNAME ""
+#define CONFIG_IOT_MQTT_BROKER_PASSWORD ""
+#define CONFIG_IOT_MQTT_BROKER_CLIENT_ID "host"
+#define CONFIG_IOT_MQTT_PUBLISH_PAYLOAD_MAX 512
+#define CONFIG_IOT_MQTT_PERSISTENT_SESSION 1
+#define CONFIG_IOT_MQTT_KEEPALIVE_S 30
+#define CONFIG_IOT_MQTT_RPC_ENABLE 1
+#define CONFIG_IOT_MQTT_RPC_REQUEST_TOPIC "iot/rpc/req"
+#define CONFIG_IOT_MQTT_RPC_RESPONSE_TOPIC "iot/rpc/res"
+#define CONFIG_IOT_MQTT_RPC_MAX_INFLIGHT 4
+#define CONFIG_IOT_MQTT_RPC_WORKERS 2
+#define CONFIG_IOT_MQTT_RPC_TIMEOUT_MS 1000
+#define CONFIG_IOT_MQTT_RPC_MAX_PAYLOAD 1024
+#define CONFIG_IOT_MQTT_RPC_STACK_SIZE 4096
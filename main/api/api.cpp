@@ -6,12 +6,30 @@
 
 #ifdef CONFIG_IOT_FEATURE_CAMERA
 #include "camera_api.h"
+#include "recorder.h"
+#include "presets.h"
+#include "camera_stats.h"
 #endif
 
-#include <memory>
 #include "types.h"
 #include "utils.h"
 #include "ota.h"
+#include "snapshot.h"
+#include "json_stream.h"
+#include "http_body.h"
+#include "http_async.h"
+#include "conn_budget.h"
+#include "config_bulk.h"
+#include "route_stats.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#ifdef CONFIG_IOT_HTTP_WS_ENABLE
+#include "ws_push.h"
+#endif
+#ifdef CONFIG_IOT_HTTP_STATIC_UI
+#include "static_ui.h"
+#endif
+#include "MqttClient.hpp"
 namespace api
 {
     static httpd_handle_t server = nullptr;
@@ -43,32 +61,25 @@ namespace api
         }
         else
         {
-            vQueueDelete(resp_queue);
+            // le module peut encore répondre dans cette queue : suppression via le bus
+            http_body::Lease none;
+            http_body::release_later(none, resp_queue);
             return httpd_resp_send_500(req);
         }
     }
 
     // Wrapper pour lire le corps HTTP, émettre un event, et attendre la réponse
-    esp_err_t handle_post_request(EventType post_req_type, EventType expected_resp_type, httpd_req_t *req)
+    // Le corps reste dans le buffer du pool ; l'event n'en transporte que la référence
+    esp_err_t handle_post_request(EventType post_req_type, EventType expected_resp_type, httpd_req_t *req, size_t limit)
     {
-        size_t len = req->content_len;
-        if (len == 0)
-        {
-            httpd_resp_send_500(req);
-            return ESP_FAIL;
-        }
-
-        std::unique_ptr<char[]> buf(new char[len + 1]);
-        if (httpd_req_recv(req, buf.get(), len) != (ssize_t)len)
-        {
-            httpd_resp_send_500(req);
+        http_body::Lease body;
+        if (http_body::receive(req, limit, body) != ESP_OK)
             return ESP_FAIL;
-        }
-        buf[len] = '\0';
 
         QueueHandle_t resp_queue = xQueueCreate(1, sizeof(Event));
         if (!resp_queue)
         {
+            http_body::release(body);
             httpd_resp_send_500(req);
             return ESP_FAIL;
         }
@@ -76,8 +87,9 @@ namespace api
         Event evt{};
         evt.type = post_req_type;
         evt.user_ctx = resp_queue;
-        evt.data_len = len;
-        memcpy(evt.data, buf.get(), len);
+        http_body_ref_t ref = {body.data, body.len, body.slot};
+        memcpy(evt.data, &ref, sizeof(ref));
+        evt.data_len = sizeof(ref);
 
         EventBus::getInstance().emit(evt);
 
@@ -85,53 +97,67 @@ namespace api
         if (xQueueReceive(resp_queue, &answer_evt, pdMS_TO_TICKS(200)) == pdTRUE &&
             answer_evt.type == expected_resp_type)
         {
+            http_body::release(body);
+            vQueueDelete(resp_queue);
             SET_RESP_HEADERS(req);
             httpd_resp_send(req, (const char *)answer_evt.data, answer_evt.data_len);
-            vQueueDelete(resp_queue);
             return ESP_OK;
         }
         else
         {
-            vQueueDelete(resp_queue);
+            http_body::release_later(body, resp_queue);
             return httpd_resp_send_500(req);
         }
     }
 
+    // Sert le snapshot publié par le module ; aller-retour bus seulement s'il n'existe pas encore
+    static esp_err_t serve_snapshot_or_event(snapshot::Key key, EventType req_type, EventType expected_resp_type, httpd_req_t *req)
+    {
+        esp_err_t err = snapshot::serve(key, req);
+        if (err != ESP_ERR_NOT_FOUND)
+            return err;
+        return emit_event_and_wait_response(req_type, expected_resp_type, req);
+    }
+
     // Handlers GET
     esp_err_t wifi_sta_get_handler(httpd_req_t *req)
     {
-        return emit_event_and_wait_response(EventType::STA_REQUEST_JSON, EventType::STA_ANSWER_JSON, req);
+        return serve_snapshot_or_event(snapshot::Key::WIFI_STA, EventType::STA_REQUEST_JSON, EventType::STA_ANSWER_JSON, req);
     }
 
     esp_err_t wifi_ap_get_handler(httpd_req_t *req)
     {
-        return emit_event_and_wait_response(EventType::AP_REQUEST_JSON, EventType::AP_ANSWER_JSON, req);
+        return serve_snapshot_or_event(snapshot::Key::WIFI_AP, EventType::AP_REQUEST_JSON, EventType::AP_ANSWER_JSON, req);
     }
 
     esp_err_t mqtt_get_handler(httpd_req_t *req)
     {
-        return emit_event_and_wait_response(EventType::MQTT_CONFIG_REQUEST_JSON, EventType::MQTT_CONFIG_ANSWER_JSON, req);
+        return serve_snapshot_or_event(snapshot::Key::MQTT_CONFIG, EventType::MQTT_CONFIG_REQUEST_JSON, EventType::MQTT_CONFIG_ANSWER_JSON, req);
     }
 
-    // Handlers POST
+    // Handlers POST (limite de taille par endpoint)
+    static constexpr size_t STA_BODY_LIMIT = 1024;
+    static constexpr size_t AP_BODY_LIMIT = 512;
+    static constexpr size_t MQTT_BODY_LIMIT = 1024;
+
     esp_err_t wifi_sta_post_handler(httpd_req_t *req)
     {
-        return handle_post_request(EventType::STA_POST_REQUEST, EventType::STA_POST_ANSWER, req);
+        return handle_post_request(EventType::STA_POST_REQUEST, EventType::STA_POST_ANSWER, req, STA_BODY_LIMIT);
     }
 
     esp_err_t wifi_ap_post_handler(httpd_req_t *req)
     {
-        return handle_post_request(EventType::AP_POST_REQUEST, EventType::AP_POST_ANSWER, req);
+        return handle_post_request(EventType::AP_POST_REQUEST, EventType::AP_POST_ANSWER, req, AP_BODY_LIMIT);
     }
 
     esp_err_t wifi_status_handler(httpd_req_t *req)
     {
-        return emit_event_and_wait_response(EventType::WIFI_STATUS_REQUEST_JSON, EventType::WIFI_STATUS_ANSWER_JSON, req);
+        return serve_snapshot_or_event(snapshot::Key::WIFI_STATUS, EventType::WIFI_STATUS_REQUEST_JSON, EventType::WIFI_STATUS_ANSWER_JSON, req);
     }
 
     esp_err_t mqtt_post_handler(httpd_req_t *req)
     {
-        return handle_post_request(EventType::MQTT_POST_REQUEST, EventType::MQTT_POST_ANSWER, req);
+        return handle_post_request(EventType::MQTT_POST_REQUEST, EventType::MQTT_POST_ANSWER, req, MQTT_BODY_LIMIT);
     }
     esp_err_t fs_list_handler(httpd_req_t *req)
     {
@@ -139,10 +165,49 @@ namespace api
     }
     esp_err_t mqtt_status_handler(httpd_req_t *req)
     {
-        return emit_event_and_wait_response(EventType::MQTT_STATUS_REQUEST_JSON, EventType::MQTT_STATUS_ANSWER_JSON, req);
+        JsonStream w(req);
+        MqttClient::getInstance().writeStatus(w);
+        return w.finish();
     }
+    esp_err_t api_stats_handler(httpd_req_t *req)
+    {
+        char query[16];
+        char value[4];
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "reset", value, sizeof(value)) == ESP_OK && value[0] == '1')
+            route_stats::reset();
+
+        cJSON *root = cJSON_CreateObject();
+        if (!root)
+            return httpd_resp_send_500(req);
+        snapshot::stats_to_json(cJSON_AddObjectToObject(root, "snapshots"));
+        JsonStream::stats_to_json(cJSON_AddObjectToObject(root, "json_stream"));
+        http_body::stats_to_json(cJSON_AddObjectToObject(root, "http_body"));
+        http_async::stats_to_json(cJSON_AddObjectToObject(root, "async"));
+        conn_budget::stats_to_json(cJSON_AddObjectToObject(root, "connections"));
+        route_stats::stats_to_json(cJSON_AddObjectToObject(root, "routes"));
+        cJSON_AddNumberToObject(root, "heap_free", heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+        cJSON_AddNumberToObject(root, "heap_min", heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+#ifdef CONFIG_IOT_HTTP_WS_ENABLE
+        ws_push::stats_to_json(cJSON_AddObjectToObject(root, "ws"));
+#endif
+#ifdef CONFIG_IOT_HTTP_STATIC_UI
+        static_ui::stats_to_json(cJSON_AddObjectToObject(root, "static"));
+#endif
+        char *json = cJSON_PrintUnformatted(root);
+        cJSON_Delete(root);
+        if (!json)
+            return httpd_resp_send_500(req);
+        SET_RESP_HEADERS(req);
+        esp_err_t err = httpd_resp_send(req, json, strlen(json));
+        cJSON_free(json);
+        return err;
+    }
+    // Jusqu'à 5 s d'attente du scan : exécuté sur un worker async
     esp_err_t wifi_scan_handler(httpd_req_t *req)
     {
+        HTTP_RUN_ASYNC(req, wifi_scan_handler);
+
         QueueHandle_t resp_queue = xQueueCreate(2, sizeof(Event));
         if (!resp_queue)
         {
@@ -160,59 +225,22 @@ namespace api
         if (xQueueReceive(resp_queue, &resp_evt, pdMS_TO_TICKS(5000)) == pdTRUE &&
             resp_evt.type == EventType::WIFI_SCAN_RESULT)
         {
-            // Ici tu reconstruis ton JSON depuis resp_evt.data
             // const scan_result_t *result = reinterpret_cast<const scan_result_t *>(resp_evt.data);
             scan_result_t result;
             memcpy(&result, resp_evt.data, sizeof(result));
+            vQueueDelete(resp_queue);
 
-            cJSON *root = cJSON_CreateObject();
-            if (!root)
-            {
-                ESP_LOGE(TAG, "cJSON_CreateObject failed");
-                vQueueDelete(resp_queue);
-                return httpd_resp_send_500(req);
-            }
-
-            cJSON *array = cJSON_CreateArray();
-            if (!array)
-            {
-                ESP_LOGE(TAG, "cJSON_CreateArray failed");
-                cJSON_Delete(root);
-                vQueueDelete(resp_queue);
-                return httpd_resp_send_500(req);
-            }
+            // Ecrit en flux : ni arbre cJSON ni chaîne imprimée sur le heap
+            JsonStream w(req);
+            w.beginObject();
+            w.beginArray("results");
             uint8_t final_count = 0;
-            // for (int i = 0; i < result.count; ++i)
-            // {
-            //     if (i >= MAX_SCAN_RESULTS)
-            //     {
-            //         break;
-            //     }
-            //     wifi_ap_record_t r = result.list[i];
-            //     cJSON *item = cJSON_CreateObject();
-            //     char ssid_buf[sizeof(r.ssid) + 1] = {0};
-            //     memcpy(ssid_buf, r.ssid, sizeof(r.ssid));
-            //     ssid_buf[sizeof(r.ssid)] = '\0';
-            //     if(strlen(ssid_buf) == 0) continue;
-            //     if(ssid_buf[0] == '\0') continue;
-            //     if(strcmp(ssid_buf, "") == 0) continue;
-
-            //     cJSON_AddStringToObject(item, "ssid", ssid_buf);
-            //     cJSON_AddNumberToObject(item, "rssi", r.rssi);
-            //     cJSON_AddNumberToObject(item, "channel", r.primary);
-            //     cJSON_AddNumberToObject(item, "authmode", r.authmode);
-            //     cJSON_AddItemToArray(array, item);
-            //     final_count++;
-            // }
             for (int i = 0; i < result.count; ++i)
             {
                 if (i >= MAX_SCAN_RESULTS)
                     break;
 
-                wifi_ap_record_t r = result.list[i];
-                cJSON *item = cJSON_CreateObject();
-                if (!item)
-                    continue;
+                const wifi_ap_record_t &r = result.list[i];
 
                 // Safe SSID extraction
                 char ssid_buf[sizeof(r.ssid) + 1] = {0};
@@ -222,51 +250,44 @@ namespace api
                 if (ssid_buf[0] == '\0')
                     continue;
 
-                cJSON_AddStringToObject(item, "ssid", ssid_buf);
-                cJSON_AddNumberToObject(item, "rssi", r.rssi);
-                cJSON_AddNumberToObject(item, "channel", r.primary);
-                cJSON_AddNumberToObject(item, "authmode", r.authmode);
-                cJSON_AddStringToObject(item, "bssid", utils::mac_to_string(r.bssid).c_str());
-                cJSON_AddNumberToObject(item, "pairwise_cipher", r.pairwise_cipher);
-                cJSON_AddNumberToObject(item, "group_cipher", r.group_cipher);
-                cJSON_AddNumberToObject(item, "bandwidth", r.bandwidth);
-                cJSON_AddNumberToObject(item, "vht_ch_freq1", r.vht_ch_freq1);
-                cJSON_AddNumberToObject(item, "vht_ch_freq2", r.vht_ch_freq2);
+                char bssid[18];
+                snprintf(bssid, sizeof(bssid), "%02X:%02X:%02X:%02X:%02X:%02X",
+                         r.bssid[0], r.bssid[1], r.bssid[2], r.bssid[3], r.bssid[4], r.bssid[5]);
+
+                w.beginObject();
+                w.string("ssid", ssid_buf);
+                w.number("rssi", r.rssi);
+                w.number("channel", r.primary);
+                w.number("authmode", r.authmode);
+                w.string("bssid", bssid);
+                w.number("pairwise_cipher", r.pairwise_cipher);
+                w.number("group_cipher", r.group_cipher);
+                w.number("bandwidth", r.bandwidth);
+                w.number("vht_ch_freq1", r.vht_ch_freq1);
+                w.number("vht_ch_freq2", r.vht_ch_freq2);
 
                 // Flags PHY (packés sur des bits, on les remplit un par un)
-                cJSON *phy = cJSON_CreateObject();
-                if (phy)
-                {
-                    cJSON_AddBoolToObject(phy, "11b", r.phy_11b);
-                    cJSON_AddBoolToObject(phy, "11g", r.phy_11g);
-                    cJSON_AddBoolToObject(phy, "11n", r.phy_11n);
-                    cJSON_AddBoolToObject(phy, "lr", r.phy_lr);
-                    cJSON_AddBoolToObject(phy, "11a", r.phy_11a);
-                    cJSON_AddBoolToObject(phy, "11ac", r.phy_11ac);
-                    cJSON_AddBoolToObject(phy, "11ax", r.phy_11ax);
-                    cJSON_AddItemToObject(item, "phy", phy);
-                }
+                w.beginObject("phy");
+                w.boolean("11b", r.phy_11b);
+                w.boolean("11g", r.phy_11g);
+                w.boolean("11n", r.phy_11n);
+                w.boolean("lr", r.phy_lr);
+                w.boolean("11a", r.phy_11a);
+                w.boolean("11ac", r.phy_11ac);
+                w.boolean("11ax", r.phy_11ax);
+                w.endObject();
 
                 // Flags divers
-                cJSON_AddBoolToObject(item, "wps", r.wps);
-                cJSON_AddBoolToObject(item, "ftm_responder", r.ftm_responder);
-                cJSON_AddBoolToObject(item, "ftm_initiator", r.ftm_initiator);
-
-                // (optionnel) tu pourrais aussi rajouter le country ici si besoin
-
-                cJSON_AddItemToArray(array, item);
+                w.boolean("wps", r.wps);
+                w.boolean("ftm_responder", r.ftm_responder);
+                w.boolean("ftm_initiator", r.ftm_initiator);
+                w.endObject();
                 final_count++;
             }
-            cJSON_AddNumberToObject(root, "count", final_count);
-            cJSON_AddItemToObject(root, "results", array);
-
-            char *json_str = cJSON_PrintUnformatted(root);
-            cJSON_Delete(root);
-            SET_RESP_HEADERS(req);
-            httpd_resp_send(req, json_str, strlen(json_str));
-            cJSON_free(json_str);
-            vQueueDelete(resp_queue);
-            return ESP_OK;
+            w.endArray();
+            w.number("count", final_count);
+            w.endObject();
+            return w.finish();
         }
         else
         {
@@ -277,6 +298,8 @@ namespace api
 
     esp_err_t ota_post_handler(httpd_req_t *req)
     {
+        HTTP_RUN_ASYNC(req, ota_post_handler);
+
         char buf[512] = {};
         int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
         if (ret <= 0)
@@ -296,71 +319,165 @@ namespace api
         return ESP_OK;
     }
 
-    // Fonction d'enregistrement générique des endpoints HTTP
-    void private_register_endpoints(httpd_handle_t server, const char *base_path,
-                                    http_handler_t get_handler,
-                                    http_handler_t post_handler)
+    static esp_err_t ping_handler(httpd_req_t *req)
     {
-        if (!server)
-            return;
+        SET_RESP_HEADERS(req);
+        return httpd_resp_send(req, nullptr, 0);
+    }
 
-        if (get_handler)
+    // Table des routes, triée par chemin (vérifié à la compilation) : recherche
+    // dichotomique dans un seul handler wildcard au lieu d'un slot httpd par
+    // couple chemin/méthode. Pour ajouter un endpoint : une ligne ici, à sa place.
+    static constexpr Route ROUTES[] = {
+#ifdef CONFIG_IOT_HTTP_STATIC_UI
+        {"/", static_ui::handler, nullptr},
+#endif
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+        {"/camera_save", nullptr, camera_api::camera_save},
+#endif
+#ifdef CONFIG_IOT_HTTP_STATIC_UI
+        {"/index.html", static_ui::handler, nullptr},
+#endif
+        {"/iot/api_stats", api_stats_handler, nullptr},
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+        {"/iot/camera", camera_api::camera_get, camera_api::camera_post},
+        {"/iot/camera/presets", camera::PresetManager::get_handler, camera::PresetManager::post_handler},
+        {"/iot/camera/stats", camera::CameraStats::handler, nullptr},
+#endif
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+        {"/iot/capture", camera_api::capture_get, nullptr},
+#endif
+        {"/iot/config", config_bulk::get_handler, config_bulk::post_handler},
+        {"/iot/fs", fs_list_handler, nullptr},
+        {"/iot/mqtt", mqtt_get_handler, mqtt_post_handler},
+        {"/iot/mqtt_status", mqtt_status_handler, nullptr},
+        {"/iot/ota", nullptr, ota_post_handler},
+        {"/iot/ping", ping_handler, nullptr},
+#ifdef CONFIG_IOT_REC_ENABLE
+        {"/iot/rec", camera::Recorder::list_handler, nullptr},
+        {"/iot/rec/export", camera::Recorder::export_handler, nullptr},
+#endif
+        {"/iot/wifi_ap", wifi_ap_get_handler, wifi_ap_post_handler},
+        {"/iot/wifi_scan", wifi_scan_handler, nullptr},
+        {"/iot/wifi_sta", wifi_sta_get_handler, wifi_sta_post_handler},
+        {"/iot/wifi_status", wifi_status_handler, nullptr},
+    };
+    static constexpr size_t ROUTE_COUNT = sizeof(ROUTES) / sizeof(ROUTES[0]);
+    static_assert(ROUTE_COUNT <= route_stats::MAX_ROUTES, "route_stats::MAX_ROUTES too small");
+
+    // Compare le chemin d'une route aux len premiers caractères de l'URI
+    static constexpr int path_cmp(const char *route, const char *path, size_t len)
+    {
+        size_t i = 0;
+        for (; i < len && route[i] && route[i] == path[i]; ++i)
         {
-            httpd_uri_t get_uri = {
-                .uri = base_path,
-                .method = HTTP_GET,
-                .handler = get_handler,
-                .user_ctx = nullptr};
+        }
+        if (i == len)
+            return route[i] ? 1 : 0;
+        return (unsigned char)route[i] - (unsigned char)path[i];
+    }
+
+    static constexpr size_t path_len(const char *path)
+    {
+        size_t n = 0;
+        while (path[n])
+            ++n;
+        return n;
+    }
+
+    static constexpr bool routes_sorted()
+    {
+        for (size_t i = 1; i < ROUTE_COUNT; ++i)
+            if (path_cmp(ROUTES[i - 1].path, ROUTES[i].path, path_len(ROUTES[i].path)) >= 0)
+                return false;
+        return true;
+    }
+    static_assert(routes_sorted(), "ROUTES must be sorted by path, without duplicates");
 
-            ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server, &get_uri));
+    const Route *find_route(const char *uri)
+    {
+        size_t len = strcspn(uri, "?#");
+        size_t lo = 0, hi = ROUTE_COUNT;
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            int cmp = path_cmp(ROUTES[mid].path, uri, len);
+            if (cmp == 0)
+                return &ROUTES[mid];
+            if (cmp < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
         }
-        if (post_handler)
+        return nullptr;
+    }
+
+    static esp_err_t send_status(httpd_req_t *req, const char *status, const char *message)
+    {
+        char json[64];
+        snprintf(json, sizeof(json), "{\"error\":\"%s\"}", message);
+        SET_RESP_HEADERS(req);
+        httpd_resp_set_status(req, status);
+        return httpd_resp_send(req, json, strlen(json));
+    }
+
+    esp_err_t dispatch(httpd_req_t *req)
+    {
+        conn_budget::touch(httpd_req_to_sockfd(req));
+        const Route *route = find_route(req->uri);
+        if (!route)
+            return send_status(req, "404 Not Found", "Not found");
+
+        // pré-vol CORS générique : les en-têtes couvrent déjà GET, POST et OPTIONS
+        if (req->method == HTTP_OPTIONS)
         {
-            httpd_uri_t post_uri = {
-                .uri = base_path,
-                .method = HTTP_POST,
-                .handler = post_handler,
-                .user_ctx = nullptr};
+            SET_CORS_HEADERS(req);
+            return httpd_resp_send(req, nullptr, 0);
+        }
 
-            ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server, &post_uri));
+        http_handler_t handler = nullptr;
+        route_stats::Method method = route_stats::Method::GET;
+        if (req->method == HTTP_GET)
+        {
+            handler = route->get;
         }
-        if (get_handler || post_handler)
+        else if (req->method == HTTP_POST)
         {
-
-            httpd_uri_t options_uri = {
-                .uri = base_path,
-                .method = HTTP_OPTIONS,
-                .handler = [](httpd_req_t *req)
-                {
-                    SET_CORS_HEADERS(req);
-                    HANDLE_OPTIONS(req);
-                    return ESP_OK;
-                },
-                .user_ctx = nullptr};
-
-            ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server, &options_uri));
+            handler = route->post;
+            method = route_stats::Method::POST;
         }
+        if (handler)
+        {
+            route_stats::Sample sample = route_stats::begin(route - ROUTES, route->path, method);
+            route_stats::set_current(&sample);
+            esp_err_t err = handler(req);
+            route_stats::set_current(nullptr);
+            // handler asynchrone : le worker enregistre la mesure complète
+            if (!sample.deferred)
+                route_stats::end(sample, err != ESP_OK);
+            return err;
+        }
+
+        httpd_resp_set_hdr(req, "Allow", route->get && route->post ? "GET, POST, OPTIONS" : route->get ? "GET, OPTIONS"
+                                                                                                        : "POST, OPTIONS");
+        return send_status(req, "405 Method Not Allowed", "Method not allowed");
     }
 
     void register_wifi_api_endpoints(httpd_handle_t server)
     {
-        private_register_endpoints(server, "/iot/mqtt", mqtt_get_handler, mqtt_post_handler);
-        private_register_endpoints(server, "/iot/mqtt_status", mqtt_status_handler, nullptr);
-        private_register_endpoints(server, "/iot/wifi_sta", wifi_sta_get_handler, wifi_sta_post_handler);
-        private_register_endpoints(server, "/iot/wifi_status", wifi_status_handler, nullptr);
-        private_register_endpoints(server, "/iot/wifi_scan", wifi_scan_handler, nullptr);
-        private_register_endpoints(server, "/iot/wifi_ap", wifi_ap_get_handler, wifi_ap_post_handler);
-        private_register_endpoints(server, "/iot/fs", fs_list_handler, nullptr);
-        private_register_endpoints(server, "/iot/ota", nullptr, ota_post_handler);
-        private_register_endpoints(server, "/iot/ping", [](httpd_req_t *req)
-                                   {
-                SET_RESP_HEADERS(req);
-                return httpd_resp_send(req, nullptr, 0); }, nullptr);
+        if (!server)
+            return;
 
-#ifdef CONFIG_IOT_FEATURE_CAMERA
-        private_register_endpoints(server, "/iot/camera", camera_api::camera_get, camera_api::camera_post);
-        private_register_endpoints(server, "/camera_save", nullptr, camera_api::camera_save);
-#endif
+        static constexpr httpd_method_t METHODS[] = {HTTP_GET, HTTP_POST, HTTP_OPTIONS};
+        for (httpd_method_t method : METHODS)
+        {
+            httpd_uri_t uri = {};
+            uri.uri = "/*";
+            uri.method = method;
+            uri.handler = dispatch;
+            ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server, &uri));
+        }
+        ESP_LOGI(TAG, "%u routes", (unsigned)ROUTE_COUNT);
     }
 
     static bool _server_started = false;
@@ -368,16 +485,35 @@ namespace api
     void task_start_server(void *)
     {
         httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-        config.max_open_sockets = 5;
-        config.max_uri_handlers = 50;
-        config.lru_purge_enable = true;
-        config.max_resp_headers = 5;
+        // sockets API + WebSocket ; au-delà, open_fn répond 503 et ferme
+        config.max_open_sockets = conn_budget::limit(conn_budget::Pool::API) + conn_budget::limit(conn_budget::Pool::WS);
+        config.max_uri_handlers = 8; // dispatcher (GET, POST, OPTIONS) + WebSocket
+        config.uri_match_fn = httpd_uri_match_wildcard;
+        // la purge LRU fermerait aussi les WebSockets : remplacée par le balayage d'inactivité
+        config.lru_purge_enable = false;
+        config.open_fn = conn_budget::on_httpd_open;
+        config.close_fn = conn_budget::on_httpd_close;
+#ifdef CONFIG_IOT_CONN_TCP_KEEPALIVE
+        // détecte les pairs disparus (WebSocket, flux) sans trafic applicatif
+        config.keep_alive_enable = true;
+        config.keep_alive_idle = 10;
+        config.keep_alive_interval = 5;
+        config.keep_alive_count = 3;
+#endif
+        config.max_resp_headers = 8; // CORS (3) + ETag + Cache-Control + marge
         config.server_port = 80;
         config.stack_size = STACK_SIZE_HTTPD;
 
+        http_body::init();
+        http_async::init();
         if (httpd_start(&server, &config) == ESP_OK)
         {
+            // httpd prend le premier handler qui correspond : /iot/ws avant le wildcard
+#ifdef CONFIG_IOT_HTTP_WS_ENABLE
+            ws_push::init(server);
+#endif
             register_wifi_api_endpoints(server);
+            conn_budget::start_idle_sweep(server);
         }
 
         vTaskDelete(nullptr);
@@ -398,9 +534,24 @@ namespace api
             e.type = EventType::NONE;
             EventBus::getInstance().emit(e);
         }
+        else if (evt->type == EventType::HTTP_REQUEST_RELEASE)
+        {
+            http_body::on_release_event(evt->data_len ? evt->data[0] : http_body::NO_SLOT, evt->user_ctx);
+        }
     }
     httpd_handle_t get_server()
     {
         return server;
     }
+
+    // Abonnement dans ce seul TU : depuis api.h, chaque fichier qui l'inclut
+    // aurait sa propre copie (liaison interne) et on_event serait appelé plusieurs fois
+    struct register_event_bus
+    {
+        register_event_bus()
+        {
+            EventBus::getInstance().subscribe(on_event, TAG);
+        }
+    };
+    static register_event_bus reg;
 }
@@ -9,7 +9,7 @@ namespace api
 {
     static constexpr const char *TAG = "[API]";
     esp_err_t emit_event_and_wait_response(EventType req_type, EventType expected_resp_type, httpd_req_t *req);
-    esp_err_t handle_post_request(EventType post_req_type, EventType expected_resp_type, httpd_req_t *req);
+    esp_err_t handle_post_request(EventType post_req_type, EventType expected_resp_type, httpd_req_t *req, size_t limit);
 
     esp_err_t wifi_sta_get_handler(httpd_req_t *req);
     esp_err_t wifi_sta_post_handler(httpd_req_t *req);
@@ -23,9 +23,16 @@ namespace api
 
     esp_err_t fs_list_handler(httpd_req_t *req);
 
-    void private_register_endpoints(httpd_handle_t server, const char *base_path,
-                                    http_handler_t get_handler,
-                                    http_handler_t post_handler);
+    struct Route
+    {
+        const char *path; // sans query string
+        http_handler_t get;
+        http_handler_t post;
+    };
+
+    const Route *find_route(const char *uri);
+    // Handler wildcard unique : route, pré-vol CORS, 404 / 405
+    esp_err_t dispatch(httpd_req_t *req);
     // Appelle cette fonction dans ton main pour tout enregistrer d’un coup
     void register_wifi_api_endpoints(httpd_handle_t server);
 
@@ -36,21 +43,6 @@ namespace api
     void on_event(const Event *evt);
 
     httpd_handle_t get_server();
-    static bool subscribed = false;
-    struct register_event_bus
-    {
-        register_event_bus()
-        {
-            if (!subscribed)
-            {
-                EventBus::getInstance().subscribe(on_event, TAG);
-                subscribed = true;
-            }
-        }
-    };
-
-    inline static register_event_bus reg;
-
 }
 
 #endif
@@ -0,0 +1,338 @@
+#include "config_bulk.h"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "http_async.h"
+#include "http_body.h"
+#include "json_stream.h"
+#include "macro.h"
+#include "persistence.h"
+#include "snapshot.h"
+#include "types.h"
+#include "MqttClient.hpp"
+#include "WiFiConfig.h"
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+#include "camera_controller.h"
+#endif
+
+namespace config_bulk
+{
+    static constexpr const char *KEY_STA = "wifi_sta";
+    static constexpr const char *KEY_AP = "wifi_ap";
+    static constexpr const char *KEY_MQTT = "mqtt";
+    static constexpr const char *KEY_CAMERA = "camera";
+    static constexpr TickType_t APPLY_TIMEOUT = pdMS_TO_TICKS(2000);
+
+    // Document validé, en attente d'application par le bus
+    struct Transaction
+    {
+        bool has_sta = false;
+        bool has_ap = false;
+        bool has_mqtt = false;
+        net_sta_config_t sta = {};
+        net_ap_config_t ap = {};
+        mqtt_client_config_t mqtt = {};
+        cJSON *camera = nullptr; // détaché du document
+        persist::Batch batch;    // rempli par le bus après application
+
+        ~Transaction() { cJSON_Delete(camera); }
+    };
+
+    // Une seule transaction à la fois ; le bus la récupère ici (pas de pointeur dans l'event)
+    static std::mutex s_mutex;
+    static std::shared_ptr<Transaction> s_pending;
+
+    esp_err_t get_handler(httpd_req_t *req)
+    {
+        JsonStream w(req);
+        w.beginObject();
+        const snapshot::Key keys[] = {snapshot::Key::WIFI_STA, snapshot::Key::WIFI_AP, snapshot::Key::MQTT_CONFIG};
+        const char *names[] = {KEY_STA, KEY_AP, KEY_MQTT};
+        for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+        {
+            auto body = snapshot::get(keys[i]);
+            if (body)
+                w.raw(names[i], body->data(), body->size());
+            else
+                w.null(names[i]);
+        }
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+        cJSON *cam = cJSON_CreateObject();
+        char *cam_json = nullptr;
+        if (cam && camera_controller::CameraController::getInstance().fill_json(cam))
+            cam_json = cJSON_PrintUnformatted(cam);
+        if (cam_json)
+            w.raw(KEY_CAMERA, cam_json, strlen(cam_json));
+        else
+            w.null(KEY_CAMERA);
+        cJSON_free(cam_json);
+        cJSON_Delete(cam);
+#endif
+        w.endObject();
+        return w.finish();
+    }
+
+    // Les fonctions *_from_json des modules prennent du texte
+    template <typename Parse>
+    static bool parse_section(const cJSON *section, Parse parse)
+    {
+        if (!cJSON_IsObject(section))
+            return false;
+        char *json = cJSON_PrintUnformatted(section);
+        if (!json)
+            return false;
+        bool ok = parse(json);
+        cJSON_free(json);
+        return ok;
+    }
+
+    static bool validate_sta(const cJSON *section, Transaction &tx)
+    {
+        const cJSON *stations = cJSON_GetObjectItemCaseSensitive(section, "stations");
+        if (!cJSON_IsArray(stations) || cJSON_GetArraySize(stations) > WIFI_MAX_NETWORKS)
+            return false;
+        const cJSON *item = nullptr;
+        cJSON_ArrayForEach(item, stations)
+        {
+            const cJSON *ssid = cJSON_GetObjectItemCaseSensitive(item, "ssid");
+            const cJSON *pwd = cJSON_GetObjectItemCaseSensitive(item, "password");
+            if (!cJSON_IsString(ssid) || !cJSON_IsString(pwd) || !ssid->valuestring[0] ||
+                strlen(ssid->valuestring) >= WIFI_MAX_SSID_LEN || strlen(pwd->valuestring) >= WIFI_MAX_PASS_LEN)
+                return false;
+        }
+        tx.sta = *WiFiConfig::getInstance().get_sta();
+        return parse_section(section, [&](const char *json)
+                             { return WiFiConfig::sta_from_json(json, &tx.sta); });
+    }
+
+    static bool validate_ap(const cJSON *section, Transaction &tx)
+    {
+        tx.ap = *WiFiConfig::getInstance().get_ap();
+        if (!parse_section(section, [&](const char *json)
+                           { return WiFiConfig::ap_from_json(json, &tx.ap); }))
+            return false;
+        return WiFiConfig::ap_valid(&tx.ap);
+    }
+
+    static bool validate_mqtt(const cJSON *section, Transaction &tx)
+    {
+        tx.mqtt = MqttClient::getConfig();
+        if (!parse_section(section, [&](const char *json)
+                           { return MqttClient::parseConfig(json, tx.mqtt); }))
+            return false;
+        return !tx.mqtt.enabled || tx.mqtt.broker_uri[0];
+    }
+
+    // Tout est vérifié avant application ; invalid reçoit le nom des sections refusées
+    static bool validate(cJSON *root, Transaction &tx, cJSON *invalid)
+    {
+        bool any = false;
+        const cJSON *section = nullptr;
+        cJSON_ArrayForEach(section, root)
+        {
+            const char *key = section->string;
+            bool ok;
+            if (strcmp(key, KEY_STA) == 0)
+                ok = tx.has_sta = validate_sta(section, tx);
+            else if (strcmp(key, KEY_AP) == 0)
+                ok = tx.has_ap = validate_ap(section, tx);
+            else if (strcmp(key, KEY_MQTT) == 0)
+                ok = tx.has_mqtt = validate_mqtt(section, tx);
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+            else if (strcmp(key, KEY_CAMERA) == 0)
+                ok = camera_controller::CameraController::validate_json(section);
+#endif
+            else
+                ok = false; // section inconnue : probablement une faute de frappe
+            if (!ok)
+                cJSON_AddItemToArray(invalid, cJSON_CreateString(key));
+            any = true;
+        }
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+        if (cJSON_GetArraySize(invalid) == 0)
+            tx.camera = cJSON_DetachItemFromObjectCaseSensitive(root, KEY_CAMERA);
+#endif
+        return any && cJSON_GetArraySize(invalid) == 0;
+    }
+
+    // Dans la tâche du bus, comme les POST de chaque module
+    static void apply(Transaction &tx)
+    {
+        WiFiConfig &wifi = WiFiConfig::getInstance();
+        if (tx.has_sta)
+        {
+            wifi.update_sta(&tx.sta);
+            tx.batch.add(STA_CFG_PATH, wifi.get_sta(), sizeof(net_sta_config_t));
+        }
+        if (tx.has_ap)
+        {
+            wifi.update_ap(&tx.ap);
+            tx.batch.add(AP_CFG_PATH, wifi.get_ap(), sizeof(net_ap_config_t));
+        }
+        if (tx.has_mqtt)
+        {
+            MqttClient::setConfig(tx.mqtt, false);
+            tx.batch.add(MQTT_CFG_PATH, &MqttClient::getConfig(), sizeof(mqtt_client_config_t));
+        }
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+        if (tx.camera)
+        {
+            auto &cam = camera_controller::CameraController::getInstance();
+            if (cam.patch_json(tx.camera))
+                cam.stage_save(tx.batch);
+            else
+                ESP_LOGW(TAG, "Camera settings partially applied");
+        }
+#endif
+    }
+
+    void on_event(const Event *evt)
+    {
+        if (evt->type != EventType::CONFIG_BULK_APPLY || !evt->user_ctx)
+            return;
+        std::shared_ptr<Transaction> tx;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            tx = std::move(s_pending);
+        }
+        // le handler a abandonné avant qu'on la prenne : rien à faire
+        if (!tx)
+            return;
+        apply(*tx);
+        Event e = {};
+        e.type = EventType::CONFIG_BULK_APPLIED;
+        xQueueSend(static_cast<QueueHandle_t>(evt->user_ctx), &e, 0);
+    }
+
+    static esp_err_t send_json(httpd_req_t *req, const char *status, cJSON *root)
+    {
+        char *json = cJSON_PrintUnformatted(root);
+        cJSON_Delete(root);
+        if (!json)
+            return httpd_resp_send_500(req);
+        SET_RESP_HEADERS(req);
+        httpd_resp_set_status(req, status);
+        esp_err_t err = httpd_resp_send(req, json, strlen(json));
+        cJSON_free(json);
+        return err;
+    }
+
+    static esp_err_t send_error(httpd_req_t *req, const char *status, const char *message)
+    {
+        cJSON *root = cJSON_CreateObject();
+        cJSON_AddStringToObject(root, "error", message);
+        return send_json(req, status, root);
+    }
+
+    // tx déjà placée dans s_pending ; false si elle n'a pas été appliquée
+    static bool apply_on_bus(const std::shared_ptr<Transaction> &tx)
+    {
+        QueueHandle_t resp_queue = xQueueCreate(1, sizeof(Event));
+        if (!resp_queue)
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_pending.reset();
+            return false;
+        }
+        Event evt = {};
+        evt.type = EventType::CONFIG_BULK_APPLY;
+        evt.user_ctx = resp_queue;
+        EventBus::getInstance().emit(evt);
+
+        Event resp;
+        bool applied = xQueueReceive(resp_queue, &resp, APPLY_TIMEOUT) == pdTRUE;
+        if (!applied)
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            // toujours en attente (event perdu, bus saturé) : on la retire
+            if (s_pending == tx)
+                s_pending.reset();
+            else
+                applied = xQueueReceive(resp_queue, &resp, APPLY_TIMEOUT) == pdTRUE;
+        }
+        if (applied)
+        {
+            vQueueDelete(resp_queue);
+        }
+        else
+        {
+            http_body::Lease none;
+            http_body::release_later(none, resp_queue);
+        }
+        return applied;
+    }
+
+    esp_err_t post_handler(httpd_req_t *req)
+    {
+        // parse + écritures fichiers : hors de la tâche httpd
+        HTTP_RUN_ASYNC(req, post_handler);
+
+        http_body::Lease body;
+        if (http_body::receive(req, http_body::BUF_SIZE, body) != ESP_OK)
+            return ESP_FAIL;
+        cJSON *root = cJSON_ParseWithLength(body.data, body.len);
+        http_body::release(body);
+        if (!cJSON_IsObject(root))
+        {
+            cJSON_Delete(root);
+            return send_error(req, "400 Bad Request", "Expected a JSON object");
+        }
+
+        auto tx = std::make_shared<Transaction>();
+        cJSON *invalid = cJSON_CreateArray();
+        bool valid = validate(root, *tx, invalid);
+        cJSON_Delete(root);
+        if (!valid)
+        {
+            cJSON *err = cJSON_CreateObject();
+            cJSON_AddStringToObject(err, "error", "Invalid config, nothing applied");
+            cJSON_AddItemToObject(err, "invalid", invalid);
+            return send_json(req, "400 Bad Request", err);
+        }
+        cJSON_Delete(invalid);
+
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (s_pending)
+            {
+                httpd_resp_set_hdr(req, "Retry-After", "1");
+                return send_error(req, "409 Conflict", "Another config transaction is in progress");
+            }
+            s_pending = tx;
+        }
+        if (!apply_on_bus(tx))
+        {
+            httpd_resp_set_hdr(req, "Retry-After", "1");
+            return send_error(req, "503 Service Unavailable", "Config not applied");
+        }
+
+        bool persisted = tx->batch.commit();
+        cJSON *resp = cJSON_CreateObject();
+        cJSON *applied = cJSON_AddArrayToObject(resp, "applied");
+        if (tx->has_sta)
+            cJSON_AddItemToArray(applied, cJSON_CreateString(KEY_STA));
+        if (tx->has_ap)
+            cJSON_AddItemToArray(applied, cJSON_CreateString(KEY_AP));
+        if (tx->has_mqtt)
+            cJSON_AddItemToArray(applied, cJSON_CreateString(KEY_MQTT));
+        if (tx->camera)
+            cJSON_AddItemToArray(applied, cJSON_CreateString(KEY_CAMERA));
+        cJSON_AddNumberToObject(resp, "files", tx->batch.size());
+        cJSON_AddBoolToObject(resp, "persisted", persisted);
+        ESP_LOGI(TAG, "Config applied, %u files %s", (unsigned)tx->batch.size(), persisted ? "saved" : "NOT saved");
+        return send_json(req, persisted ? "200 OK" : "500 Internal Server Error", resp);
+    }
+
+    // Un seul abonnement : config_bulk.h est aussi inclus par api.cpp
+    struct register_event_bus
+    {
+        register_event_bus()
+        {
+            EventBus::getInstance().subscribe(on_event, TAG);
+        }
+    };
+    static register_event_bus reg;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#ifndef __API_CONFIG_BULK_H__
+#define __API_CONFIG_BULK_H__
+#include "esp_http_server.h"
+#include "event_bus.h"
+
+/**
+ * /iot/config : configuration complète de l'appareil en une requête.
+ *
+ *   GET  -> {"wifi_sta":{...},"wifi_ap":{...},"mqtt":{...},"camera":{...}}
+ *   POST -> même document, sections facultatives
+ *
+ * Le POST valide toutes les sections avant de toucher à quoi que ce soit
+ * (400 + liste des sections invalides sinon), les applique en un seul event
+ * sur le bus puis écrit tous les fichiers dans un persist::Batch.
+ */
+namespace config_bulk
+{
+    static constexpr const char *TAG = "[CONFIG_BULK]";
+
+    esp_err_t get_handler(httpd_req_t *req);
+    esp_err_t post_handler(httpd_req_t *req);
+
+    void on_event(const Event *evt);
+}
+
+#endif
@@ -0,0 +1,245 @@
+#include "conn_budget.h"
+#include <cstring>
+#include <mutex>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#ifdef CONFIG_IOT_HTTP_WS_ENABLE
+#include "ws_push.h"
+#endif
+
+namespace conn_budget
+{
+#ifdef CONFIG_IOT_HTTP_WS_ENABLE
+    static constexpr size_t WS_MAX = CONFIG_IOT_HTTP_WS_MAX_CLIENTS;
+#else
+    static constexpr size_t WS_MAX = 0;
+#endif
+    static constexpr size_t LIMITS[] = {CONFIG_IOT_CONN_API_MAX, CONFIG_IOT_CONN_STREAM_MAX, WS_MAX};
+    static constexpr size_t POOL_COUNT = static_cast<size_t>(Pool::COUNT);
+    static constexpr size_t MAX_TRACKED = CONFIG_IOT_CONN_API_MAX + CONFIG_IOT_CONN_STREAM_MAX + WS_MAX;
+    static constexpr int64_t IDLE_TIMEOUT_US = (int64_t)CONFIG_IOT_CONN_IDLE_TIMEOUT_S * 1000 * 1000;
+    static constexpr uint64_t SWEEP_PERIOD_US = 5 * 1000 * 1000;
+    static const char *const NAMES[] = {"api", "stream", "ws"};
+    static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == POOL_COUNT, "pool names");
+
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+    // httpd (écoute + contrôle), écoute MJPEG, MQTT, DNS/SNTP
+    static constexpr size_t RESERVED_SOCKETS = 6;
+    static_assert(MAX_TRACKED + RESERVED_SOCKETS <= CONFIG_LWIP_MAX_SOCKETS,
+                  "connection budget exceeds CONFIG_LWIP_MAX_SOCKETS");
+#endif
+
+    struct Conn
+    {
+        int fd = -1;
+        Pool pool = Pool::API;
+        int64_t last_us = 0;
+        uint8_t busy = 0; // requêtes async en cours
+    };
+
+    struct Stats
+    {
+        uint32_t active;
+        uint32_t peak;
+        uint32_t accepted;
+        uint32_t rejected;
+        uint32_t idle_closed;
+    };
+
+    static std::mutex s_mutex;
+    static Conn s_conns[MAX_TRACKED];
+    static Stats s_stats[POOL_COUNT] = {};
+    static httpd_handle_t s_server = nullptr;
+    static esp_timer_handle_t s_sweep_timer = nullptr;
+
+    size_t limit(Pool pool)
+    {
+        return pool < Pool::COUNT ? LIMITS[static_cast<size_t>(pool)] : 0;
+    }
+
+    // s_mutex tenu
+    static Conn *find_locked(int fd)
+    {
+        for (auto &c : s_conns)
+            if (c.fd == fd)
+                return &c;
+        return nullptr;
+    }
+
+    bool acquire(Pool pool, int fd)
+    {
+        if (pool >= Pool::COUNT || fd < 0)
+            return false;
+        size_t index = static_cast<size_t>(pool);
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Stats &st = s_stats[index];
+        Conn *slot = find_locked(-1);
+        if (st.active >= LIMITS[index] || !slot)
+        {
+            st.rejected++;
+            return false;
+        }
+        slot->fd = fd;
+        slot->pool = pool;
+        slot->last_us = esp_timer_get_time();
+        st.accepted++;
+        if (++st.active > st.peak)
+            st.peak = st.active;
+        return true;
+    }
+
+    bool move(int fd, Pool to)
+    {
+        if (to >= Pool::COUNT)
+            return false;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Conn *c = find_locked(fd);
+        if (!c)
+            return false;
+        if (c->pool == to)
+            return true;
+        Stats &dst = s_stats[static_cast<size_t>(to)];
+        if (dst.active >= LIMITS[static_cast<size_t>(to)])
+        {
+            dst.rejected++;
+            return false;
+        }
+        s_stats[static_cast<size_t>(c->pool)].active--;
+        c->pool = to;
+        dst.accepted++;
+        if (++dst.active > dst.peak)
+            dst.peak = dst.active;
+        return true;
+    }
+
+    void touch(int fd)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Conn *c = find_locked(fd);
+        if (c)
+            c->last_us = esp_timer_get_time();
+    }
+
+    void begin_busy(int fd)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Conn *c = find_locked(fd);
+        if (c)
+            c->busy++;
+    }
+
+    // L'inactivité se compte à partir de la fin de la réponse
+    void end_busy(int fd)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Conn *c = find_locked(fd);
+        if (!c)
+            return;
+        if (c->busy)
+            c->busy--;
+        c->last_us = esp_timer_get_time();
+    }
+
+    void release(int fd)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Conn *c = find_locked(fd);
+        if (!c)
+            return;
+        s_stats[static_cast<size_t>(c->pool)].active--;
+        *c = Conn{};
+    }
+
+    void reject_raw(int fd)
+    {
+        static const char RESP[] =
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Retry-After: 2\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n\r\n";
+        send(fd, RESP, sizeof(RESP) - 1, MSG_DONTWAIT);
+    }
+
+    esp_err_t on_httpd_open(httpd_handle_t, int fd)
+    {
+        if (acquire(Pool::API, fd))
+            return ESP_OK;
+        ESP_LOGW(TAG, "API budget full, rejecting %d", fd);
+        reject_raw(fd);
+        return ESP_FAIL; // httpd supprime la session -> on_httpd_close
+    }
+
+    void on_httpd_close(httpd_handle_t, int fd)
+    {
+#ifdef CONFIG_IOT_HTTP_WS_ENABLE
+        ws_push::on_close(fd);
+#endif
+        release(fd);
+        // avec un close_fn, la fermeture du socket est à notre charge
+        close(fd);
+    }
+
+    // Exécuté dans la tâche httpd (httpd_queue_work)
+    static void sweep_work(void *)
+    {
+        int idle[MAX_TRACKED];
+        size_t count = 0;
+        {
+            int64_t now = esp_timer_get_time();
+            std::lock_guard<std::mutex> lock(s_mutex);
+            for (auto &c : s_conns)
+            {
+                if (c.fd >= 0 && c.pool == Pool::API && !c.busy && now - c.last_us > IDLE_TIMEOUT_US)
+                {
+                    idle[count++] = c.fd;
+                    // évite de la compter deux fois si la fermeture tarde
+                    c.last_us = now;
+                    s_stats[static_cast<size_t>(Pool::API)].idle_closed++;
+                }
+            }
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            ESP_LOGD(TAG, "Closing idle connection %d", idle[i]);
+            httpd_sess_trigger_close(s_server, idle[i]);
+        }
+    }
+
+    static void sweep_timer_cb(void *)
+    {
+        if (s_server)
+            httpd_queue_work(s_server, sweep_work, nullptr);
+    }
+
+    void start_idle_sweep(httpd_handle_t server)
+    {
+        s_server = server;
+        if (s_sweep_timer)
+            return;
+        esp_timer_create_args_t args = {};
+        args.callback = sweep_timer_cb;
+        args.name = "conn_sweep";
+        if (esp_timer_create(&args, &s_sweep_timer) != ESP_OK ||
+            esp_timer_start_periodic(s_sweep_timer, SWEEP_PERIOD_US) != ESP_OK)
+            ESP_LOGE(TAG, "Idle sweep timer failed");
+    }
+
+    void stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        cJSON_AddNumberToObject(obj, "idle_timeout_s", CONFIG_IOT_CONN_IDLE_TIMEOUT_S);
+        for (size_t i = 0; i < POOL_COUNT; ++i)
+        {
+            cJSON *pool = cJSON_AddObjectToObject(obj, NAMES[i]);
+            cJSON_AddNumberToObject(pool, "limit", LIMITS[i]);
+            cJSON_AddNumberToObject(pool, "active", s_stats[i].active);
+            cJSON_AddNumberToObject(pool, "peak", s_stats[i].peak);
+            cJSON_AddNumberToObject(pool, "accepted", s_stats[i].accepted);
+            cJSON_AddNumberToObject(pool, "rejected", s_stats[i].rejected);
+            cJSON_AddNumberToObject(pool, "idle_closed", s_stats[i].idle_closed);
+        }
+    }
+}
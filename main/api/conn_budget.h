@@ -0,0 +1,57 @@
+#pragma once
+#ifndef __API_CONN_BUDGET_H__
+#define __API_CONN_BUDGET_H__
+#include <cstddef>
+#include <cstdint>
+#include "cJSON.h"
+#include "esp_http_server.h"
+#include "sdkconfig.h"
+
+/**
+ * Répartition des sockets lwIP entre les clients de l'API (httpd), les flux
+ * MJPEG (port 8081) et les WebSockets. Chaque pool a un plafond fixe : un
+ * client en trop reçoit tout de suite un 503 brut et son socket est fermé,
+ * au lieu d'épuiser les sockets du système ou de créer une tâche de plus.
+ *
+ * Les sockets httpd entrent dans le pool API (open_fn) et passent dans le pool
+ * WS à l'upgrade. Les connexions keep-alive de l'API inactives depuis
+ * IOT_CONN_IDLE_TIMEOUT_S sont fermées par un balayage périodique ; une
+ * connexion dont la requête tourne sur un worker http_async n'est jamais
+ * fermée, quelle que soit la durée de la réponse.
+ */
+namespace conn_budget
+{
+    static constexpr const char *TAG = "[CONN]";
+
+    enum class Pool : uint8_t
+    {
+        API,
+        STREAM,
+        WS,
+        COUNT
+    };
+
+    size_t limit(Pool pool);
+
+    // false si le pool est plein (compté comme rejet)
+    bool acquire(Pool pool, int fd);
+    // Change de pool un socket déjà compté (upgrade WebSocket)
+    bool move(int fd, Pool to);
+    void touch(int fd);
+    // Requête confiée à un worker (http_async::submit -> handler_complete)
+    void begin_busy(int fd);
+    void end_busy(int fd);
+    void release(int fd);
+
+    // Réponse 503 minimale sur un socket qu'on va fermer
+    void reject_raw(int fd);
+
+    // Callbacks httpd_config_t::open_fn / close_fn
+    esp_err_t on_httpd_open(httpd_handle_t hd, int fd);
+    void on_httpd_close(httpd_handle_t hd, int fd);
+
+    void start_idle_sweep(httpd_handle_t server);
+    void stats_to_json(cJSON *obj);
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "http_async.h"
+#include <mutex>
+#include "conn_budget.h"
+#include "route_stats.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+namespace http_async
+{
+    struct Job
+    {
+        httpd_req_t *req; // copie obtenue par httpd_req_async_handler_begin
+        http_handler_t handler;
+        int fd; // connexion marquée occupée (conn_budget) jusqu'à la fin
+        int64_t queued_us;
+        route_stats::Sample sample; // path == nullptr : hors dispatcher, non mesuré
+    };
+
+    struct Stats
+    {
+        uint32_t submitted;
+        uint32_t completed;
+        uint32_t rejected;
+        uint32_t running;
+        uint32_t wait_max_us;
+        uint32_t run_max_us;
+        uint64_t run_sum_us;
+    };
+
+    static QueueHandle_t s_queue = nullptr;
+    static TaskHandle_t s_workers[CONFIG_IOT_HTTP_ASYNC_WORKERS] = {};
+    static std::mutex s_mutex;
+    static Stats s_stats = {};
+
+    static void worker_task(void *)
+    {
+        Job job;
+        while (true)
+        {
+            if (xQueueReceive(s_queue, &job, portMAX_DELAY) != pdTRUE)
+                continue;
+
+            int64_t start = esp_timer_get_time();
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                s_stats.running++;
+                uint32_t wait = (uint32_t)(start - job.queued_us);
+                if (wait > s_stats.wait_max_us)
+                    s_stats.wait_max_us = wait;
+            }
+
+            esp_err_t err = job.handler(job.req);
+            httpd_req_async_handler_complete(job.req);
+            conn_budget::end_busy(job.fd);
+            if (job.sample.path)
+                route_stats::end(job.sample, err != ESP_OK);
+
+            uint32_t run = (uint32_t)(esp_timer_get_time() - start);
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stats.running--;
+            s_stats.completed++;
+            s_stats.run_sum_us += run;
+            if (run > s_stats.run_max_us)
+                s_stats.run_max_us = run;
+        }
+    }
+
+    void init()
+    {
+        if (s_queue)
+            return;
+        s_queue = xQueueCreate(CONFIG_IOT_HTTP_ASYNC_QUEUE_LEN, sizeof(Job));
+        if (!s_queue)
+        {
+            ESP_LOGE(TAG, "Queue creation failed");
+            return;
+        }
+        for (int i = 0; i < CONFIG_IOT_HTTP_ASYNC_WORKERS; ++i)
+            xTaskCreate(worker_task, "httpd_async_wrk", CONFIG_IOT_HTTP_ASYNC_STACK_SIZE, nullptr, tskIDLE_PRIORITY + 5, &s_workers[i]);
+    }
+
+    bool on_worker()
+    {
+        TaskHandle_t self = xTaskGetCurrentTaskHandle();
+        for (auto worker : s_workers)
+            if (worker && worker == self)
+                return true;
+        return false;
+    }
+
+    static esp_err_t reject(httpd_req_t *req)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stats.rejected++;
+        }
+        SET_CORS_HEADERS(req);
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, nullptr, 0);
+    }
+
+    esp_err_t submit(httpd_req_t *req, http_handler_t handler)
+    {
+        if (!s_queue)
+            return handler(req); // pas de pool : exécution synchrone comme avant
+
+        Job job = {nullptr, handler, httpd_req_to_sockfd(req), esp_timer_get_time(), {}};
+        route_stats::Sample *sample = route_stats::current();
+        if (sample)
+            job.sample = *sample;
+        if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK)
+            return reject(req);
+
+        // avant l'envoi : le worker peut terminer avant le retour de xQueueSend
+        conn_budget::begin_busy(job.fd);
+        if (xQueueSend(s_queue, &job, 0) != pdTRUE)
+        {
+            conn_budget::end_busy(job.fd);
+            httpd_req_async_handler_complete(job.req);
+            return reject(req);
+        }
+        // le dispatcher n'enregistre plus : la mesure part avec le job
+        if (sample)
+            sample->deferred = true;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stats.submitted++;
+        return ESP_OK;
+    }
+
+    void stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        cJSON_AddNumberToObject(obj, "workers", CONFIG_IOT_HTTP_ASYNC_WORKERS);
+        cJSON_AddNumberToObject(obj, "queued", s_queue ? uxQueueMessagesWaiting(s_queue) : 0);
+        cJSON_AddNumberToObject(obj, "running", s_stats.running);
+        cJSON_AddNumberToObject(obj, "submitted", s_stats.submitted);
+        cJSON_AddNumberToObject(obj, "completed", s_stats.completed);
+        cJSON_AddNumberToObject(obj, "rejected", s_stats.rejected);
+        cJSON_AddNumberToObject(obj, "wait_max_us", s_stats.wait_max_us);
+        cJSON_AddNumberToObject(obj, "run_avg_us", s_stats.completed ? (double)(s_stats.run_sum_us / s_stats.completed) : 0);
+        cJSON_AddNumberToObject(obj, "run_max_us", s_stats.run_max_us);
+    }
+}
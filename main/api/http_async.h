@@ -0,0 +1,38 @@
+#pragma once
+#ifndef __API_HTTP_ASYNC_H__
+#define __API_HTTP_ASYNC_H__
+#include "cJSON.h"
+#include "esp_http_server.h"
+#include "macro.h"
+
+/**
+ * Exécution des handlers lents hors de la tâche httpd
+ * (httpd_req_async_handler_begin + pool de workers).
+ *
+ *   esp_err_t slow_handler(httpd_req_t *req)
+ *   {
+ *       HTTP_RUN_ASYNC(req, slow_handler);
+ *       ... // exécuté sur un worker
+ *   }
+ *
+ * Pendant ce temps la tâche httpd continue de servir les autres requêtes
+ * (/iot/ping, GET de config...). File pleine -> 503.
+ */
+namespace http_async
+{
+    static constexpr const char *TAG = "[HTTP_ASYNC]";
+
+    void init();
+    bool on_worker();
+    // Copie la requête et la confie à un worker ; répond 503 si la file est pleine
+    esp_err_t submit(httpd_req_t *req, http_handler_t handler);
+    void stats_to_json(cJSON *obj);
+}
+
+#define HTTP_RUN_ASYNC(req, handler)               \
+    if (!http_async::on_worker())                  \
+    {                                              \
+        return http_async::submit(req, handler);   \
+    }
+
+#endif
@@ -0,0 +1,224 @@
+#include "http_body.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "event_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "macro.h"
+
+namespace http_body
+{
+    // Un slot abandonné dont l'event de libération s'est perdu (bus plein) est récupéré après ce délai
+    static constexpr int64_t ORPHAN_RECLAIM_US = 5 * 1000 * 1000;
+    static constexpr int ACQUIRE_RETRIES = 20; // x 10 ms
+    static constexpr int RECV_TIMEOUT_RETRIES = 3;
+
+    struct Slot
+    {
+        char *buf;
+        bool busy;
+        int64_t orphaned_us; // 0 si détenu par un handler actif
+    };
+
+    struct Stats
+    {
+        uint32_t received;
+        uint32_t too_large;
+        uint32_t invalid;
+        uint32_t recv_errors;
+        uint32_t pool_busy;
+        uint32_t deferred;
+        uint32_t reclaimed;
+        uint32_t largest;
+    };
+
+    static std::mutex s_mutex;
+    static Slot s_slots[POOL_COUNT] = {};
+    static Stats s_stats = {};
+    static bool s_initialized = false;
+    // queues de réponse confiées à release_later et pas encore supprimées
+    static std::vector<void *> s_deferred_queues;
+
+    void init()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_initialized)
+            return;
+        for (auto &slot : s_slots)
+        {
+            slot.buf = static_cast<char *>(heap_caps_malloc(BUF_SIZE + 1, MALLOC_CAP_DEFAULT));
+            if (!slot.buf)
+                ESP_LOGE(TAG, "Body buffer allocation failed");
+        }
+        s_initialized = true;
+    }
+
+    static bool acquire(Lease &lease)
+    {
+        for (int attempt = 0; attempt < ACQUIRE_RETRIES; ++attempt)
+        {
+            {
+                int64_t now = esp_timer_get_time();
+                std::lock_guard<std::mutex> lock(s_mutex);
+                for (uint8_t i = 0; i < POOL_COUNT; ++i)
+                {
+                    Slot &slot = s_slots[i];
+                    if (!slot.buf)
+                        continue;
+                    if (slot.busy && slot.orphaned_us && now - slot.orphaned_us > ORPHAN_RECLAIM_US)
+                    {
+                        slot.busy = false;
+                        s_stats.reclaimed++;
+                    }
+                    if (!slot.busy)
+                    {
+                        slot.busy = true;
+                        slot.orphaned_us = 0;
+                        lease.slot = i;
+                        lease.data = slot.buf;
+                        lease.len = 0;
+                        return true;
+                    }
+                }
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        return false;
+    }
+
+    static esp_err_t reject(httpd_req_t *req, const char *status, const char *message, uint32_t Stats::*counter)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stats.*counter += 1;
+        }
+        ESP_LOGW(TAG, "%s: %s", req->uri, message);
+        char json[96];
+        snprintf(json, sizeof(json), "{\"error\":\"%s\"}", message);
+        SET_RESP_HEADERS(req);
+        httpd_resp_set_status(req, status);
+        httpd_resp_send(req, json, strlen(json));
+        return ESP_FAIL;
+    }
+
+    esp_err_t receive(httpd_req_t *req, size_t limit, Lease &lease)
+    {
+        init();
+        size_t len = req->content_len;
+        if (limit > BUF_SIZE)
+            limit = BUF_SIZE;
+        if (len == 0)
+            return reject(req, "400 Bad Request", "Empty body", &Stats::invalid);
+        // refusé avant de lire le moindre octet
+        if (len > limit)
+            return reject(req, "413 Payload Too Large", "Body too large", &Stats::too_large);
+        if (!acquire(lease))
+        {
+            httpd_resp_set_hdr(req, "Retry-After", "1");
+            return reject(req, "503 Service Unavailable", "Busy", &Stats::pool_busy);
+        }
+
+        size_t received = 0;
+        int timeouts = 0;
+        while (received < len)
+        {
+            size_t want = len - received;
+            if (want > CONFIG_IOT_HTTP_BODY_RECV_CHUNK)
+                want = CONFIG_IOT_HTTP_BODY_RECV_CHUNK;
+            int r = httpd_req_recv(req, lease.data + received, want);
+            if (r == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts <= RECV_TIMEOUT_RETRIES)
+                continue;
+            if (r <= 0)
+            {
+                release(lease);
+                return reject(req, "408 Request Timeout", "Body receive failed", &Stats::recv_errors);
+            }
+            received += r;
+        }
+        lease.data[received] = '\0';
+        lease.len = received;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stats.received++;
+        if (received > s_stats.largest)
+            s_stats.largest = received;
+        return ESP_OK;
+    }
+
+    void release(Lease &lease)
+    {
+        if (lease.slot < POOL_COUNT)
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_slots[lease.slot].busy = false;
+            s_slots[lease.slot].orphaned_us = 0;
+        }
+        lease = Lease{};
+    }
+
+    void release_later(Lease &lease, void *resp_queue)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (lease.slot < POOL_COUNT)
+            {
+                s_slots[lease.slot].orphaned_us = esp_timer_get_time();
+                s_stats.deferred++;
+            }
+            if (resp_queue)
+                s_deferred_queues.push_back(resp_queue);
+        }
+        Event evt = {};
+        evt.type = EventType::HTTP_REQUEST_RELEASE;
+        evt.data[0] = lease.slot;
+        evt.data_len = 1;
+        evt.user_ctx = resp_queue;
+        EventBus::getInstance().emit(evt);
+        lease = Lease{};
+    }
+
+    // Idempotent : un second event pour la même libération ne fait rien
+    void on_release_event(uint8_t slot, void *resp_queue)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (resp_queue)
+        {
+            auto it = std::find(s_deferred_queues.begin(), s_deferred_queues.end(), resp_queue);
+            if (it != s_deferred_queues.end())
+            {
+                s_deferred_queues.erase(it);
+                vQueueDelete(static_cast<QueueHandle_t>(resp_queue));
+            }
+        }
+        // déjà récupéré et réattribué entre-temps : ne pas toucher
+        if (slot < POOL_COUNT && s_slots[slot].orphaned_us)
+        {
+            s_slots[slot].busy = false;
+            s_slots[slot].orphaned_us = 0;
+        }
+    }
+
+    void stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        uint32_t busy = 0;
+        for (auto &slot : s_slots)
+            busy += slot.busy ? 1 : 0;
+        cJSON_AddNumberToObject(obj, "pool", POOL_COUNT);
+        cJSON_AddNumberToObject(obj, "buf_size", BUF_SIZE);
+        cJSON_AddNumberToObject(obj, "busy", busy);
+        cJSON_AddNumberToObject(obj, "received", s_stats.received);
+        cJSON_AddNumberToObject(obj, "largest", s_stats.largest);
+        cJSON_AddNumberToObject(obj, "too_large", s_stats.too_large);
+        cJSON_AddNumberToObject(obj, "invalid", s_stats.invalid);
+        cJSON_AddNumberToObject(obj, "recv_errors", s_stats.recv_errors);
+        cJSON_AddNumberToObject(obj, "pool_busy", s_stats.pool_busy);
+        cJSON_AddNumberToObject(obj, "deferred", s_stats.deferred);
+        cJSON_AddNumberToObject(obj, "reclaimed", s_stats.reclaimed);
+    }
+}
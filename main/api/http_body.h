@@ -0,0 +1,49 @@
+#pragma once
+#ifndef __API_HTTP_BODY_H__
+#define __API_HTTP_BODY_H__
+#include <cstddef>
+#include <cstdint>
+#include "cJSON.h"
+#include "esp_http_server.h"
+#include "sdkconfig.h"
+
+/**
+ * Réception des corps POST dans un pool de buffers fixes (alloués une fois),
+ * lus par morceaux : un corps trop gros (413) est rejeté avant lecture, sans
+ * allouer content_len octets. Le JSON est validé par le module qui le parse.
+ *
+ * Le buffer est passé par référence aux modules (http_body_ref_t dans Event::data).
+ * Si le handler HTTP abandonne avant la réponse, le buffer et la queue de
+ * réponse sont libérés par un event HTTP_REQUEST_RELEASE : le bus étant FIFO,
+ * il est traité après l'event qui les utilise.
+ */
+namespace http_body
+{
+    static constexpr const char *TAG = "[HTTP_BODY]";
+    static constexpr size_t POOL_COUNT = CONFIG_IOT_HTTP_BODY_POOL_COUNT;
+    static constexpr size_t BUF_SIZE = CONFIG_IOT_HTTP_BODY_BUF_SIZE;
+    static constexpr uint8_t NO_SLOT = 0xFF;
+
+    struct Lease
+    {
+        uint8_t slot = NO_SLOT;
+        char *data = nullptr; // terminé par '\0'
+        size_t len = 0;
+    };
+
+    // Alloue le pool (appelé au démarrage du serveur, idempotent)
+    void init();
+
+    // Lit le corps complet (<= limit).
+    // En cas d'échec la réponse d'erreur est déjà envoyée.
+    esp_err_t receive(httpd_req_t *req, size_t limit, Lease &lease);
+    void release(Lease &lease);
+
+    // Abandon côté handler : libération différée via le bus
+    void release_later(Lease &lease, void *resp_queue);
+    void on_release_event(uint8_t slot, void *resp_queue);
+
+    void stats_to_json(cJSON *obj);
+}
+
+#endif
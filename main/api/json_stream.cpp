@@ -0,0 +1,269 @@
+#include "json_stream.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "macro.h"
+
+namespace
+{
+    struct Stats
+    {
+        uint32_t responses;
+        uint32_t errors;
+        uint64_t bytes;
+        uint32_t chunks;
+        uint32_t largest;
+        uint32_t heap_peak_last;
+        uint32_t heap_peak_max;
+    };
+
+    std::mutex s_mutex;
+    Stats s_stats = {};
+}
+
+JsonStream::JsonStream(httpd_req_t *req) : req_(req)
+{
+    heap_start_ = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    heap_min_ = heap_start_;
+    SET_RESP_HEADERS(req_);
+}
+
+void JsonStream::key(const char *k)
+{
+    if (depth_ > 0)
+    {
+        if (!first_[depth_])
+            put(',');
+        first_[depth_] = false;
+    }
+    if (k)
+    {
+        put('"');
+        writeEscaped(k);
+        write("\":", 2);
+    }
+}
+
+void JsonStream::beginObject(const char *k)
+{
+    if (depth_ + 1u >= MAX_DEPTH)
+    {
+        err_ = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    key(k);
+    put('{');
+    first_[++depth_] = true;
+}
+
+void JsonStream::endObject()
+{
+    if (depth_ == 0)
+    {
+        err_ = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    put('}');
+    depth_--;
+}
+
+void JsonStream::beginArray(const char *k)
+{
+    if (depth_ + 1u >= MAX_DEPTH)
+    {
+        err_ = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    key(k);
+    put('[');
+    first_[++depth_] = true;
+}
+
+void JsonStream::endArray()
+{
+    if (depth_ == 0)
+    {
+        err_ = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    put(']');
+    depth_--;
+}
+
+void JsonStream::string(const char *k, const char *value)
+{
+    key(k);
+    if (!value)
+    {
+        write("null", 4);
+        return;
+    }
+    put('"');
+    writeEscaped(value);
+    put('"');
+}
+
+void JsonStream::number(const char *k, double value)
+{
+    key(k);
+    char tmp[32];
+    int n;
+    if (!std::isfinite(value))
+        n = snprintf(tmp, sizeof(tmp), "null");
+    else if (value == (double)(long long)value && std::fabs(value) < 1e15)
+        n = snprintf(tmp, sizeof(tmp), "%lld", (long long)value);
+    else
+        n = snprintf(tmp, sizeof(tmp), "%.15g", value);
+    write(tmp, n);
+}
+
+void JsonStream::boolean(const char *k, bool value)
+{
+    key(k);
+    if (value)
+        write("true", 4);
+    else
+        write("false", 5);
+}
+
+void JsonStream::null(const char *k)
+{
+    key(k);
+    write("null", 4);
+}
+
+void JsonStream::raw(const char *k, const char *json, size_t len)
+{
+    key(k);
+    if (!json || len == 0)
+        write("null", 4);
+    else
+        write(json, len);
+}
+
+void JsonStream::writeEscaped(const char *str)
+{
+    for (const char *p = str; *p; ++p)
+    {
+        unsigned char c = static_cast<unsigned char>(*p);
+        switch (c)
+        {
+        case '"':
+            write("\\\"", 2);
+            break;
+        case '\\':
+            write("\\\\", 2);
+            break;
+        case '\n':
+            write("\\n", 2);
+            break;
+        case '\r':
+            write("\\r", 2);
+            break;
+        case '\t':
+            write("\\t", 2);
+            break;
+        default:
+            if (c < 0x20)
+            {
+                char tmp[8];
+                snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+                write(tmp, 6);
+            }
+            else
+            {
+                put(c);
+            }
+        }
+    }
+}
+
+void JsonStream::put(char c)
+{
+    if (len_ == sizeof(buf_))
+        flush();
+    buf_[len_++] = c;
+}
+
+void JsonStream::write(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        if (len_ == sizeof(buf_))
+            flush();
+        size_t n = sizeof(buf_) - len_;
+        if (n > len)
+            n = len;
+        memcpy(buf_ + len_, data, n);
+        len_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void JsonStream::flush()
+{
+    if (len_ == 0)
+        return;
+    sampleHeap();
+    if (err_ == ESP_OK)
+    {
+        err_ = httpd_resp_send_chunk(req_, buf_, len_);
+        chunks_++;
+        bytes_ += len_;
+    }
+    // en cas d'erreur on continue à vider le buffer sans rien envoyer
+    len_ = 0;
+}
+
+void JsonStream::sampleHeap()
+{
+    uint32_t heap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    if (heap < heap_min_)
+        heap_min_ = heap;
+}
+
+esp_err_t JsonStream::finish()
+{
+    if (finished_)
+        return err_;
+    finished_ = true;
+
+    if (depth_ != 0 && err_ == ESP_OK)
+        err_ = ESP_ERR_INVALID_STATE;
+    flush();
+    if (err_ == ESP_OK)
+        err_ = httpd_resp_send_chunk(req_, nullptr, 0);
+
+    uint32_t peak = heapPeak();
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stats.responses++;
+        if (err_ != ESP_OK)
+            s_stats.errors++;
+        s_stats.bytes += bytes_;
+        s_stats.chunks += chunks_;
+        if (bytes_ > s_stats.largest)
+            s_stats.largest = bytes_;
+        s_stats.heap_peak_last = peak;
+        if (peak > s_stats.heap_peak_max)
+            s_stats.heap_peak_max = peak;
+    }
+    ESP_LOGD(TAG, "%u bytes in %lu chunks, heap peak %lu", (unsigned)bytes_, (unsigned long)chunks_, (unsigned long)peak);
+    return err_;
+}
+
+void JsonStream::stats_to_json(cJSON *obj)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    cJSON_AddNumberToObject(obj, "responses", s_stats.responses);
+    cJSON_AddNumberToObject(obj, "errors", s_stats.errors);
+    cJSON_AddNumberToObject(obj, "bytes", (double)s_stats.bytes);
+    cJSON_AddNumberToObject(obj, "chunks", s_stats.chunks);
+    cJSON_AddNumberToObject(obj, "largest", s_stats.largest);
+    cJSON_AddNumberToObject(obj, "heap_peak_last", s_stats.heap_peak_last);
+    cJSON_AddNumberToObject(obj, "heap_peak_max", s_stats.heap_peak_max);
+}
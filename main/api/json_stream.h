@@ -0,0 +1,78 @@
+#pragma once
+#ifndef __API_JSON_STREAM_H__
+#define __API_JSON_STREAM_H__
+#include <cstddef>
+#include <cstdint>
+#include "cJSON.h"
+#include "esp_http_server.h"
+
+/**
+ * Writer JSON en flux : les octets partent par httpd_resp_send_chunk depuis un
+ * buffer fixe sur la pile, sans arbre cJSON ni chaîne imprimée sur le heap.
+ * La taille de la réponse n'est plus bornée par Event::data.
+ *
+ *   JsonStream w(req);
+ *   w.beginObject();
+ *   w.number("count", n);
+ *   w.beginArray("results"); ... w.endArray();
+ *   w.endObject();
+ *   return w.finish();
+ *
+ * Le pic de heap (heap libre au début - minimum observé à chaque flush) est
+ * mesuré par réponse et agrégé dans stats_to_json().
+ */
+class JsonStream final
+{
+public:
+    static constexpr const char *TAG = "[JSON_STREAM]";
+    static constexpr size_t BUFFER_SIZE = 512;
+    static constexpr size_t MAX_DEPTH = 8;
+
+    explicit JsonStream(httpd_req_t *req);
+    JsonStream(const JsonStream &) = delete;
+    JsonStream &operator=(const JsonStream &) = delete;
+
+    // key == nullptr dans un tableau ou à la racine
+    void beginObject(const char *key = nullptr);
+    void endObject();
+    void beginArray(const char *key = nullptr);
+    void endArray();
+
+    void string(const char *key, const char *value);
+    void number(const char *key, double value);
+    void boolean(const char *key, bool value);
+    void null(const char *key);
+    // Valeur JSON déjà sérialisée (ex. snapshot, payload)
+    void raw(const char *key, const char *json, size_t len);
+
+    // Vide le buffer et termine la réponse chunkée
+    esp_err_t finish();
+
+    esp_err_t error() const { return err_; }
+    size_t bytes() const { return bytes_; }
+    uint32_t heapPeak() const { return heap_start_ > heap_min_ ? heap_start_ - heap_min_ : 0; }
+
+    static void stats_to_json(cJSON *obj);
+
+private:
+    void key(const char *key);
+    void write(const char *data, size_t len);
+    void put(char c);
+    void writeEscaped(const char *str);
+    void flush();
+    void sampleHeap();
+
+    httpd_req_t *req_;
+    char buf_[BUFFER_SIZE];
+    size_t len_ = 0;
+    size_t bytes_ = 0;
+    uint32_t chunks_ = 0;
+    bool first_[MAX_DEPTH] = {};
+    uint8_t depth_ = 0;
+    bool finished_ = false;
+    esp_err_t err_ = ESP_OK;
+    uint32_t heap_start_;
+    uint32_t heap_min_;
+};
+
+#endif
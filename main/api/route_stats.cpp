@@ -0,0 +1,152 @@
+#include "route_stats.h"
+#include <mutex>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+namespace route_stats
+{
+    // bucket i : < 2^(i + BASE_SHIFT) µs ; le dernier prend tout le reste
+    static constexpr size_t BUCKETS = 14;
+    static constexpr uint32_t BASE_SHIFT = 7; // 128 µs .. ~1 s
+    static constexpr size_t METHODS = static_cast<size_t>(Method::COUNT);
+    static const char *const METHOD_NAMES[] = {"GET", "POST"};
+
+    struct Entry
+    {
+        uint32_t count;
+        uint32_t errors;
+        uint32_t max_us;
+        uint64_t sum_us;
+        uint32_t heap_free_min;
+        uint32_t heap_used_max;
+        uint16_t hist[BUCKETS]; // saturé : les centiles restent justes en proportion tant que count < 65535
+    };
+
+    static std::mutex s_mutex;
+    static const char *s_paths[MAX_ROUTES] = {};
+    static Entry s_entries[MAX_ROUTES][METHODS] = {};
+    static Sample *s_current = nullptr;
+
+    static size_t bucket_of(uint32_t us)
+    {
+        size_t b = 0;
+        us >>= BASE_SHIFT;
+        while (us && b < BUCKETS - 1)
+        {
+            us >>= 1;
+            ++b;
+        }
+        return b;
+    }
+
+    Sample begin(size_t route, const char *path, Method method)
+    {
+        Sample s;
+        s.route = route;
+        s.path = path;
+        s.method = method;
+        s.heap_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+        s.start_us = esp_timer_get_time();
+        return s;
+    }
+
+    // le minimum pendant le handler n'est pas observable : on prend le plus bas des deux points
+    void end(const Sample &s, bool error)
+    {
+        uint32_t elapsed = (uint32_t)(esp_timer_get_time() - s.start_us);
+        uint32_t heap_after = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+        record(s.route, s.path, s.method, elapsed, error,
+               heap_after < s.heap_before ? heap_after : s.heap_before,
+               heap_after < s.heap_before ? s.heap_before - heap_after : 0);
+    }
+
+    void set_current(Sample *sample)
+    {
+        s_current = sample;
+    }
+
+    Sample *current()
+    {
+        return s_current;
+    }
+
+    void record(size_t route, const char *path, Method method, uint32_t elapsed_us, bool error,
+                uint32_t heap_free_min, uint32_t heap_used)
+    {
+        if (route >= MAX_ROUTES || method >= Method::COUNT)
+            return;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_paths[route] = path;
+        Entry &e = s_entries[route][static_cast<size_t>(method)];
+        if (e.count == 0 || heap_free_min < e.heap_free_min)
+            e.heap_free_min = heap_free_min;
+        e.count++;
+        e.errors += error ? 1 : 0;
+        e.sum_us += elapsed_us;
+        if (elapsed_us > e.max_us)
+            e.max_us = elapsed_us;
+        if (heap_used > e.heap_used_max)
+            e.heap_used_max = heap_used;
+        uint16_t &h = e.hist[bucket_of(elapsed_us)];
+        if (h != UINT16_MAX)
+            h++;
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (auto &route : s_entries)
+            for (auto &e : route)
+                e = Entry{};
+    }
+
+    // Borne haute du bucket qui contient le centile q (en %), bornée par le max observé
+    static uint32_t percentile(const Entry &e, uint32_t q)
+    {
+        uint32_t total = 0;
+        for (uint16_t h : e.hist)
+            total += h;
+        if (total == 0)
+            return 0;
+        uint32_t target = (total * q + 99) / 100;
+        uint32_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            seen += e.hist[b];
+            if (seen >= target)
+            {
+                uint32_t upper = b == BUCKETS - 1 ? e.max_us : (1u << (b + BASE_SHIFT)) - 1;
+                return upper < e.max_us ? upper : e.max_us;
+            }
+        }
+        return e.max_us;
+    }
+
+    void stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (size_t r = 0; r < MAX_ROUTES; ++r)
+        {
+            if (!s_paths[r])
+                continue;
+            cJSON *route = nullptr;
+            for (size_t m = 0; m < METHODS; ++m)
+            {
+                const Entry &e = s_entries[r][m];
+                if (e.count == 0)
+                    continue;
+                if (!route)
+                    route = cJSON_AddObjectToObject(obj, s_paths[r]);
+                cJSON *item = cJSON_AddObjectToObject(route, METHOD_NAMES[m]);
+                cJSON_AddNumberToObject(item, "count", e.count);
+                cJSON_AddNumberToObject(item, "errors", e.errors);
+                cJSON_AddNumberToObject(item, "avg_us", (double)(e.sum_us / e.count));
+                cJSON_AddNumberToObject(item, "p50_us", percentile(e, 50));
+                cJSON_AddNumberToObject(item, "p99_us", percentile(e, 99));
+                cJSON_AddNumberToObject(item, "max_us", e.max_us);
+                cJSON_AddNumberToObject(item, "heap_free_min", e.heap_free_min);
+                cJSON_AddNumberToObject(item, "heap_used_max", e.heap_used_max);
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef __API_ROUTE_STATS_H__
+#define __API_ROUTE_STATS_H__
+#include <cstddef>
+#include <cstdint>
+#include "cJSON.h"
+
+/**
+ * Latence par route et par méthode, mesurée dans le dispatcher : histogramme
+ * log2 (p50 / p99 approchés par la borne haute du bucket), max, erreurs et
+ * tas libre au pire moment. Sert de référence avant / après une modification
+ * de l'API, lue via GET /iot/api_stats (?reset=1 pour repartir de zéro).
+ *
+ * Un handler confié à http_async est mesuré jusqu'à la fin de son exécution
+ * sur le worker (attente en file comprise) : l'échantillon pris au dispatch
+ * part avec le job et n'est enregistré qu'une fois, par le worker.
+ */
+namespace route_stats
+{
+    static constexpr size_t MAX_ROUTES = 24;
+
+    enum class Method : uint8_t
+    {
+        GET,
+        POST,
+        COUNT
+    };
+
+    // Mesure d'une requête, du dispatch à la fin du handler
+    struct Sample
+    {
+        size_t route = MAX_ROUTES;
+        const char *path = nullptr;
+        Method method = Method::GET;
+        int64_t start_us = 0;
+        uint32_t heap_before = 0;
+        bool deferred = false; // repris par un worker http_async
+    };
+
+    Sample begin(size_t route, const char *path, Method method);
+    void end(const Sample &sample, bool error);
+
+    // Requête en cours de dispatch (tâche httpd uniquement), nullptr hors dispatch
+    void set_current(Sample *sample);
+    Sample *current();
+
+    void record(size_t route, const char *path, Method method, uint32_t elapsed_us, bool error,
+                uint32_t heap_free_min, uint32_t heap_used);
+    void reset();
+    void stats_to_json(cJSON *obj);
+}
+
+#endif
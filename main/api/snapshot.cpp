@@ -0,0 +1,162 @@
+#include "snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "esp_log.h"
+#include "macro.h"
+#include "utils.h"
+
+namespace snapshot
+{
+    struct Entry
+    {
+        std::shared_ptr<const std::string> body;
+        uint32_t hash;
+        uint32_t version;
+        char etag[12]; // "\"xxxxxxxx\""
+    };
+
+    struct Stats
+    {
+        uint32_t hits;
+        uint32_t not_modified;
+        uint32_t misses;
+    };
+
+    static const char *const NAMES[] = {"wifi_sta", "wifi_ap", "wifi_status", "mqtt", "camera"};
+    static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == static_cast<size_t>(Key::COUNT), "snapshot names");
+
+    static std::mutex s_mutex;
+    static Entry s_entries[static_cast<size_t>(Key::COUNT)];
+    static Stats s_stats[static_cast<size_t>(Key::COUNT)];
+    static Listener s_listener = nullptr;
+
+    void publish(Key key, const char *json, size_t len)
+    {
+        if (key >= Key::COUNT || !json)
+            return;
+        uint32_t hash = utils::hash_struct(json, len);
+        // construit hors verrou : le lecteur courant garde l'ancienne version
+        auto body = std::make_shared<const std::string>(json, len);
+
+        uint32_t version;
+        Listener listener;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            Entry &e = s_entries[static_cast<size_t>(key)];
+            if (e.body && e.hash == hash && *e.body == *body)
+                return;
+            e.body = body;
+            e.hash = hash;
+            version = ++e.version;
+            snprintf(e.etag, sizeof(e.etag), "\"%08lx\"", (unsigned long)hash);
+            listener = s_listener;
+        }
+        if (listener)
+            listener(key, version, body);
+    }
+
+    void publish(Key key, const cJSON *root)
+    {
+        char *json = cJSON_PrintUnformatted(root);
+        if (!json)
+            return;
+        publish(key, json, strlen(json));
+        cJSON_free(json);
+    }
+
+    void invalidate(Key key)
+    {
+        if (key >= Key::COUNT)
+            return;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_entries[static_cast<size_t>(key)].body.reset();
+    }
+
+    uint32_t version(Key key)
+    {
+        if (key >= Key::COUNT)
+            return 0;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return s_entries[static_cast<size_t>(key)].version;
+    }
+
+    std::shared_ptr<const std::string> get(Key key, uint32_t *version)
+    {
+        if (key >= Key::COUNT)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        const Entry &e = s_entries[static_cast<size_t>(key)];
+        if (version)
+            *version = e.version;
+        return e.body;
+    }
+
+    const char *name(Key key)
+    {
+        return key < Key::COUNT ? NAMES[static_cast<size_t>(key)] : "";
+    }
+
+    void set_listener(Listener listener)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_listener = listener;
+    }
+
+    esp_err_t serve(Key key, httpd_req_t *req)
+    {
+        if (key >= Key::COUNT)
+            return ESP_ERR_NOT_FOUND;
+
+        size_t index = static_cast<size_t>(key);
+        Entry e;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            e = s_entries[index];
+            if (!e.body)
+            {
+                s_stats[index].misses++;
+                return ESP_ERR_NOT_FOUND;
+            }
+        }
+
+        SET_CORS_HEADERS(req);
+        httpd_resp_set_hdr(req, "ETag", e.etag);
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+        char if_none_match[sizeof(e.etag) + 4];
+        if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+            strcmp(if_none_match, e.etag) == 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                s_stats[index].not_modified++;
+            }
+            httpd_resp_set_status(req, "304 Not Modified");
+            return httpd_resp_send(req, nullptr, 0);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stats[index].hits++;
+        }
+        httpd_resp_set_type(req, "application/json");
+        return httpd_resp_send(req, e.body->data(), e.body->size());
+    }
+
+    void stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (size_t i = 0; i < static_cast<size_t>(Key::COUNT); ++i)
+        {
+            cJSON *item = cJSON_AddObjectToObject(obj, NAMES[i]);
+            cJSON_AddNumberToObject(item, "version", s_entries[i].version);
+            cJSON_AddNumberToObject(item, "size", s_entries[i].body ? s_entries[i].body->size() : 0);
+            cJSON_AddNumberToObject(item, "hits", s_stats[i].hits);
+            cJSON_AddNumberToObject(item, "not_modified", s_stats[i].not_modified);
+            cJSON_AddNumberToObject(item, "misses", s_stats[i].misses);
+        }
+    }
+}
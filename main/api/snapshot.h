@@ -0,0 +1,48 @@
+#pragma once
+#ifndef __API_SNAPSHOT_H__
+#define __API_SNAPSHOT_H__
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "cJSON.h"
+#include "esp_http_server.h"
+
+/**
+ * Cache de lecture des GET : chaque module publie une représentation JSON
+ * pré-sérialisée quand son état change ; les handlers la servent directement
+ * (ETag = hash du contenu, 304 si If-None-Match correspond), sans passer par le bus.
+ */
+namespace snapshot
+{
+    static constexpr const char *TAG = "[SNAPSHOT]";
+
+    enum class Key : uint8_t
+    {
+        WIFI_STA,
+        WIFI_AP,
+        WIFI_STATUS,
+        MQTT_CONFIG,
+        CAMERA, // réglages capteur, publiés après chaque SettingsTransaction::commit
+        COUNT
+    };
+
+    // Appelé hors verrou, dans la tâche qui publie, à chaque nouvelle version
+    using Listener = void (*)(Key key, uint32_t version, const std::shared_ptr<const std::string> &body);
+
+    // Remplace le contenu ; la version n'augmente que si le JSON a changé
+    void publish(Key key, const char *json, size_t len);
+    void publish(Key key, const cJSON *root);
+    void invalidate(Key key);
+    uint32_t version(Key key);
+    std::shared_ptr<const std::string> get(Key key, uint32_t *version = nullptr);
+    const char *name(Key key);
+    void set_listener(Listener listener);
+
+    // ESP_ERR_NOT_FOUND si aucun snapshot : l'appelant garde son chemin habituel
+    esp_err_t serve(Key key, httpd_req_t *req);
+
+    void stats_to_json(cJSON *obj);
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "static_ui.h"
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include "esp_log.h"
+#include "http_async.h"
+#include "utils.h"
+
+// Symboles générés par target_add_binary_data (main/CMakeLists.txt)
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+
+namespace static_ui
+{
+    // Au-delà, l'envoi passe sur un worker async pour ne pas bloquer l'API
+    static constexpr size_t ASYNC_THRESHOLD = 8 * 1024;
+
+    struct Asset
+    {
+        const char *path;
+        const char *mime;
+        const uint8_t *start;
+        const uint8_t *end;
+        bool immutable; // nom versionné : cache navigateur d'un an
+    };
+
+    static const Asset ASSETS[] = {
+        {"/", "text/html", index_html_gz_start, index_html_gz_end, false},
+        {"/index.html", "text/html", index_html_gz_start, index_html_gz_end, false},
+    };
+    static constexpr size_t ASSET_COUNT = sizeof(ASSETS) / sizeof(ASSETS[0]);
+
+    struct Stats
+    {
+        uint32_t served;
+        uint32_t not_modified;
+        uint32_t not_found;
+        uint64_t bytes;
+    };
+
+    static std::mutex s_mutex;
+    static Stats s_stats = {};
+    // calculés au premier accès (le contenu ne change qu'avec le firmware)
+    static char s_etags[ASSET_COUNT][12] = {};
+
+    static const Asset *find(const char *uri, size_t *index)
+    {
+        size_t len = strcspn(uri, "?#");
+        for (size_t i = 0; i < ASSET_COUNT; ++i)
+        {
+            if (strlen(ASSETS[i].path) == len && strncmp(ASSETS[i].path, uri, len) == 0)
+            {
+                *index = i;
+                return &ASSETS[i];
+            }
+        }
+        return nullptr;
+    }
+
+    static const char *etag(size_t index)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!s_etags[index][0])
+        {
+            const Asset &a = ASSETS[index];
+            uint32_t hash = utils::hash_struct(a.start, a.end - a.start);
+            snprintf(s_etags[index], sizeof(s_etags[index]), "\"%08lx\"", (unsigned long)hash);
+        }
+        return s_etags[index];
+    }
+
+    esp_err_t handler(httpd_req_t *req)
+    {
+        size_t index = 0;
+        const Asset *asset = find(req->uri, &index);
+        if (!asset)
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stats.not_found++;
+            return httpd_resp_send_404(req);
+        }
+        size_t size = asset->end - asset->start;
+        if (size > ASYNC_THRESHOLD)
+        {
+            HTTP_RUN_ASYNC(req, handler);
+        }
+
+        const char *tag = etag(index);
+        httpd_resp_set_hdr(req, "ETag", tag);
+        httpd_resp_set_hdr(req, "Cache-Control", asset->immutable ? "public, max-age=31536000, immutable" : "no-cache");
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+        char if_none_match[16];
+        if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+            strcmp(if_none_match, tag) == 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                s_stats.not_modified++;
+            }
+            httpd_resp_set_status(req, "304 Not Modified");
+            return httpd_resp_send(req, nullptr, 0);
+        }
+
+        // Seule la version gzip est embarquée : tous les navigateurs la décodent
+        httpd_resp_set_type(req, asset->mime);
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        esp_err_t err = httpd_resp_send(req, reinterpret_cast<const char *>(asset->start), size);
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stats.served++;
+        s_stats.bytes += size;
+        return err;
+    }
+
+    void stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        cJSON_AddNumberToObject(obj, "assets", ASSET_COUNT);
+        cJSON_AddNumberToObject(obj, "index_size", index_html_gz_end - index_html_gz_start);
+        cJSON_AddNumberToObject(obj, "served", s_stats.served);
+        cJSON_AddNumberToObject(obj, "not_modified", s_stats.not_modified);
+        cJSON_AddNumberToObject(obj, "not_found", s_stats.not_found);
+        cJSON_AddNumberToObject(obj, "bytes", (double)s_stats.bytes);
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#ifndef __API_STATIC_UI_H__
+#define __API_STATIC_UI_H__
+#include "cJSON.h"
+#include "esp_http_server.h"
+
+/**
+ * Interface web embarquée : les fichiers de main/www sont compressés en gzip
+ * au build (CMakeLists) et liés dans le firmware. Servis tels quels depuis la
+ * flash mappée (rodata), sans copie ni allocation, avec Content-Encoding: gzip.
+ *
+ * index.html : ETag + no-cache (revalidation -> 304) ; les assets versionnés
+ * peuvent être marqués immutable (max-age d'un an).
+ */
+namespace static_ui
+{
+    static constexpr const char *TAG = "[STATIC_UI]";
+
+    esp_err_t handler(httpd_req_t *req);
+    void stats_to_json(cJSON *obj);
+}
+
+#endif
@@ -0,0 +1,460 @@
+#include "ws_push.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "conn_budget.h"
+#include "snapshot.h"
+
+namespace ws_push
+{
+    static constexpr size_t MAX_CLIENTS = CONFIG_IOT_HTTP_WS_MAX_CLIENTS;
+    static constexpr size_t QUEUE_LEN = CONFIG_IOT_HTTP_WS_QUEUE_LEN;
+    static constexpr size_t KEY_COUNT = static_cast<size_t>(snapshot::Key::COUNT);
+    static constexpr size_t RX_MAX = 32;
+
+    using Message = std::shared_ptr<const std::string>;
+
+    struct Pending
+    {
+        Message msg;
+        int64_t queued_us;
+    };
+
+    struct Client
+    {
+        int fd = -1;
+        Pending queue[QUEUE_LEN];
+        uint8_t head = 0;
+        uint8_t count = 0;
+        bool slow = false;
+    };
+
+    struct Stats
+    {
+        uint32_t connects;
+        uint32_t rejected;
+        uint32_t slow_drops;
+        uint32_t send_errors;
+        uint32_t messages;
+        uint32_t frames;
+        uint64_t bytes;
+        uint32_t latency_max_us;
+        uint64_t latency_sum_us;
+    };
+
+    static httpd_handle_t s_server = nullptr;
+    static TaskHandle_t s_task = nullptr;
+    static std::mutex s_mutex;
+    static Client s_clients[MAX_CLIENTS];
+    // Dernier état diffusé par clé : base des deltas (partagé avec snapshot, pas de copie)
+    static Message s_last[KEY_COUNT];
+    static uint32_t s_last_version[KEY_COUNT] = {};
+    static bool s_mqtt_connected = false;
+    static Stats s_stats = {};
+
+    static Message make_message(const char *type, uint32_t version, const char *field, const char *json, size_t len)
+    {
+        char head[64];
+        int n = snprintf(head, sizeof(head), "{\"t\":\"%s\",\"v\":%lu,\"%s\":", type, (unsigned long)version, field);
+        auto msg = std::make_shared<std::string>();
+        msg->reserve(n + len + 1);
+        msg->append(head, n);
+        msg->append(json, len);
+        msg->push_back('}');
+        return msg;
+    }
+
+    // Clés de premier niveau modifiées entre prev et cur ; nullptr si rien n'a changé
+    static Message make_delta(const char *type, uint32_t version, const std::string &prev_json, const std::string &cur_json)
+    {
+        cJSON *prev = cJSON_ParseWithLength(prev_json.data(), prev_json.size());
+        cJSON *cur = cJSON_ParseWithLength(cur_json.data(), cur_json.size());
+        if (!cJSON_IsObject(prev) || !cJSON_IsObject(cur))
+        {
+            cJSON_Delete(prev);
+            cJSON_Delete(cur);
+            return make_message(type, version, "s", cur_json.data(), cur_json.size());
+        }
+
+        cJSON *delta = cJSON_CreateObject();
+        bool changed = false;
+        const cJSON *item = nullptr;
+        cJSON_ArrayForEach(item, cur)
+        {
+            const cJSON *old = cJSON_GetObjectItemCaseSensitive(prev, item->string);
+            if (!old || !cJSON_Compare(old, item, true))
+            {
+                cJSON_AddItemToObject(delta, item->string, cJSON_Duplicate(item, true));
+                changed = true;
+            }
+        }
+        cJSON_ArrayForEach(item, prev)
+        {
+            if (!cJSON_GetObjectItemCaseSensitive(cur, item->string))
+            {
+                cJSON_AddNullToObject(delta, item->string);
+                changed = true;
+            }
+        }
+
+        Message msg;
+        char *json = changed ? cJSON_PrintUnformatted(delta) : nullptr;
+        if (json)
+        {
+            msg = make_message(type, version, "d", json, strlen(json));
+            cJSON_free(json);
+        }
+        cJSON_Delete(delta);
+        cJSON_Delete(prev);
+        cJSON_Delete(cur);
+        return msg;
+    }
+
+    static Message mqtt_link_message()
+    {
+        const char *json = s_mqtt_connected ? "{\"connected\":true}" : "{\"connected\":false}";
+        return make_message("mqtt_link", 0, "s", json, strlen(json));
+    }
+
+    // s_mutex tenu
+    static void enqueue_locked(Client &c, const Message &msg, int64_t now)
+    {
+        if (c.slow)
+            return;
+        if (c.count == QUEUE_LEN)
+        {
+            // client lent : on le coupe plutôt que de perdre des deltas en silence
+            c.slow = true;
+            s_stats.slow_drops++;
+            return;
+        }
+        c.queue[(c.head + c.count) % QUEUE_LEN] = {msg, now};
+        c.count++;
+    }
+
+    static void broadcast(const Message &msg)
+    {
+        if (!msg)
+            return;
+        bool any = false;
+        {
+            int64_t now = esp_timer_get_time();
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stats.messages++;
+            for (auto &c : s_clients)
+            {
+                if (c.fd < 0)
+                    continue;
+                enqueue_locked(c, msg, now);
+                any = true;
+            }
+        }
+        if (any && s_task)
+            xTaskNotifyGive(s_task);
+    }
+
+    // s_mutex tenu
+    static void send_full_state_locked(Client &c)
+    {
+        int64_t now = esp_timer_get_time();
+        for (size_t i = 0; i < KEY_COUNT; ++i)
+        {
+            if (!s_last[i])
+                continue;
+            const char *type = snapshot::name(static_cast<snapshot::Key>(i));
+            enqueue_locked(c, make_message(type, s_last_version[i], "s", s_last[i]->data(), s_last[i]->size()), now);
+        }
+        enqueue_locked(c, mqtt_link_message(), now);
+    }
+
+    static void on_snapshot(snapshot::Key key, uint32_t version, const Message &body)
+    {
+        size_t index = static_cast<size_t>(key);
+        Message prev;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            // deux publications concurrentes : garder la plus récente
+            if (version <= s_last_version[index])
+                return;
+            prev = s_last[index];
+            s_last[index] = body;
+            s_last_version[index] = version;
+        }
+
+        const char *type = snapshot::name(key);
+        if (prev)
+            broadcast(make_delta(type, version, *prev, *body));
+        else
+            broadcast(make_message(type, version, "s", body->data(), body->size()));
+    }
+
+    static void remove_client(int fd)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (auto &c : s_clients)
+        {
+            if (c.fd == fd)
+                c = Client{};
+        }
+    }
+
+    static bool add_client(int fd)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            Client *slot = nullptr;
+            for (auto &c : s_clients)
+            {
+                // socket fermé sans trame CLOSE : la place est libre
+                if (c.fd >= 0 && httpd_ws_get_fd_info(s_server, c.fd) != HTTPD_WS_CLIENT_WEBSOCKET)
+                    c = Client{};
+                if (c.fd == fd)
+                    c = Client{};
+                if (c.fd < 0 && !slot)
+                    slot = &c;
+            }
+            if (!slot)
+            {
+                s_stats.rejected++;
+                return false;
+            }
+            slot->fd = fd;
+            s_stats.connects++;
+            send_full_state_locked(*slot);
+        }
+        xTaskNotifyGive(s_task);
+        return true;
+    }
+
+    static void resync_client(int fd)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            for (auto &c : s_clients)
+            {
+                if (c.fd == fd)
+                    send_full_state_locked(c);
+            }
+        }
+        xTaskNotifyGive(s_task);
+    }
+
+    // Un message par client et par tour : un client lent ne monopolise pas la tâche
+    static bool send_one(Client &c)
+    {
+        int fd;
+        Pending item;
+        bool slow;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (c.fd < 0 || (!c.count && !c.slow))
+                return false;
+            fd = c.fd;
+            slow = c.slow;
+            if (slow)
+            {
+                c = Client{};
+            }
+            else
+            {
+                item = std::move(c.queue[c.head]);
+                c.head = (c.head + 1) % QUEUE_LEN;
+                c.count--;
+            }
+        }
+
+        if (slow)
+        {
+            ESP_LOGW(TAG, "Client %d too slow, closing", fd);
+            httpd_sess_trigger_close(s_server, fd);
+            return false;
+        }
+        if (httpd_ws_get_fd_info(s_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET)
+        {
+            remove_client(fd);
+            return false;
+        }
+
+        httpd_ws_frame_t frame = {};
+        frame.final = true;
+        frame.type = HTTPD_WS_TYPE_TEXT;
+        frame.payload = (uint8_t *)item.msg->data();
+        frame.len = item.msg->size();
+        esp_err_t err = httpd_ws_send_frame_async(s_server, fd, &frame);
+
+        uint32_t latency = (uint32_t)(esp_timer_get_time() - item.queued_us);
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (err != ESP_OK)
+            {
+                s_stats.send_errors++;
+            }
+            else
+            {
+                s_stats.frames++;
+                s_stats.bytes += frame.len;
+                s_stats.latency_sum_us += latency;
+                if (latency > s_stats.latency_max_us)
+                    s_stats.latency_max_us = latency;
+            }
+        }
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Send to %d failed: %s", fd, esp_err_to_name(err));
+            remove_client(fd);
+            httpd_sess_trigger_close(s_server, fd);
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return c.fd == fd && c.count > 0;
+    }
+
+    static void sender_task(void *)
+    {
+        while (true)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            bool more = true;
+            while (more)
+            {
+                more = false;
+                for (auto &c : s_clients)
+                    more = send_one(c) || more;
+            }
+        }
+    }
+
+    esp_err_t ws_handler(httpd_req_t *req)
+    {
+        int fd = httpd_req_to_sockfd(req);
+        if (req->method == HTTP_GET)
+        {
+            // handshake terminé : ESP_FAIL ferme la connexion
+            // le socket quitte le pool API (et son balayage d'inactivité)
+            if (!conn_budget::move(fd, conn_budget::Pool::WS) || !add_client(fd))
+            {
+                ESP_LOGW(TAG, "No free slot for client %d", fd);
+                return ESP_FAIL;
+            }
+            ESP_LOGI(TAG, "Client %d connected", fd);
+            return ESP_OK;
+        }
+
+        uint8_t buf[RX_MAX + 1];
+        httpd_ws_frame_t frame = {};
+        frame.type = HTTPD_WS_TYPE_TEXT;
+        esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+        if (err != ESP_OK)
+            return err;
+        // le canal est descendant : les trames longues ne sont pas attendues
+        if (frame.len > RX_MAX)
+            return ESP_FAIL;
+        if (frame.len > 0)
+        {
+            frame.payload = buf;
+            err = httpd_ws_recv_frame(req, &frame, frame.len);
+            if (err != ESP_OK)
+                return err;
+            buf[frame.len] = '\0';
+        }
+
+        if (frame.type == HTTPD_WS_TYPE_TEXT && frame.len == 4 && memcmp(buf, "sync", 4) == 0)
+            resync_client(fd);
+        return ESP_OK;
+    }
+
+    void on_close(int fd)
+    {
+        remove_client(fd);
+    }
+
+    void init(httpd_handle_t server)
+    {
+        if (s_task)
+            return;
+        s_server = server;
+        if (xTaskCreate(sender_task, "ws_push", 4096, nullptr, tskIDLE_PRIORITY + 4, &s_task) != pdPASS)
+        {
+            ESP_LOGE(TAG, "Task creation failed");
+            s_task = nullptr;
+            return;
+        }
+
+        snapshot::set_listener(on_snapshot);
+        // snapshots publiés avant le démarrage du serveur
+        for (size_t i = 0; i < KEY_COUNT; ++i)
+        {
+            uint32_t version = 0;
+            Message body = snapshot::get(static_cast<snapshot::Key>(i), &version);
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (body && version > s_last_version[i])
+            {
+                s_last[i] = body;
+                s_last_version[i] = version;
+            }
+        }
+
+        httpd_uri_t ws_uri = {};
+        ws_uri.uri = "/iot/ws";
+        ws_uri.method = HTTP_GET;
+        ws_uri.handler = ws_handler;
+        ws_uri.is_websocket = true;
+        ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server, &ws_uri));
+    }
+
+    void on_event(const Event *evt)
+    {
+        if (evt->type != EventType::MQTT_CONNECTED && evt->type != EventType::MQTT_DISCONNECTED)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            bool connected = evt->type == EventType::MQTT_CONNECTED;
+            if (connected == s_mqtt_connected)
+                return;
+            s_mqtt_connected = connected;
+        }
+        broadcast(mqtt_link_message());
+    }
+
+    void stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        uint32_t clients = 0, queued = 0;
+        for (auto &c : s_clients)
+        {
+            if (c.fd < 0)
+                continue;
+            clients++;
+            queued += c.count;
+        }
+        cJSON_AddNumberToObject(obj, "clients", clients);
+        cJSON_AddNumberToObject(obj, "max_clients", MAX_CLIENTS);
+        cJSON_AddNumberToObject(obj, "queued", queued);
+        cJSON_AddNumberToObject(obj, "connects", s_stats.connects);
+        cJSON_AddNumberToObject(obj, "rejected", s_stats.rejected);
+        cJSON_AddNumberToObject(obj, "slow_drops", s_stats.slow_drops);
+        cJSON_AddNumberToObject(obj, "send_errors", s_stats.send_errors);
+        cJSON_AddNumberToObject(obj, "messages", s_stats.messages);
+        cJSON_AddNumberToObject(obj, "frames", s_stats.frames);
+        cJSON_AddNumberToObject(obj, "bytes", (double)s_stats.bytes);
+        cJSON_AddNumberToObject(obj, "latency_avg_us", s_stats.frames ? (double)(s_stats.latency_sum_us / s_stats.frames) : 0);
+        cJSON_AddNumberToObject(obj, "latency_max_us", s_stats.latency_max_us);
+    }
+
+    // Abonnement ici et non dans ws_push.h : inclus par api.cpp et conn_budget.cpp,
+    // le registrar du header s'exécutait une fois par TU
+    struct register_event_bus
+    {
+        register_event_bus()
+        {
+            EventBus::getInstance().subscribe(on_event, TAG);
+        }
+    };
+    static register_event_bus reg;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef __API_WS_PUSH_H__
+#define __API_WS_PUSH_H__
+#include "cJSON.h"
+#include "esp_http_server.h"
+#include "event_bus.h"
+#include "sdkconfig.h"
+
+/**
+ * Canal WebSocket /iot/ws : remplace le polling du dashboard.
+ *
+ * A la connexion le client reçoit l'état complet de chaque snapshot
+ *   {"t":"wifi_status","v":3,"s":{...}}
+ * puis seulement les clés modifiées
+ *   {"t":"wifi_status","v":4,"d":{"status":"STA_CONNECTED","ip":"..."}}
+ * (clé supprimée -> null). Le client envoie "sync" pour redemander l'état complet.
+ *
+ * Chaque client a une file bornée ; un client qui la remplit est déconnecté
+ * (il se reconnecte et repart d'un état complet) au lieu de ralentir les autres.
+ */
+namespace ws_push
+{
+    static constexpr const char *TAG = "[WS]";
+
+    // Enregistre /iot/ws sur le serveur et démarre la tâche d'envoi
+    void init(httpd_handle_t server);
+    esp_err_t ws_handler(httpd_req_t *req);
+    // Appelé par le close_fn de httpd
+    void on_close(int fd);
+    void stats_to_json(cJSON *obj);
+
+    void on_event(const Event *evt);
+}
+
+#endif
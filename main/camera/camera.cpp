@@ -1,45 +1,104 @@
 #include "camera.h"
 #include "../macro.h"
 #include "camera_controller.h"
+#include "camera_stats.h"
+#include "conn_budget.h"
+#include "frame_broadcaster.h"
+#include "send_iov.h"
+#include "stream_pacing.h"
+#include "esp_timer.h"
+#include <fcntl.h>
 
 using namespace camera_controller;
 namespace camera
 {
+    static constexpr int64_t SEND_DEADLINE_US = (int64_t)CONFIG_IOT_STREAM_SEND_DEADLINE_MS * 1000;
+
+    static bool send_all(int fd, const void *data, size_t len, int64_t deadline_us)
+    {
+        struct iovec iov = {.iov_base = const_cast<void *>(data), .iov_len = len};
+        WriteCounters counters;
+        return send_all_iov(fd, &iov, 1, deadline_us, counters);
+    }
+
     void stream_socket_task(void *arg)
     {
         int sockfd = (int)(intptr_t)arg;
         char headers[256];
+        auto &broadcaster = FrameBroadcaster::getInstance();
+        auto &quality = StreamQuality::getInstance();
+        auto &stats = CameraStats::getInstance();
+        LinkEstimator link;
+        uint32_t last_seq = 0;
 
         ESP_LOGI(TAG, "stream task started");
+        int stats_slot = stats.openStream(sockfd);
+        broadcaster.subscribe();
+        quality.clientStarted();
 
         while (true)
         {
-            camera_fb_t *fb = CameraController::getInstance().tryCapture();
-            if (!fb)
+            // toujours l'image la plus récente : un client lent saute des images
+            FramePtr frame = broadcaster.waitNext(last_seq, pdMS_TO_TICKS(2000));
+            if (!frame)
             {
-                ESP_LOGE(TAG, "capture failed");
+                ESP_LOGE(TAG, "no frame from broadcaster");
                 break;
             }
+            // images produites que ce client n'a pas reçues
+            uint32_t skipped = last_seq && frame->seq - last_seq > 1 ? frame->seq - last_seq - 1 : 0;
+            last_seq = frame->seq;
 
             int hdr_len = snprintf(headers, sizeof(headers),
                                    "--%s\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
-                                   "frame", fb->len);
-
-            if (send(sockfd, headers, hdr_len, 0) < 0 ||
-                send(sockfd, fb->buf, fb->len, 0) < 0 ||
-                send(sockfd, "\r\n", 2, 0) < 0)
+                                   "frame", frame->len);
+
+            // en-tête multipart + JPEG + fin de partie en un seul sendmsg ;
+            // une image partiellement envoyée casse le flux : on ferme
+            static const char TRAILER[] = "\r\n";
+            struct iovec iov[3] = {
+                {.iov_base = headers, .iov_len = (size_t)hdr_len},
+                {.iov_base = const_cast<uint8_t *>(frame->data), .iov_len = frame->len},
+                {.iov_base = const_cast<char *>(TRAILER), .iov_len = sizeof(TRAILER) - 1},
+            };
+            WriteCounters counters;
+            int64_t start = esp_timer_get_time();
+            int64_t deadline = start + SEND_DEADLINE_US;
+            if (!send_all_iov(sockfd, iov, 3, deadline, counters))
             {
-                ESP_LOGW(TAG, "send error, client likely disconnected");
-                CameraController::getInstance().releaseCapture(fb);
+                if (esp_timer_get_time() >= deadline)
+                {
+                    ESP_LOGW(TAG, "send deadline missed, dropping client");
+                    quality.countDeadlineMiss();
+                }
+                else
+                {
+                    ESP_LOGW(TAG, "send error, client likely disconnected");
+                }
                 break;
             }
 
-            CameraController::getInstance().releaseCapture(fb);
-            vTaskDelay(pdMS_TO_TICKS(50));
+            size_t sent = hdr_len + frame->len + sizeof(TRAILER) - 1;
+            int64_t done = esp_timer_get_time();
+            int64_t elapsed = done - start;
+            broadcaster.recordSendLatency(done - frame->captured_us);
+            frame.reset();
+            quality.countWrite(counters);
+            stats.recordStreamFrame(stats_slot, sent, skipped, elapsed);
+
+            link.onSent(sent, elapsed);
+            quality.report(link.sustainableFps(sent));
+            int64_t wait = link.intervalUs(sent) - elapsed;
+            TickType_t ticks = wait > 0 ? pdMS_TO_TICKS(wait / 1000) : 0;
+            vTaskDelay(ticks > 0 ? ticks : 1); // cède toujours le CPU
         }
 
+        quality.clientStopped();
+        broadcaster.unsubscribe();
+        stats.closeStream(stats_slot);
         ESP_LOGI(TAG, "closing stream socket");
         shutdown(sockfd, SHUT_RDWR);
+        conn_budget::release(sockfd);
         close(sockfd);
         vTaskDelete(nullptr);
     }
@@ -68,7 +127,7 @@ namespace camera
         server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
         if (bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 ||
-            listen(listen_fd, 1) < 0)
+            listen(listen_fd, CONFIG_IOT_CONN_STREAM_MAX) < 0)
         {
             ESP_LOGE(TAG, "bind/listen failed");
             close(listen_fd);
@@ -87,15 +146,34 @@ namespace camera
                 continue;
             }
 
+            // rejet immédiat : ni tâche ni buffer pour un client hors budget
+            if (!conn_budget::acquire(conn_budget::Pool::STREAM, client_fd))
+            {
+                ESP_LOGW(TAG, "stream budget full, rejecting client");
+                conn_budget::reject_raw(client_fd);
+                close(client_fd);
+                continue;
+            }
+
+            // non bloquant : chaque image a une échéance (send_all), un client
+            // qui ne lit plus libère sa place au lieu de bloquer la tâche
+            int flags = fcntl(client_fd, F_GETFL, 0);
+            fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+
             ESP_LOGI(TAG, "MJPEG client connected");
             const char *resp =
                 "HTTP/1.1 200 OK\r\n"
                 "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
                 "Access-Control-Allow-Origin: *\r\n"
                 "Connection: close\r\n\r\n";
-            send(client_fd, resp, strlen(resp), 0);
+            send_all(client_fd, resp, strlen(resp), esp_timer_get_time() + SEND_DEADLINE_US);
 
-            xTaskCreatePinnedToCore(stream_socket_task, "cam_stream", 8192, (void *)(intptr_t)client_fd, 5, nullptr, tskNO_AFFINITY);
+            if (xTaskCreatePinnedToCore(stream_socket_task, "cam_stream", 8192, (void *)(intptr_t)client_fd, 5, nullptr, tskNO_AFFINITY) != pdPASS)
+            {
+                ESP_LOGE(TAG, "stream task creation failed");
+                conn_budget::release(client_fd);
+                close(client_fd);
+            }
         }
 
         // never reached
@@ -1,12 +1,20 @@
 #include "camera_api.h"
 #include "../macro.h"
+#include "http_async.h"
+#include "frame_broadcaster.h"
+#include "snapshot.h"
+#include <cstring>
 #include <string>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 namespace camera_api
 {
     __attribute__((noinline)) esp_err_t camera_get(httpd_req_t *req)
     {
+        esp_err_t err = snapshot::serve(snapshot::Key::CAMERA, req);
+        if (err != ESP_ERR_NOT_FOUND)
+            return err;
         std::string json = camera_controller::CameraController::getInstance().to_json();
         SET_RESP_HEADERS(req);
         return httpd_resp_send(req, json.c_str(), json.size());
@@ -39,15 +47,19 @@ namespace camera_api
         return ESP_OK;
     }
 
+    // Ecriture SD/flash synchrone sur un worker async : la réponse reflète le résultat réel
     __attribute__((noinline)) esp_err_t camera_save(httpd_req_t *req)
     {
+        HTTP_RUN_ASYNC(req, camera_save);
+
         auto &cam = camera_controller::CameraController::getInstance();
         if (!cam.isInitialized())
             return httpd_resp_send_500(req);
 
         HTTP_RECV_BODY_OR_FAIL(req, body, TAG, "body failed");
 
-        camera_controller::CameraController::getInstance().request_save();
+        if (!cam.save())
+            return httpd_resp_send_500(req);
         SET_RESP_HEADERS(req);
 
         httpd_resp_send(req, body.c_str(), body.size());
@@ -55,4 +67,56 @@ namespace camera_api
         return ESP_OK;
     }
 
+
+    // Une période d'image : au-delà, le snapshot attend la capture suivante
+    static constexpr int64_t CAPTURE_MAX_AGE_US = (int64_t)CONFIG_IOT_CAPTURE_MAX_AGE_MS * 1000;
+
+    // Envoi du JPEG (plusieurs dizaines de Ko) et attente éventuelle de la
+    // capture sur un worker async : la tâche httpd reste disponible
+    __attribute__((noinline)) esp_err_t capture_get(httpd_req_t *req)
+    {
+        HTTP_RUN_ASYNC(req, capture_get);
+
+        if (!camera_controller::CameraController::getInstance().isInitialized())
+            return httpd_resp_send_500(req);
+
+        camera::FramePtr frame = camera::FrameBroadcaster::getInstance().snapshot(CAPTURE_MAX_AGE_US, pdMS_TO_TICKS(2000));
+        if (!frame)
+        {
+            ESP_LOGW(TAG, "capture: no frame");
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            httpd_resp_set_hdr(req, "Retry-After", "1");
+            return httpd_resp_send(req, nullptr, 0);
+        }
+
+        // seq seul repart de 1 au reboot : l'horodatage le rend unique
+        char etag[32];
+        snprintf(etag, sizeof(etag), "\"%lx-%llx\"", (unsigned long)frame->seq, (unsigned long long)frame->captured_us);
+
+        int64_t age_us = esp_timer_get_time() - frame->captured_us;
+        int64_t wall_us = frame->wall_us();
+        char timestamp[24];
+        snprintf(timestamp, sizeof(timestamp), "%lld.%06lld", (long long)(wall_us / 1000000), (long long)(wall_us % 1000000));
+        char age_ms[12];
+        snprintf(age_ms, sizeof(age_ms), "%lld", (long long)(age_us / 1000));
+
+        SET_CORS_HEADERS(req);
+        httpd_resp_set_hdr(req, "ETag", etag);
+        httpd_resp_set_hdr(req, "X-Timestamp", timestamp);
+        httpd_resp_set_hdr(req, "X-Frame-Age-Ms", age_ms);
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+        char if_none_match[32];
+        if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+            strcmp(if_none_match, etag) == 0)
+        {
+            httpd_resp_set_status(req, "304 Not Modified");
+            return httpd_resp_send(req, nullptr, 0);
+        }
+
+        httpd_resp_set_type(req, "image/jpeg");
+        httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
+        // frame garde le buffer jusqu'à la fin de l'envoi
+        return httpd_resp_send(req, reinterpret_cast<const char *>(frame->data), frame->len);
+    }
 }
@@ -12,6 +12,8 @@ namespace camera_api
     __attribute__((noinline)) esp_err_t camera_get(httpd_req_t *req);
     __attribute__((noinline)) esp_err_t camera_post(httpd_req_t *req);
     __attribute__((noinline)) esp_err_t camera_save(httpd_req_t *req);
+    // JPEG depuis le cache d'image du FrameBroadcaster (ETag / X-Timestamp)
+    __attribute__((noinline)) esp_err_t capture_get(httpd_req_t *req);
 }
 
 #endif
\ No newline at end of file
@@ -1,6 +1,12 @@
 #include "camera_controller.h"
+#include <cstring>
+#include <mutex>
 #include "cJSON.h"
+#include "esp_timer.h"
+#include "frame_broadcaster.h"
 #include "persistence.h"
+#include "snapshot.h"
+#include "stream_pacing.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -69,6 +75,8 @@ namespace camera_controller
         }
 
         load();
+        // load() ne commit rien si la config sauvée correspond déjà au capteur
+        publish_snapshot();
         Event e{};
         e.type = EventType::CAMERA_INIT_DONE;
         EventBus::getInstance().emit(e);
@@ -93,33 +101,10 @@ namespace camera_controller
     }
     void CameraController::apply_config(const camera_config_persist &cfg)
     {
-        setFrameSize(static_cast<framesize_t>(cfg.framesize));
-        setQuality(cfg.quality);
-        setContrast(cfg.contrast);
-        setBrightness(cfg.brightness);
-        setSaturation(cfg.saturation);
-        setSharpness(cfg.sharpness);
-        setDenoise(cfg.denoise);
-        setSpecialEffect(cfg.special_effect);
-        setWbMode(cfg.wb_mode);
-        setAeLevel(cfg.ae_level);
-        setAecValue(cfg.aec_value);
-        setAgcGain(cfg.agc_gain);
-        setGainCeiling(cfg.gainceiling);
-
-        setAwb(cfg.awb);
-        setAwbGain(cfg.awb_gain);
-        setAgc(cfg.agc);
-        setBpc(cfg.bpc);
-        setWpc(cfg.wpc);
-        setRawGma(cfg.raw_gma);
-        setLensCorrection(cfg.lenc);
-        setHorizontalMirror(cfg.hmirror);
-        setVerticalFlip(cfg.vflip);
-        setDownsizeEnable(cfg.downsize);
-        setColorBar(cfg.colorbar);
-        setAec(cfg.aec);
-        setAec2(cfg.aec2);
+        SettingsTransaction tx;
+        tx.setConfig(cfg);
+        if (!tx.commit())
+            ESP_LOGW(TAG, "some camera settings were rejected");
     }
     void CameraController::extract_config(camera_config_persist &cfg) const
     {
@@ -150,6 +135,15 @@ namespace camera_controller
         cfg.colorbar = sensor->status.colorbar;
         cfg.aec = sensor->status.aec;
         cfg.aec2 = sensor->status.aec2;
+
+        // pendant un flux, le capteur porte la qualité dégradée par StreamQuality
+        int quality;
+        framesize_t framesize;
+        if (camera::StreamQuality::getInstance().baseSettings(quality, framesize))
+        {
+            cfg.quality = quality;
+            cfg.framesize = framesize;
+        }
     }
 
 #pragma region SETTER
@@ -323,171 +317,308 @@ namespace camera_controller
         if (!root)
             return false;
 
-        cJSON *js = cJSON_GetObjectItemCaseSensitive(root, KEY_FRAME_SIZE);
-        cJSON *jp = cJSON_GetObjectItemCaseSensitive(root, KEY_JPEG_QUALITY);
-        cJSON *jc = cJSON_GetObjectItemCaseSensitive(root, KEY_CONTRAST);
-        cJSON *jb = cJSON_GetObjectItemCaseSensitive(root, KEY_BRIGHTNESS);
-        cJSON *ja = cJSON_GetObjectItemCaseSensitive(root, KEY_SATURATION);
-        cJSON *je = cJSON_GetObjectItemCaseSensitive(root, KEY_AEC_VALUE);
-        cJSON *jf = cJSON_GetObjectItemCaseSensitive(root, KEY_AE_LEVEL);
-        cJSON *jg = cJSON_GetObjectItemCaseSensitive(root, KEY_AWB);
-        cJSON *jh = cJSON_GetObjectItemCaseSensitive(root, KEY_AWB_GAIN);
-        cJSON *ji = cJSON_GetObjectItemCaseSensitive(root, KEY_AGC);
-        cJSON *jj = cJSON_GetObjectItemCaseSensitive(root, KEY_AGC_GAIN);
-        cJSON *jk = cJSON_GetObjectItemCaseSensitive(root, KEY_BPC);
-        cJSON *jl = cJSON_GetObjectItemCaseSensitive(root, KEY_WPC);
-        cJSON *jm = cJSON_GetObjectItemCaseSensitive(root, KEY_RAW_GMA);
-        cJSON *jn = cJSON_GetObjectItemCaseSensitive(root, KEY_LENC);
-        cJSON *jo = cJSON_GetObjectItemCaseSensitive(root, KEY_HMIRROR);
-        cJSON *jp2 = cJSON_GetObjectItemCaseSensitive(root, KEY_VFLIP);
-        cJSON *jq = cJSON_GetObjectItemCaseSensitive(root, KEY_DOWNSIZE);
-        cJSON *jr = cJSON_GetObjectItemCaseSensitive(root, KEY_COLORBAR);
-        cJSON *jsharpness = cJSON_GetObjectItemCaseSensitive(root, KEY_SHARPNESS);
-        cJSON *jdenoise = cJSON_GetObjectItemCaseSensitive(root, KEY_DENOISE);
-        cJSON *jeffect = cJSON_GetObjectItemCaseSensitive(root, KEY_SPECIAL_EFFECT);
-        cJSON *jwb = cJSON_GetObjectItemCaseSensitive(root, KEY_WB_MODE);
-        cJSON *jaec = cJSON_GetObjectItemCaseSensitive(root, KEY_AEC);
-        cJSON *jaec2 = cJSON_GetObjectItemCaseSensitive(root, KEY_AEC2);
-        cJSON *jgainceil = cJSON_GetObjectItemCaseSensitive(root, KEY_GAINCEILING);
-
-        if (cJSON_IsNumber(js) || cJSON_IsNumber(jp) || cJSON_IsNumber(jc) || cJSON_IsNumber(jb) || cJSON_IsNumber(ja) ||
-            cJSON_IsNumber(je) || cJSON_IsNumber(jf) || cJSON_IsBool(jg) || cJSON_IsBool(jh) || cJSON_IsBool(ji) ||
-            cJSON_IsNumber(jj) || cJSON_IsBool(jk) || cJSON_IsBool(jl) || cJSON_IsBool(jm) || cJSON_IsBool(jn) ||
-            cJSON_IsBool(jo) || cJSON_IsBool(jp2) || cJSON_IsBool(jq) || cJSON_IsBool(jr) ||
-            cJSON_IsNumber(jsharpness) || cJSON_IsNumber(jdenoise) ||
-            cJSON_IsNumber(jeffect) || cJSON_IsNumber(jwb) || cJSON_IsBool(jaec) || cJSON_IsBool(jaec2) || cJSON_IsNumber(jgainceil))
+        // clés absentes ignorées (l'ancien code déréférençait chaque item)
+        bool ok = patch_json(root);
+        cJSON_Delete(root);
+        ESP_LOGI(TAG, "Camera settings updated");
+        return ok;
+    }
+
+    // Table clé JSON <-> registre capteur, partagée par to_json / patch_json / SettingsTransaction
+    struct CameraField
+    {
+        const char *key;
+        bool is_bool;
+        int (*get)(const camera_status_t &);
+        bool (*set)(CameraController &, int);
+        // ordre d'application : 0 modes auto/commutateurs, 1 valeurs, 2 qualité, 3 framesize
+        uint8_t rank;
+    };
+
+    static const CameraField CAMERA_FIELDS[] = {
+        {KEY_FRAME_SIZE, false, [](const camera_status_t &s) { return (int)s.framesize; }, [](CameraController &c, int v) { return c.setFrameSize(static_cast<framesize_t>(v)); }, 3},
+        {KEY_JPEG_QUALITY, false, [](const camera_status_t &s) { return (int)s.quality; }, [](CameraController &c, int v) { return c.setQuality(v); }, 2},
+        {KEY_CONTRAST, false, [](const camera_status_t &s) { return (int)s.contrast; }, [](CameraController &c, int v) { return c.setContrast(v); }, 1},
+        {KEY_BRIGHTNESS, false, [](const camera_status_t &s) { return (int)s.brightness; }, [](CameraController &c, int v) { return c.setBrightness(v); }, 1},
+        {KEY_SATURATION, false, [](const camera_status_t &s) { return (int)s.saturation; }, [](CameraController &c, int v) { return c.setSaturation(v); }, 1},
+        {KEY_AEC_VALUE, false, [](const camera_status_t &s) { return (int)s.aec_value; }, [](CameraController &c, int v) { return c.setAecValue(v); }, 1},
+        {KEY_AE_LEVEL, false, [](const camera_status_t &s) { return (int)s.ae_level; }, [](CameraController &c, int v) { return c.setAeLevel(v); }, 1},
+        {KEY_AWB, true, [](const camera_status_t &s) { return (int)s.awb; }, [](CameraController &c, int v) { return c.setAwb(v); }, 0},
+        {KEY_AWB_GAIN, true, [](const camera_status_t &s) { return (int)s.awb_gain; }, [](CameraController &c, int v) { return c.setAwbGain(v); }, 0},
+        {KEY_AGC, true, [](const camera_status_t &s) { return (int)s.agc; }, [](CameraController &c, int v) { return c.setAgc(v); }, 0},
+        {KEY_AGC_GAIN, false, [](const camera_status_t &s) { return (int)s.agc_gain; }, [](CameraController &c, int v) { return c.setAgcGain(v); }, 1},
+        {KEY_BPC, true, [](const camera_status_t &s) { return (int)s.bpc; }, [](CameraController &c, int v) { return c.setBpc(v); }, 0},
+        {KEY_WPC, true, [](const camera_status_t &s) { return (int)s.wpc; }, [](CameraController &c, int v) { return c.setWpc(v); }, 0},
+        {KEY_RAW_GMA, true, [](const camera_status_t &s) { return (int)s.raw_gma; }, [](CameraController &c, int v) { return c.setRawGma(v); }, 0},
+        {KEY_LENC, true, [](const camera_status_t &s) { return (int)s.lenc; }, [](CameraController &c, int v) { return c.setLensCorrection(v); }, 0},
+        {KEY_HMIRROR, true, [](const camera_status_t &s) { return (int)s.hmirror; }, [](CameraController &c, int v) { return c.setHorizontalMirror(v); }, 0},
+        {KEY_VFLIP, true, [](const camera_status_t &s) { return (int)s.vflip; }, [](CameraController &c, int v) { return c.setVerticalFlip(v); }, 0},
+        {KEY_DOWNSIZE, true, [](const camera_status_t &s) { return (int)s.dcw; }, [](CameraController &c, int v) { return c.setDownsizeEnable(v); }, 0},
+        {KEY_COLORBAR, true, [](const camera_status_t &s) { return (int)s.colorbar; }, [](CameraController &c, int v) { return c.setColorBar(v); }, 0},
+        {KEY_SHARPNESS, false, [](const camera_status_t &s) { return (int)s.sharpness; }, [](CameraController &c, int v) { return c.setSharpness(v); }, 1},
+        {KEY_DENOISE, false, [](const camera_status_t &s) { return (int)s.denoise; }, [](CameraController &c, int v) { return c.setDenoise(v); }, 1},
+        {KEY_SPECIAL_EFFECT, false, [](const camera_status_t &s) { return (int)s.special_effect; }, [](CameraController &c, int v) { return c.setSpecialEffect(v); }, 1},
+        {KEY_WB_MODE, false, [](const camera_status_t &s) { return (int)s.wb_mode; }, [](CameraController &c, int v) { return c.setWbMode(v); }, 1},
+        {KEY_AEC, true, [](const camera_status_t &s) { return (int)s.aec; }, [](CameraController &c, int v) { return c.setAec(v); }, 0},
+        {KEY_AEC2, true, [](const camera_status_t &s) { return (int)s.aec2; }, [](CameraController &c, int v) { return c.setAec2(v); }, 0},
+        {KEY_GAINCEILING, false, [](const camera_status_t &s) { return (int)s.gainceiling; }, [](CameraController &c, int v) { return c.setGainCeiling(v); }, 1},
+    };
+
+    static constexpr size_t FIELD_COUNT = sizeof(CAMERA_FIELDS) / sizeof(CAMERA_FIELDS[0]);
+    static constexpr uint8_t MAX_RANK = 3;
+    static_assert(FIELD_COUNT == SettingsTransaction::FIELD_COUNT, "SettingsTransaction::FIELD_COUNT");
+    static_assert(FIELD_COUNT <= 32, "SettingsTransaction staged mask");
+
+    static int field_index(const char *key)
+    {
+        for (size_t i = 0; i < FIELD_COUNT; ++i)
+            if (strcmp(CAMERA_FIELDS[i].key, key) == 0)
+                return (int)i;
+        return -1;
+    }
+
+    bool CameraController::fill_json(cJSON *obj)
+    {
+        if (!sensor || !obj)
+            return false;
+
+        for (const auto &f : CAMERA_FIELDS)
         {
+            int v = f.get(sensor->status);
+            if (f.is_bool)
+                cJSON_AddBoolToObject(obj, f.key, v);
+            else
+                cJSON_AddNumberToObject(obj, f.key, v);
+        }
+        return true;
+    }
 
-            auto fs = static_cast<framesize_t>(js->valueint);
-            auto q = static_cast<int>(jp->valueint);
-            auto c = static_cast<int>(jc->valueint);
-            auto b = static_cast<int>(jb->valueint);
-            auto s = static_cast<int>(ja->valueint);
-            auto aec = static_cast<int>(je->valueint);
-            auto ae = static_cast<int>(jf->valueint);
-            auto awb = static_cast<bool>(jg->valueint);
-            auto awb_gain = static_cast<bool>(jh->valueint);
-            auto agc = static_cast<bool>(ji->valueint);
-            auto agc_gain = static_cast<int>(jj->valueint);
-            auto bpc = static_cast<bool>(jk->valueint);
-            auto wpc = static_cast<bool>(jl->valueint);
-            auto raw_gma = static_cast<bool>(jm->valueint);
-            auto lenc = static_cast<bool>(jn->valueint);
-            auto hmirror = static_cast<bool>(jo->valueint);
-            auto vflip = static_cast<bool>(jp2->valueint);
-            auto downsize = static_cast<bool>(jq->valueint);
-            auto colorbar = static_cast<bool>(jr->valueint);
-            auto sharpness = static_cast<int>(jsharpness->valueint);
-            auto denoise = static_cast<int>(jdenoise->valueint);
-            auto special_effect = static_cast<int>(jeffect->valueint);
-            auto wb_mode = static_cast<int>(jwb->valueint);
-            auto aec2 = static_cast<bool>(jaec2->valueint);
-            auto gainceil = static_cast<int>(jgainceil->valueint);
-
-            if (fs != sensor->status.framesize)
-            {
-                setFrameSize(fs);
-            }
-            if (q != sensor->status.quality)
-            {
-                setQuality(q);
-            }
-            if (c != sensor->status.contrast)
-            {
-                setContrast(c);
-            }
-            if (b != sensor->status.brightness)
-            {
-                setBrightness(b);
-            }
-            if (s != sensor->status.saturation)
-            {
-                setSaturation(s);
-            }
-            if (aec != sensor->status.aec_value)
-            {
-                setAecValue(aec);
-            }
-            if (ae != sensor->status.ae_level)
-            {
-                setAeLevel(ae);
-            }
-            if (awb != sensor->status.awb)
-            {
-                setAwb(awb);
-            }
-            if (awb_gain != sensor->status.awb_gain)
-            {
-                setAwbGain(awb_gain);
-            }
-            if (agc != sensor->status.agc)
-            {
-                setAgc(agc);
-            }
-            if (agc_gain != sensor->status.agc_gain)
-            {
-                setAgcGain(agc_gain);
-            }
-            if (bpc != sensor->status.bpc)
-            {
-                setBpc(bpc);
-            }
-            if (wpc != sensor->status.wpc)
-            {
-                setWpc(wpc);
-            }
-            if (raw_gma != sensor->status.raw_gma)
-            {
-                setRawGma(raw_gma);
-            }
-            if (lenc != sensor->status.lenc)
-            {
-                setLensCorrection(lenc);
-            }
-            if (hmirror != sensor->status.hmirror)
-            {
-                setHorizontalMirror(hmirror);
-            }
-            if (vflip != sensor->status.vflip)
-            {
-                setVerticalFlip(vflip);
-            }
-            if (downsize != sensor->status.denoise)
-            {
-                setDownsizeEnable(downsize);
-            }
-            if (colorbar != sensor->status.colorbar)
-            {
-                setColorBar(colorbar);
-            }
-            if (sharpness != sensor->status.sharpness)
-            {
-                setSharpness(sharpness);
-            }
-            if (denoise != sensor->status.denoise)
-            {
-                setDenoise(denoise);
-            }
-            if (special_effect != sensor->status.special_effect)
+    void CameraController::publish_snapshot()
+    {
+        cJSON *root = cJSON_CreateObject();
+        if (!root)
+            return;
+        if (fill_json(root))
+            snapshot::publish(snapshot::Key::CAMERA, root);
+        cJSON_Delete(root);
+    }
+
+    // N'applique que les clés présentes et différentes de l'état capteur
+    bool CameraController::patch_json(const cJSON *obj)
+    {
+        if (!sensor || !cJSON_IsObject(obj))
+            return false;
+
+        bool ok = true;
+        SettingsTransaction tx;
+        for (const auto &f : CAMERA_FIELDS)
+        {
+            const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, f.key);
+            if (!item)
+                continue;
+            if (!cJSON_IsNumber(item) && !cJSON_IsBool(item))
             {
-                setSpecialEffect(special_effect);
+                ok = false;
+                continue;
             }
-            if (wb_mode != sensor->status.wb_mode)
+            tx.set(f.key, cJSON_IsBool(item) ? cJSON_IsTrue(item) : item->valueint);
+        }
+        return tx.commit() && ok;
+    }
+
+    bool CameraController::validate_json(const cJSON *obj)
+    {
+        if (!cJSON_IsObject(obj))
+            return false;
+        const cJSON *item = nullptr;
+        cJSON_ArrayForEach(item, obj)
+        {
+            const CameraField *field = nullptr;
+            for (const auto &f : CAMERA_FIELDS)
             {
-                setWbMode(wb_mode);
+                if (strcmp(f.key, item->string) == 0)
+                {
+                    field = &f;
+                    break;
+                }
             }
-            if (aec2 != sensor->status.aec2)
+            if (!field)
+                return false;
+            if (field->is_bool ? !cJSON_IsBool(item) && !cJSON_IsNumber(item) : !cJSON_IsNumber(item))
+                return false;
+        }
+        return true;
+    }
+
+#pragma region TRANSACTION
+    struct SettingsStats
+    {
+        uint32_t commits;
+        uint32_t written;
+        uint32_t skipped;
+        uint32_t failed;
+        uint32_t paused;
+        int64_t last_us;
+        int64_t total_us;
+    };
+    static std::mutex s_settings_mutex;
+    static SettingsStats s_settings_stats = {};
+
+    void SettingsTransaction::stage(size_t index, int value)
+    {
+        values_[index] = value;
+        staged_ |= 1u << index;
+    }
+
+    bool SettingsTransaction::set(const char *key, int value)
+    {
+        int index = field_index(key);
+        if (index < 0)
+            return false;
+        stage(index, value);
+        return true;
+    }
+
+    void SettingsTransaction::setFrameSize(framesize_t size)
+    {
+        set(KEY_FRAME_SIZE, size);
+    }
+
+    void SettingsTransaction::setQuality(int value)
+    {
+        set(KEY_JPEG_QUALITY, value);
+    }
+
+    void SettingsTransaction::setConfig(const camera_config_persist &cfg)
+    {
+        set(KEY_FRAME_SIZE, cfg.framesize);
+        set(KEY_JPEG_QUALITY, cfg.quality);
+        set(KEY_CONTRAST, cfg.contrast);
+        set(KEY_BRIGHTNESS, cfg.brightness);
+        set(KEY_SATURATION, cfg.saturation);
+        set(KEY_SHARPNESS, cfg.sharpness);
+        set(KEY_DENOISE, cfg.denoise);
+        set(KEY_SPECIAL_EFFECT, cfg.special_effect);
+        set(KEY_WB_MODE, cfg.wb_mode);
+        set(KEY_AE_LEVEL, cfg.ae_level);
+        set(KEY_AEC_VALUE, cfg.aec_value);
+        set(KEY_AGC_GAIN, cfg.agc_gain);
+        set(KEY_GAINCEILING, cfg.gainceiling);
+        set(KEY_AWB, cfg.awb);
+        set(KEY_AWB_GAIN, cfg.awb_gain);
+        set(KEY_AGC, cfg.agc);
+        set(KEY_BPC, cfg.bpc);
+        set(KEY_WPC, cfg.wpc);
+        set(KEY_RAW_GMA, cfg.raw_gma);
+        set(KEY_LENC, cfg.lenc);
+        set(KEY_HMIRROR, cfg.hmirror);
+        set(KEY_VFLIP, cfg.vflip);
+        set(KEY_DOWNSIZE, cfg.downsize);
+        set(KEY_COLORBAR, cfg.colorbar);
+        set(KEY_AEC, cfg.aec);
+        set(KEY_AEC2, cfg.aec2);
+    }
+
+    bool SettingsTransaction::commit()
+    {
+        written_ = skipped_ = 0;
+        if (!sensor || !staged_)
+            return sensor != nullptr;
+
+        std::unique_lock<std::mutex> lock(s_settings_mutex);
+        int64_t start = esp_timer_get_time();
+
+        // diff : seules les valeurs différentes de l'état capteur sont écrites
+        uint32_t pending = 0;
+        bool framesize_changed = false;
+        for (size_t i = 0; i < FIELD_COUNT; ++i)
+        {
+            if (!(staged_ & (1u << i)))
+                continue;
+            if (values_[i] == CAMERA_FIELDS[i].get(sensor->status))
             {
-                setAec2(aec2);
+                skipped_++;
+                continue;
             }
-            if (gainceil != sensor->status.gainceiling)
+            pending |= 1u << i;
+            if (CAMERA_FIELDS[i].rank == MAX_RANK)
+                framesize_changed = true;
+        }
+
+        // framesize reconfigure la fenêtre capteur : pas d'image à moitié réglée
+        auto &broadcaster = camera::FrameBroadcaster::getInstance();
+        if (framesize_changed)
+            broadcaster.pause();
+
+        bool ok = true;
+        auto &cam = CameraController::getInstance();
+        for (uint8_t rank = 0; rank <= MAX_RANK; ++rank)
+        {
+            for (size_t i = 0; i < FIELD_COUNT; ++i)
             {
-                setGainCeiling(gainceil);
+                if (!(pending & (1u << i)) || CAMERA_FIELDS[i].rank != rank)
+                    continue;
+                written_++;
+                if (!CAMERA_FIELDS[i].set(cam, values_[i]))
+                {
+                    ESP_LOGW(TAG, "sensor rejected %s=%d", CAMERA_FIELDS[i].key, values_[i]);
+                    ok = false;
+                }
             }
         }
-        cJSON_Delete(root);
-        ESP_LOGI(TAG, "Camera settings updated");
-        return true;
+
+        if (framesize_changed)
+            broadcaster.resume();
+
+        int64_t elapsed = esp_timer_get_time() - start;
+        s_settings_stats.commits++;
+        s_settings_stats.written += written_;
+        s_settings_stats.skipped += skipped_;
+        s_settings_stats.failed += ok ? 0 : 1;
+        s_settings_stats.paused += framesize_changed ? 1 : 0;
+        s_settings_stats.last_us = elapsed;
+        s_settings_stats.total_us += elapsed;
+
+        // réglage utilisateur (API, preset, chargement) : nouvelle base pour le pacing
+        int base_quality = -1, base_framesize = -1;
+        if (!pacing_)
+        {
+            int qi = field_index(KEY_JPEG_QUALITY), fi = field_index(KEY_FRAME_SIZE);
+            if (staged_ & (1u << qi))
+                base_quality = values_[qi];
+            if (staged_ & (1u << fi))
+                base_framesize = values_[fi];
+        }
+        staged_ = 0;
+        lock.unlock();
+
+        if (base_quality >= 0 || base_framesize >= 0)
+            camera::StreamQuality::getInstance().baseChanged(base_quality, base_framesize);
+
+        // snapshot publié hors verrou : les clients WS reçoivent le delta
+        if (written_)
+            cam.publish_snapshot();
+        return ok;
+    }
+
+    void SettingsTransaction::stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(s_settings_mutex);
+        const SettingsStats &st = s_settings_stats;
+        cJSON_AddNumberToObject(obj, "commits", st.commits);
+        cJSON_AddNumberToObject(obj, "written", st.written);
+        cJSON_AddNumberToObject(obj, "skipped", st.skipped);
+        cJSON_AddNumberToObject(obj, "failed", st.failed);
+        cJSON_AddNumberToObject(obj, "capture_paused", st.paused);
+        cJSON_AddNumberToObject(obj, "last_ms", st.last_us / 1000.0);
+        cJSON_AddNumberToObject(obj, "avg_ms", st.commits ? st.total_us / 1000.0 / st.commits : 0);
+    }
+#pragma endregion TRANSACTION
+
+    void CameraController::stage_save(persist::Batch &batch)
+    {
+        extract_config(m_config);
+        batch.add(CAMERA_CFG_PATH, &m_config, sizeof(m_config));
     }
 
     __attribute__((noinline)) std::string CameraController::to_json()
@@ -505,40 +636,16 @@ namespace camera_controller
             return "";
         }
 
-        cJSON_AddNumberToObject(root, KEY_FRAME_SIZE, sensor->status.framesize);
-        cJSON_AddNumberToObject(root, KEY_JPEG_QUALITY, sensor->status.quality);
-        cJSON_AddNumberToObject(root, KEY_CONTRAST, sensor->status.contrast);
-        cJSON_AddNumberToObject(root, KEY_BRIGHTNESS, sensor->status.brightness);
-        cJSON_AddNumberToObject(root, KEY_SATURATION, sensor->status.saturation);
-        cJSON_AddNumberToObject(root, KEY_AEC_VALUE, sensor->status.aec_value);
-        cJSON_AddNumberToObject(root, KEY_AE_LEVEL, sensor->status.ae_level);
-        cJSON_AddBoolToObject(root, KEY_AWB, sensor->status.awb);
-        cJSON_AddBoolToObject(root, KEY_AWB_GAIN, sensor->status.awb_gain);
-        cJSON_AddBoolToObject(root, KEY_AGC, sensor->status.agc);
-        cJSON_AddNumberToObject(root, KEY_AGC_GAIN, sensor->status.agc_gain);
-        cJSON_AddBoolToObject(root, KEY_BPC, sensor->status.bpc);
-        cJSON_AddBoolToObject(root, KEY_WPC, sensor->status.wpc);
-        cJSON_AddBoolToObject(root, KEY_RAW_GMA, sensor->status.raw_gma);
-        cJSON_AddBoolToObject(root, KEY_LENC, sensor->status.lenc);
-        cJSON_AddBoolToObject(root, KEY_HMIRROR, sensor->status.hmirror);
-        cJSON_AddBoolToObject(root, KEY_VFLIP, sensor->status.vflip);
-        cJSON_AddBoolToObject(root, KEY_DOWNSIZE, sensor->status.dcw);
-        cJSON_AddBoolToObject(root, KEY_COLORBAR, sensor->status.colorbar);
-        cJSON_AddNumberToObject(root, KEY_SHARPNESS, sensor->status.sharpness);
-        cJSON_AddNumberToObject(root, KEY_DENOISE, sensor->status.denoise);
-        cJSON_AddNumberToObject(root, KEY_SPECIAL_EFFECT, sensor->status.special_effect);
-        cJSON_AddNumberToObject(root, KEY_WB_MODE, sensor->status.wb_mode);
-        cJSON_AddBoolToObject(root, KEY_AEC, sensor->status.aec);
-        cJSON_AddBoolToObject(root, KEY_AEC2, sensor->status.aec2);
-        cJSON_AddNumberToObject(root, KEY_GAINCEILING, sensor->status.gainceiling);
+        fill_json(root);
 
         char *ret = cJSON_Print(root);
         cJSON_Delete(root);
 
-        if (ret)
-            return ret;
-        else
+        if (!ret)
             return "";
+        std::string out(ret);
+        cJSON_free(ret);
+        return out;
     }
 
 }
\ No newline at end of file
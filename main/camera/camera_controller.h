@@ -8,6 +8,7 @@
 #include "cJSON.h"
 #include <string>
 #include "camera.h"
+#include "persistence.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -50,6 +51,8 @@ namespace camera_controller
         static CameraController *_instance;
 
     public:
+        static constexpr int XCLK_FREQ_HZ = 20000000;
+
         static CameraController &getInstance()
         {
             if (!_instance)
@@ -78,7 +81,6 @@ namespace camera_controller
         CameraController &operator=(const CameraController &) = delete;
         static constexpr const char *TAG = "CameraController";
         void apply_config(const camera_config_persist &cfg);
-        void extract_config(camera_config_persist &cfg) const;
         static camera_config_t get_camera_config()
         {
             camera_config_t config{};
@@ -89,8 +91,11 @@ namespace camera_controller
             config.pixel_format = PIXFORMAT_JPEG;
             config.frame_size = FRAMESIZE_SVGA;
             config.jpeg_quality = 12;
-            config.fb_count = 2;
-            config.xclk_freq_hz = 20000000;
+            // dernière image (broadcaster) + une en cours d'envoi + une en capture
+            config.fb_count = CONFIG_IOT_CAMERA_FB_COUNT;
+            config.fb_location = CAMERA_FB_IN_PSRAM;
+            config.grab_mode = CAMERA_GRAB_LATEST;
+            config.xclk_freq_hz = XCLK_FREQ_HZ;
 
 #if CONFIG_OV2640_SUPPORT
             // AI-Thinker ESP32-CAM
@@ -262,6 +267,18 @@ namespace camera_controller
 
         __attribute__((noinline)) bool from_json(const std::string &json);
         __attribute__((noinline)) std::string to_json();
+        /// Ajoute l'état courant du capteur dans obj (sans impression/re-parse)
+        bool fill_json(cJSON *obj);
+        /// Publie l'état capteur (snapshot CAMERA : GET /iot/camera, deltas WebSocket)
+        void publish_snapshot();
+        /// Applique uniquement les clés présentes dans obj
+        bool patch_json(const cJSON *obj);
+        /// Clés connues et types corrects, sans rien appliquer
+        static bool validate_json(const cJSON *obj);
+        /// Etat courant du capteur au format persistant (presets, sauvegarde)
+        void extract_config(camera_config_persist &cfg) const;
+        /// Ajoute l'état courant à une écriture groupée (au lieu de save())
+        void stage_save(persist::Batch &batch);
         static void on_event(const Event *evt)
         {
             if (evt->type == EventType::FS_READY)
@@ -281,5 +298,44 @@ namespace camera_controller
         inline static register_event_bus reg_event_bus;
     };
 
+    /**
+     * Réglages capteur groupés : les valeurs sont d'abord collectées, puis
+     * commit() n'écrit que celles qui diffèrent de sensor->status, dans un
+     * ordre qui limite les reconfigurations (modes auto avant valeurs
+     * manuelles, framesize en dernier). Si framesize change, la capture est
+     * suspendue le temps du commit et l'image suivante est jetée.
+     */
+    class SettingsTransaction
+    {
+    public:
+        static constexpr size_t FIELD_COUNT = 26;
+
+        SettingsTransaction() = default;
+        // false si la clé est inconnue
+        bool set(const char *key, int value);
+        void setFrameSize(framesize_t size);
+        void setQuality(int value);
+        void setConfig(const camera_config_persist &cfg);
+        // Réglage imposé par StreamQuality : ne remplace pas les réglages de base
+        void markPacing() { pacing_ = true; }
+        bool empty() const { return staged_ == 0; }
+
+        // false si une écriture a été refusée par le capteur
+        bool commit();
+        uint8_t written() const { return written_; }
+        uint8_t skipped() const { return skipped_; }
+
+        static void stats_to_json(cJSON *obj);
+
+    private:
+        void stage(size_t index, int value);
+
+        int values_[FIELD_COUNT] = {};
+        uint32_t staged_ = 0; // bit i : values_[i] à appliquer
+        uint8_t written_ = 0;
+        uint8_t skipped_ = 0;
+        bool pacing_ = false;
+    };
+
 } // namespace iot::camera
 #endif // CONFIG_IOT_CAMERA
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "camera_stats.h"
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "macro.h"
+#include "camera_controller.h"
+#include "frame_broadcaster.h"
+#include "stream_pacing.h"
+#ifdef CONFIG_IOT_MOTION_ENABLE
+#include "motion.h"
+#endif
+#ifdef CONFIG_IOT_REC_ENABLE
+#include "recorder.h"
+#endif
+#ifdef CONFIG_IOT_MQTT_BROKER_ENABLE
+#include "MqttClient.hpp"
+#include "utils.h"
+#endif
+
+using namespace camera_controller;
+namespace camera
+{
+    void SizeHistogram::add(size_t len)
+    {
+        size_t bucket = 0;
+        while (bucket < BUCKETS - 1 && len > (size_t)BOUNDS_KB[bucket] * 1024)
+            bucket++;
+        counts[bucket]++;
+        if (!samples || len < min)
+            min = len;
+        if (len > max)
+            max = len;
+        total += len;
+        samples++;
+    }
+
+    void SizeHistogram::to_json(cJSON *obj) const
+    {
+        cJSON_AddNumberToObject(obj, "min", min);
+        cJSON_AddNumberToObject(obj, "avg", samples ? (double)total / samples : 0);
+        cJSON_AddNumberToObject(obj, "max", max);
+        // {"le_8k": n, ..., "gt_128k": n}
+        cJSON *hist = cJSON_AddObjectToObject(obj, "hist");
+        char key[12];
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            if (i < BUCKETS - 1)
+                snprintf(key, sizeof(key), "le_%uk", BOUNDS_KB[i]);
+            else
+                snprintf(key, sizeof(key), "gt_%uk", BOUNDS_KB[BUCKETS - 2]);
+            cJSON_AddNumberToObject(hist, key, counts[i]);
+        }
+    }
+
+    int CameraStats::openStream(int sockfd)
+    {
+        struct sockaddr_in addr = {};
+        socklen_t len = sizeof(addr);
+        uint32_t peer = getpeername(sockfd, (struct sockaddr *)&addr, &len) == 0 ? addr.sin_addr.s_addr : 0;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < CONFIG_IOT_CONN_STREAM_MAX; ++i)
+        {
+            if (streams_[i].active)
+                continue;
+            streams_[i] = {};
+            streams_[i].active = true;
+            streams_[i].id = next_id_++;
+            streams_[i].peer = peer;
+            streams_[i].started_us = esp_timer_get_time();
+            opened_++;
+            return i;
+        }
+        return -1;
+    }
+
+    void CameraStats::recordStreamFrame(int slot, size_t bytes, uint32_t skipped, int64_t send_us)
+    {
+        if (slot < 0 || slot >= CONFIG_IOT_CONN_STREAM_MAX)
+            return;
+        int64_t now = esp_timer_get_time();
+        std::lock_guard<std::mutex> lock(mutex_);
+        StreamCounters &s = streams_[slot];
+        if (s.last_frame_us && now > s.last_frame_us)
+        {
+            float interval = (float)(now - s.last_frame_us);
+            float fps = 1e6f / interval;
+            float rate = bytes * 1e6f / interval;
+            s.fps = s.fps == 0 ? fps : s.fps * 0.9f + fps * 0.1f;
+            s.bytes_per_s = s.bytes_per_s == 0 ? rate : s.bytes_per_s * 0.9f + rate * 0.1f;
+        }
+        s.last_frame_us = now;
+        s.frames++;
+        s.skipped += skipped;
+        s.bytes += bytes;
+        s.send_us = s.send_us == 0 ? send_us : s.send_us * 0.9f + send_us * 0.1f;
+        if (send_us > s.send_max_us)
+            s.send_max_us = send_us;
+
+        frames_++;
+        skipped_ += skipped;
+        bytes_ += bytes;
+    }
+
+    void CameraStats::closeStream(int slot)
+    {
+        if (slot < 0 || slot >= CONFIG_IOT_CONN_STREAM_MAX)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        const StreamCounters &s = streams_[slot];
+        ESP_LOGI(TAG, "stream %lu closed: %lu frames, %lu skipped, %.1f fps",
+                 (unsigned long)s.id, (unsigned long)s.frames, (unsigned long)s.skipped, s.fps);
+        streams_[slot].active = false;
+    }
+
+    // mutex_ tenu
+    float CameraStats::throughputLocked() const
+    {
+        float total = 0;
+        for (const StreamCounters &s : streams_)
+            if (s.active)
+                total += s.bytes_per_s;
+        return total;
+    }
+
+    void CameraStats::streams_to_json(cJSON *obj)
+    {
+        int64_t now = esp_timer_get_time();
+        std::lock_guard<std::mutex> lock(mutex_);
+        cJSON_AddNumberToObject(obj, "opened", opened_);
+        cJSON_AddNumberToObject(obj, "frames", frames_);
+        cJSON_AddNumberToObject(obj, "skipped", skipped_);
+        cJSON_AddNumberToObject(obj, "bytes", (double)bytes_);
+        cJSON_AddNumberToObject(obj, "kbps", throughputLocked() * 8 / 1000);
+
+        cJSON *active = cJSON_AddArrayToObject(obj, "active");
+        for (const StreamCounters &s : streams_)
+        {
+            if (!s.active)
+                continue;
+            cJSON *item = cJSON_CreateObject();
+            if (!item)
+                break;
+            const uint8_t *ip = reinterpret_cast<const uint8_t *>(&s.peer);
+            char peer[16];
+            snprintf(peer, sizeof(peer), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+            cJSON_AddNumberToObject(item, "id", s.id);
+            cJSON_AddStringToObject(item, "peer", peer);
+            cJSON_AddNumberToObject(item, "uptime_s", (double)((now - s.started_us) / 1000000));
+            cJSON_AddNumberToObject(item, "frames", s.frames);
+            cJSON_AddNumberToObject(item, "skipped", s.skipped);
+            cJSON_AddNumberToObject(item, "bytes", (double)s.bytes);
+            cJSON_AddNumberToObject(item, "fps", s.fps);
+            cJSON_AddNumberToObject(item, "kbps", s.bytes_per_s * 8 / 1000);
+            cJSON_AddNumberToObject(item, "send_us", s.send_us);
+            cJSON_AddNumberToObject(item, "send_max_us", (double)s.send_max_us);
+            cJSON_AddItemToArray(active, item);
+        }
+    }
+
+    void CameraStats::stats_to_json(cJSON *obj)
+    {
+        // réglages à confronter aux mesures
+        cJSON *config = cJSON_AddObjectToObject(obj, "config");
+        cJSON_AddNumberToObject(config, "xclk_hz", CameraController::XCLK_FREQ_HZ);
+        cJSON_AddNumberToObject(config, "fb_count", CONFIG_IOT_CAMERA_FB_COUNT);
+        cJSON_AddNumberToObject(config, "ring_depth", CONFIG_IOT_CAMERA_RING_DEPTH);
+        auto &cam = CameraController::getInstance();
+        sensor_t *sensor = cam.isInitialized() ? cam.getSensor() : nullptr;
+        if (sensor)
+        {
+            cJSON_AddNumberToObject(config, "quality", sensor->status.quality);
+            cJSON_AddNumberToObject(config, "framesize", sensor->status.framesize);
+        }
+
+        FrameBroadcaster::getInstance().stats_to_json(cJSON_AddObjectToObject(obj, "capture"));
+        streams_to_json(cJSON_AddObjectToObject(obj, "streams"));
+        StreamQuality::getInstance().stats_to_json(cJSON_AddObjectToObject(obj, "quality"));
+        SettingsTransaction::stats_to_json(cJSON_AddObjectToObject(obj, "settings"));
+#ifdef CONFIG_IOT_MOTION_ENABLE
+        MotionDetector::getInstance().stats_to_json(cJSON_AddObjectToObject(obj, "motion"));
+#endif
+#ifdef CONFIG_IOT_REC_ENABLE
+        Recorder::getInstance().stats_to_json(cJSON_AddObjectToObject(obj, "recorder"));
+#endif
+    }
+
+    void CameraStats::resetStats()
+    {
+        FrameBroadcaster::getInstance().resetStats();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (StreamCounters &s : streams_)
+            s.send_max_us = 0;
+    }
+
+    // Copie des clés choisies de src vers dst
+    static void pick(cJSON *dst, const cJSON *src, const char *const *keys, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const cJSON *item = cJSON_GetObjectItemCaseSensitive(src, keys[i]);
+            if (item)
+                cJSON_AddItemToObject(dst, keys[i], cJSON_Duplicate(item, true));
+        }
+    }
+
+    void CameraStats::summary_to_json(cJSON *obj)
+    {
+        cJSON *full = cJSON_CreateObject();
+        if (!full)
+            return;
+        stats_to_json(full);
+
+        static const char *const CONFIG_KEYS[] = {"quality", "framesize"};
+        static const char *const CAPTURE_KEYS[] = {"fps", "captured", "capture_errors", "ring_full", "skipped",
+                                                   "fb_wait_us", "copy_us", "send_latency_us"};
+        static const char *const STREAM_KEYS[] = {"frames", "skipped", "kbps"};
+        pick(obj, cJSON_GetObjectItemCaseSensitive(full, "config"), CONFIG_KEYS, sizeof(CONFIG_KEYS) / sizeof(CONFIG_KEYS[0]));
+        pick(obj, cJSON_GetObjectItemCaseSensitive(full, "capture"), CAPTURE_KEYS, sizeof(CAPTURE_KEYS) / sizeof(CAPTURE_KEYS[0]));
+
+        const cJSON *jpeg = cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(full, "capture"), "jpeg");
+        const cJSON *avg = cJSON_GetObjectItemCaseSensitive(jpeg, "avg");
+        const cJSON *max = cJSON_GetObjectItemCaseSensitive(jpeg, "max");
+        if (cJSON_IsNumber(avg) && cJSON_IsNumber(max))
+        {
+            cJSON_AddNumberToObject(obj, "jpeg_avg", avg->valuedouble);
+            cJSON_AddNumberToObject(obj, "jpeg_max", max->valuedouble);
+        }
+
+        cJSON *streams = cJSON_AddObjectToObject(obj, "streams");
+        const cJSON *full_streams = cJSON_GetObjectItemCaseSensitive(full, "streams");
+        cJSON_AddNumberToObject(streams, "active", cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(full_streams, "active")));
+        pick(streams, full_streams, STREAM_KEYS, sizeof(STREAM_KEYS) / sizeof(STREAM_KEYS[0]));
+        cJSON_Delete(full);
+    }
+
+    esp_err_t CameraStats::handler(httpd_req_t *req)
+    {
+        char query[16];
+        char value[4];
+        auto &self = getInstance();
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "reset", value, sizeof(value)) == ESP_OK && value[0] == '1')
+            self.resetStats();
+
+        cJSON *root = cJSON_CreateObject();
+        if (!root)
+            return httpd_resp_send_500(req);
+        self.stats_to_json(root);
+        char *json = cJSON_PrintUnformatted(root);
+        cJSON_Delete(root);
+        if (!json)
+            return httpd_resp_send_500(req);
+        SET_RESP_HEADERS(req);
+        esp_err_t err = httpd_resp_send(req, json, strlen(json));
+        cJSON_free(json);
+        return err;
+    }
+
+    void CameraStats::on_event(const Event *evt)
+    {
+#if defined(CONFIG_IOT_MQTT_BROKER_ENABLE) && CONFIG_IOT_CAMERA_STATS_PUBLISH_S > 0
+        if (evt->type != EventType::MQTT_CONNECTED)
+            return;
+        auto &self = getInstance();
+        {
+            std::lock_guard<std::mutex> lock(self.mutex_);
+            if (self.publisher_registered_)
+                return;
+            self.publisher_registered_ = true;
+        }
+        std::string topic = std::string(CONFIG_IOT_CAMERA_STATS_TOPIC) + "/" + utils::device_id();
+        MqttClient::getInstance().registerPublisher(topic.c_str(), [](const char *)
+                                                    {
+                                                        cJSON *root = cJSON_CreateObject();
+                                                        if (!root)
+                                                            return std::string();
+                                                        getInstance().summary_to_json(root);
+                                                        char *json = cJSON_PrintUnformatted(root);
+                                                        cJSON_Delete(root);
+                                                        std::string result = json ? json : "";
+                                                        cJSON_free(json);
+                                                        return result; },
+                                                    CONFIG_IOT_CAMERA_STATS_PUBLISH_S * 1000);
+        ESP_LOGI(TAG, "publishing on %s every %d s", topic.c_str(), CONFIG_IOT_CAMERA_STATS_PUBLISH_S);
+#endif
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef __IOT_CAMERA_STATS_H__
+#define __IOT_CAMERA_STATS_H__
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "cJSON.h"
+#include "esp_http_server.h"
+#include "event_bus.h"
+#include "sdkconfig.h"
+
+namespace camera
+{
+    // Répartition des tailles JPEG ; dernier seau = au-delà de la dernière borne
+    struct SizeHistogram
+    {
+        static constexpr uint16_t BOUNDS_KB[] = {8, 16, 32, 64, 128};
+        static constexpr size_t BUCKETS = sizeof(BOUNDS_KB) / sizeof(BOUNDS_KB[0]) + 1;
+
+        uint32_t counts[BUCKETS] = {};
+        uint32_t samples = 0;
+        uint32_t min = 0;
+        uint32_t max = 0;
+        uint64_t total = 0;
+
+        void add(size_t len);
+        void to_json(cJSON *obj) const;
+    };
+
+    // Compteurs d'un client MJPEG, du connect au close
+    struct StreamCounters
+    {
+        bool active = false;
+        uint32_t id = 0;
+        uint32_t peer = 0; // IPv4, ordre réseau
+        int64_t started_us = 0;
+        int64_t last_frame_us = 0;
+        uint32_t frames = 0;
+        uint32_t skipped = 0;
+        uint64_t bytes = 0;
+        float fps = 0;
+        float bytes_per_s = 0;
+        float send_us = 0;
+        int64_t send_max_us = 0;
+    };
+
+    /**
+     * Métriques de la chaîne caméra, pour régler xclk, fb_count et qualité
+     * sur des mesures : GET /iot/camera/stats (?reset=1 remet maxima et
+     * histogrammes à zéro) agrège capture, flux, qualité adaptative,
+     * détection de mouvement et enregistrement. Un résumé est publié en MQTT
+     * toutes les IOT_CAMERA_STATS_PUBLISH_S sur IOT_CAMERA_STATS_TOPIC/<device_id>.
+     *
+     * Chaque tâche de flux tient son emplacement : un client de plus ne coûte
+     * que sizeof(StreamCounters), rien n'est alloué par image.
+     */
+    class CameraStats
+    {
+    public:
+        static constexpr const char *TAG = "[CameraStats]";
+
+        static CameraStats &getInstance()
+        {
+            static CameraStats instance;
+            return instance;
+        }
+
+        // Emplacement pour un nouveau flux ; -1 si tous sont pris (non compté)
+        int openStream(int sockfd);
+        void recordStreamFrame(int slot, size_t bytes, uint32_t skipped, int64_t send_us);
+        void closeStream(int slot);
+
+        void stats_to_json(cJSON *obj);
+        void resetStats();
+        // Version courte, tient dans IOT_MQTT_PUBLISH_PAYLOAD_MAX
+        void summary_to_json(cJSON *obj);
+
+        static esp_err_t handler(httpd_req_t *req);
+
+        static void on_event(const Event *evt);
+        struct register_event_bus
+        {
+            register_event_bus()
+            {
+                EventBus::getInstance().subscribe(on_event, TAG);
+            }
+        };
+        inline static register_event_bus _register_event_bus;
+
+    private:
+        CameraStats() = default;
+        CameraStats(const CameraStats &) = delete;
+        CameraStats &operator=(const CameraStats &) = delete;
+
+        void streams_to_json(cJSON *obj);
+        // mutex_ tenu ; débit cumulé des flux actifs (octets/s)
+        float throughputLocked() const;
+
+        std::mutex mutex_;
+        StreamCounters streams_[CONFIG_IOT_CONN_STREAM_MAX];
+        uint32_t next_id_ = 1;
+        bool publisher_registered_ = false;
+
+        // flux fermés compris
+        uint32_t opened_ = 0;
+        uint32_t frames_ = 0;
+        uint32_t skipped_ = 0;
+        uint64_t bytes_ = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include "frame_broadcaster.h"
+#include <chrono>
+#include <sys/time.h>
+#include <cstring>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "camera_controller.h"
+
+using namespace camera_controller;
+namespace camera
+{
+    static constexpr int64_t WARM_US = (int64_t)CONFIG_IOT_CAPTURE_WARM_S * 1000 * 1000;
+    static constexpr size_t SLOT_GRANULE = 16 * 1024;
+#if portNUM_PROCESSORS > 1
+    static constexpr BaseType_t CAPTURE_CORE = CONFIG_IOT_CAMERA_CAPTURE_CORE;
+#else
+    static constexpr BaseType_t CAPTURE_CORE = 0;
+#endif
+
+    Frame::Frame(const uint8_t *data, size_t len, uint32_t seq, int64_t captured_us, uint8_t slot)
+        : data(data), len(len), seq(seq), captured_us(captured_us), slot(slot)
+    {
+    }
+
+    int64_t Frame::wall_us() const
+    {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (esp_timer_get_time() - captured_us);
+    }
+
+    Frame::~Frame()
+    {
+        FrameBroadcaster::getInstance().releaseSlot(slot);
+    }
+
+    void FrameBroadcaster::subscribe()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers_++;
+        startTaskLocked();
+        cv_.notify_all();
+    }
+
+    // mutex_ tenu
+    void FrameBroadcaster::startTaskLocked()
+    {
+        if (!task_)
+            xTaskCreatePinnedToCore(capture_task, "cam_capture", 4096, this, 6, &task_, CAPTURE_CORE);
+    }
+
+    void FrameBroadcaster::unsubscribe()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (subscribers_ > 0)
+            subscribers_--;
+    }
+
+    FramePtr FrameBroadcaster::waitNext(uint32_t last_seq, TickType_t timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool ready = cv_.wait_for(lock, std::chrono::milliseconds(pdTICKS_TO_MS(timeout)),
+                                  [&]
+                                  { return latest_ && latest_->seq != last_seq; });
+        if (!ready)
+            return nullptr;
+        delivered_++;
+        // images produites depuis la précédente livraison à ce client
+        if (last_seq && latest_->seq - last_seq > 1)
+            skipped_ += latest_->seq - last_seq - 1;
+        return latest_;
+    }
+
+    FramePtr FrameBroadcaster::latest()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return latest_;
+    }
+
+    FramePtr FrameBroadcaster::snapshot(int64_t max_age_us, TickType_t timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int64_t now = esp_timer_get_time();
+        warm_until_us_ = now + WARM_US;
+        if (latest_ && now - latest_->captured_us <= max_age_us)
+        {
+            snapshot_hits_++;
+            return latest_;
+        }
+
+        // réveille la capture si elle dormait ; tous les appelants en attente
+        // reçoivent la même image
+        snapshot_waits_++;
+        startTaskLocked();
+        cv_.notify_all();
+        bool ready = cv_.wait_for(lock, std::chrono::milliseconds(pdTICKS_TO_MS(timeout)),
+                                  [&]
+                                  { return latest_ && latest_->captured_us >= now; });
+        if (!ready)
+        {
+            snapshot_timeouts_++;
+            return nullptr;
+        }
+        return latest_;
+    }
+
+    void FrameBroadcaster::capture_task(void *arg)
+    {
+        static_cast<FrameBroadcaster *>(arg)->captureLoop();
+    }
+
+    void FrameBroadcaster::captureLoop()
+    {
+        auto &cam = CameraController::getInstance();
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (subscribers_ == 0 && esp_timer_get_time() >= warm_until_us_)
+                {
+                    // plus personne : libérer le slot de la dernière image et dormir
+                    latest_.reset();
+                    last_capture_us_ = 0;
+                    fps_ = 0;
+                    cv_.wait(lock, [&]
+                             { return subscribers_ > 0 || esp_timer_get_time() < warm_until_us_; });
+                }
+                cv_.wait(lock, [&]
+                         { return !paused_; });
+                capturing_ = true;
+            }
+
+            int64_t wait_start = esp_timer_get_time();
+            camera_fb_t *fb = cam.tryCapture();
+            int64_t fb_wait = esp_timer_get_time() - wait_start;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                capturing_ = false;
+                cv_.notify_all();
+                if (fb)
+                {
+                    fb_wait_us_ = fb_wait_us_ == 0 ? fb_wait : fb_wait_us_ * 0.9f + fb_wait * 0.1f;
+                    if (fb_wait > fb_wait_max_us_)
+                        fb_wait_max_us_ = fb_wait;
+                }
+                // capturée pendant ou juste après une reconfiguration : image douteuse
+                if (fb && (paused_ || discard_ > 0))
+                {
+                    if (!paused_)
+                        discard_--;
+                    discarded_++;
+                    cam.releaseCapture(fb);
+                    continue;
+                }
+            }
+            if (!fb)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    capture_errors_++;
+                }
+                ESP_LOGW(TAG, "capture failed");
+                vTaskDelay(pdMS_TO_TICKS(100));
+                continue;
+            }
+
+            int64_t now = esp_timer_get_time();
+            int slot = copyToSlot(fb);
+            size_t len = fb->len;
+            // le driver récupère son buffer avant toute attente réseau
+            cam.releaseCapture(fb);
+            float copy_us = (float)(esp_timer_get_time() - now);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (slot < 0)
+            {
+                ring_full_++;
+                continue;
+            }
+            // l'image précédente rend son slot ici si aucun client ne l'envoie
+            latest_ = std::make_shared<const Frame>(slots_[slot].buf, len, ++seq_, now, (uint8_t)slot);
+            captured_++;
+            jpeg_sizes_.add(len);
+            copy_us_ = copy_us_ == 0 ? copy_us : copy_us_ * 0.9f + copy_us * 0.1f;
+            if (last_capture_us_ && now > last_capture_us_)
+                fps_ = fps_ * 0.9f + (1e6f / (now - last_capture_us_)) * 0.1f;
+            last_capture_us_ = now;
+            cv_.notify_all();
+        }
+    }
+
+    void FrameBroadcaster::pause()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        paused_ = true;
+        cv_.wait(lock, [&]
+                 { return !capturing_; });
+    }
+
+    void FrameBroadcaster::resume()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paused_ = false;
+        discard_ = 1;
+        cv_.notify_all();
+    }
+
+    int FrameBroadcaster::copyToSlot(const camera_fb_t *fb)
+    {
+        for (int i = 0; i < CONFIG_IOT_CAMERA_RING_DEPTH; ++i)
+        {
+            Slot &slot = slots_[i];
+            bool expected = false;
+            if (!slot.in_use.compare_exchange_strong(expected, true))
+                continue;
+            // slot libre : personne ne lit son buffer, il peut être agrandi
+            if (slot.capacity < fb->len)
+            {
+                size_t capacity = (fb->len + SLOT_GRANULE - 1) / SLOT_GRANULE * SLOT_GRANULE;
+                heap_caps_free(slot.buf);
+                slot.buf = static_cast<uint8_t *>(heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM));
+                slot.capacity = slot.buf ? capacity : 0;
+                if (!slot.buf)
+                {
+                    slot.in_use = false;
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    alloc_errors_++;
+                    return -1;
+                }
+            }
+            memcpy(slot.buf, fb->buf, fb->len);
+            return i;
+        }
+        return -1;
+    }
+
+    // Appelé par ~Frame, éventuellement sous mutex_ : atomique seulement
+    void FrameBroadcaster::releaseSlot(uint8_t slot)
+    {
+        if (slot < CONFIG_IOT_CAMERA_RING_DEPTH)
+            slots_[slot].in_use = false;
+    }
+
+    void FrameBroadcaster::recordSendLatency(int64_t us)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latency_us_ = latency_us_ == 0 ? us : latency_us_ * 0.9f + us * 0.1f;
+        if (us > latency_max_us_)
+            latency_max_us_ = us;
+    }
+
+    void FrameBroadcaster::stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cJSON_AddNumberToObject(obj, "subscribers", subscribers_);
+        cJSON_AddNumberToObject(obj, "captured", captured_);
+        cJSON_AddNumberToObject(obj, "capture_errors", capture_errors_);
+        cJSON_AddNumberToObject(obj, "discarded", discarded_);
+        cJSON_AddNumberToObject(obj, "delivered", delivered_);
+        cJSON_AddNumberToObject(obj, "skipped", skipped_);
+        cJSON_AddNumberToObject(obj, "fps", fps_);
+        cJSON_AddNumberToObject(obj, "snapshot_hits", snapshot_hits_);
+        cJSON_AddNumberToObject(obj, "snapshot_waits", snapshot_waits_);
+        cJSON_AddNumberToObject(obj, "snapshot_timeouts", snapshot_timeouts_);
+        cJSON_AddNumberToObject(obj, "ring_depth", CONFIG_IOT_CAMERA_RING_DEPTH);
+        cJSON_AddNumberToObject(obj, "ring_full", ring_full_);
+        cJSON_AddNumberToObject(obj, "alloc_errors", alloc_errors_);
+        cJSON_AddNumberToObject(obj, "fb_wait_us", fb_wait_us_);
+        cJSON_AddNumberToObject(obj, "fb_wait_max_us", (double)fb_wait_max_us_);
+        cJSON_AddNumberToObject(obj, "copy_us", copy_us_);
+        cJSON_AddNumberToObject(obj, "send_latency_us", latency_us_);
+        cJSON_AddNumberToObject(obj, "send_latency_max_us", (double)latency_max_us_);
+        jpeg_sizes_.to_json(cJSON_AddObjectToObject(obj, "jpeg"));
+    }
+
+    void FrameBroadcaster::resetStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fb_wait_max_us_ = 0;
+        latency_max_us_ = 0;
+        jpeg_sizes_ = {};
+    }
+}
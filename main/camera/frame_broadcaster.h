@@ -0,0 +1,134 @@
+#pragma once
+#ifndef __IOT_FRAME_BROADCASTER_H__
+#define __IOT_FRAME_BROADCASTER_H__
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "cJSON.h"
+#include "esp_camera.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "camera_stats.h"
+
+namespace camera
+{
+    // Image partagée entre les clients : copie dans un slot PSRAM de l'anneau,
+    // rendu à la capture avec la dernière référence
+    struct Frame
+    {
+        const uint8_t *data;
+        size_t len;
+        uint32_t seq;
+        int64_t captured_us;
+        uint8_t slot;
+
+        Frame(const uint8_t *data, size_t len, uint32_t seq, int64_t captured_us, uint8_t slot);
+        ~Frame();
+        // Instant de capture en temps réel (µs depuis epoch, SNTP)
+        int64_t wall_us() const;
+        Frame(const Frame &) = delete;
+        Frame &operator=(const Frame &) = delete;
+    };
+    using FramePtr = std::shared_ptr<const Frame>;
+
+    /**
+     * Une seule tâche capture, épinglée sur IOT_CAMERA_CAPTURE_CORE : chaque
+     * image est copiée dans un anneau de IOT_CAMERA_RING_DEPTH slots PSRAM et
+     * le buffer driver est rendu aussitôt. Les clients (flux MJPEG, snapshot,
+     * enregistrement...) lisent l'image la plus récente de l'anneau ; un envoi
+     * réseau bloqué ne retient plus de buffer driver et la cadence capteur ne
+     * dépend plus du réseau. Anneau plein (tous les slots retenus) : l'image
+     * est abandonnée, pas la capture.
+     * La capture ne tourne que tant qu'il y a au moins un abonné, ou pendant
+     * IOT_CAPTURE_WARM_S après le dernier snapshot (cache tenu chaud pour les
+     * NVR qui interrogent /iot/capture périodiquement).
+     */
+    class FrameBroadcaster
+    {
+    public:
+        static constexpr const char *TAG = "[FrameBroadcaster]";
+
+        static FrameBroadcaster &getInstance()
+        {
+            static FrameBroadcaster instance;
+            return instance;
+        }
+
+        void subscribe();
+        void unsubscribe();
+
+        // Image plus récente que last_seq ; nullptr après timeout
+        FramePtr waitNext(uint32_t last_seq, TickType_t timeout);
+        FramePtr latest();
+        // Image de moins de max_age_us, sinon attend la prochaine capture :
+        // les requêtes simultanées partagent la même image. nullptr après timeout
+        FramePtr snapshot(int64_t max_age_us, TickType_t timeout);
+
+        // Suspend la capture (retour une fois aucune capture en cours) ; la
+        // première image après resume() est jetée (reconfiguration capteur)
+        void pause();
+        void resume();
+
+        // Capture -> fin d'envoi, mesurée par les clients réseau
+        void recordSendLatency(int64_t us);
+        void releaseSlot(uint8_t slot);
+        void stats_to_json(cJSON *obj);
+        // Remet à zéro maxima et répartition des tailles (nouveau réglage à mesurer)
+        void resetStats();
+
+    private:
+        FrameBroadcaster() = default;
+        FrameBroadcaster(const FrameBroadcaster &) = delete;
+        FrameBroadcaster &operator=(const FrameBroadcaster &) = delete;
+
+        static void capture_task(void *arg);
+        void captureLoop();
+        void startTaskLocked();
+        // Copie fb dans un slot libre ; -1 si l'anneau est plein
+        int copyToSlot(const camera_fb_t *fb);
+
+        struct Slot
+        {
+            uint8_t *buf = nullptr;
+            size_t capacity = 0;
+            std::atomic<bool> in_use{false};
+        };
+        Slot slots_[CONFIG_IOT_CAMERA_RING_DEPTH];
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        TaskHandle_t task_ = nullptr;
+        FramePtr latest_;
+        uint32_t seq_ = 0;
+        uint32_t subscribers_ = 0;
+        int64_t warm_until_us_ = 0;
+        bool paused_ = false;
+        bool capturing_ = false;
+        uint8_t discard_ = 0;
+
+        uint32_t captured_ = 0;
+        uint32_t capture_errors_ = 0;
+        uint32_t discarded_ = 0; // jetées après reconfiguration
+        uint32_t delivered_ = 0;
+        uint32_t skipped_ = 0;
+        int64_t last_capture_us_ = 0;
+        float fps_ = 0; // moyenne glissante de la cadence capteur
+        uint32_t snapshot_hits_ = 0;
+        uint32_t snapshot_waits_ = 0;
+        uint32_t snapshot_timeouts_ = 0;
+        uint32_t ring_full_ = 0;
+        uint32_t alloc_errors_ = 0;
+        float copy_us_ = 0;
+        float fb_wait_us_ = 0; // attente dans esp_camera_fb_get
+        int64_t fb_wait_max_us_ = 0;
+        SizeHistogram jpeg_sizes_;
+        float latency_us_ = 0;
+        int64_t latency_max_us_ = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,235 @@
+#include "motion.h"
+#include <cstdlib>
+#include <cstring>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "frame_broadcaster.h"
+#include "motion_kernel.h"
+
+namespace camera
+{
+#ifdef CONFIG_IOT_MOTION_ENABLE
+    // bloc de 4x4 pixels décodés = 32x32 pixels capteur
+    static constexpr uint8_t BLOCK = 4;
+    static constexpr uint8_t REFERENCE_SHIFT = 2;
+    static constexpr int64_t HOLD_US = (int64_t)CONFIG_IOT_MOTION_HOLD_MS * 1000;
+
+    struct DecodeCtx
+    {
+        const uint8_t *jpg;
+        size_t len;
+        uint8_t *gray;
+        size_t capacity;
+        uint16_t width;
+        uint16_t height;
+    };
+
+    static size_t jpg_read(void *arg, size_t index, uint8_t *buf, size_t len)
+    {
+        auto *ctx = static_cast<DecodeCtx *>(arg);
+        if (index >= ctx->len)
+            return 0;
+        if (index + len > ctx->len)
+            len = ctx->len - index;
+        if (buf)
+            memcpy(buf, ctx->jpg + index, len);
+        return len;
+    }
+
+    // Appelé avec data == nullptr au début (dimensions de sortie) et à la fin
+    static bool jpg_write(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+    {
+        auto *ctx = static_cast<DecodeCtx *>(arg);
+        if (!data)
+        {
+            if (x == 0 && y == 0)
+            {
+                if ((size_t)w * h > ctx->capacity)
+                    return false;
+                ctx->width = w;
+                ctx->height = h;
+            }
+            return true;
+        }
+        // RGB888 -> gris ; poids symétriques, insensibles à l'ordre RGB/BGR
+        for (uint16_t row = 0; row < h; ++row)
+        {
+            if (y + row >= ctx->height)
+                break;
+            uint8_t *out = ctx->gray + (size_t)(y + row) * ctx->width + x;
+            const uint8_t *in = data + (size_t)row * w * 3;
+            for (uint16_t col = 0; col < w && x + col < ctx->width; ++col, in += 3)
+                out[col] = (uint8_t)((in[0] + 2 * in[1] + in[2]) >> 2);
+        }
+        return true;
+    }
+#endif
+
+    void MotionDetector::on_event(const Event *evt)
+    {
+#ifdef CONFIG_IOT_MOTION_ENABLE
+        auto &md = getInstance();
+        if (evt->type == EventType::CAMERA_INIT_DONE && !md.task_)
+            xTaskCreate(task, "cam_motion", 4096, &md, 2, &md.task_);
+#endif
+    }
+
+    void MotionDetector::task(void *arg)
+    {
+        static_cast<MotionDetector *>(arg)->loop();
+    }
+
+#ifdef CONFIG_IOT_MOTION_ENABLE
+    bool MotionDetector::decode(const uint8_t *jpg, size_t len)
+    {
+        // plus grande sortie 1/8 (QSXGA 2560x1920 -> 320x240)
+        static constexpr size_t CAPACITY = 320 * 240;
+        if (!gray_)
+        {
+            gray_ = static_cast<uint8_t *>(heap_caps_malloc(CAPACITY, MALLOC_CAP_SPIRAM));
+            ref_ = static_cast<uint8_t *>(heap_caps_malloc(CAPACITY, MALLOC_CAP_SPIRAM));
+            if (!gray_ || !ref_)
+            {
+                ESP_LOGE(TAG, "no memory for motion buffers");
+                free(gray_);
+                free(ref_);
+                gray_ = ref_ = nullptr;
+                return false;
+            }
+        }
+        DecodeCtx ctx = {jpg, len, gray_, CAPACITY, 0, 0};
+        if (esp_jpg_decode(len, JPG_SCALE_8X, jpg_read, jpg_write, &ctx) != ESP_OK || !ctx.width)
+            return false;
+        width_ = ctx.width;
+        height_ = ctx.height;
+        return true;
+    }
+
+    void MotionDetector::emit(bool active, uint16_t changed, uint16_t total)
+    {
+        camera_motion_t motion = {active, changed, total};
+        Event evt = {};
+        evt.type = EventType::CAMERA_MOTION;
+        memcpy(evt.data, &motion, sizeof(motion));
+        evt.data_len = sizeof(motion);
+        EventBus::getInstance().emit(evt);
+        ESP_LOGI(TAG, "motion %s (%u/%u blocks)", active ? "start" : "end", changed, total);
+    }
+
+    void MotionDetector::loop()
+    {
+        auto &broadcaster = FrameBroadcaster::getInstance();
+        while (true)
+        {
+            vTaskDelay(pdMS_TO_TICKS(interval_ms_));
+
+            // snapshot() garde la capture active entre deux passages
+            FramePtr frame = broadcaster.snapshot(CONFIG_IOT_CAPTURE_MAX_AGE_MS * 1000, pdMS_TO_TICKS(1000));
+            if (!frame)
+                continue;
+
+            int64_t start = esp_timer_get_time();
+            bool decoded = decode(frame->data, frame->len);
+            frame.reset();
+            if (!decoded)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                decode_errors_++;
+                continue;
+            }
+
+            // première image ou changement de résolution : nouvelle référence
+            if (width_ != ref_width_ || height_ != ref_height_)
+            {
+                memcpy(ref_, gray_, (size_t)width_ * height_);
+                ref_width_ = width_;
+                ref_height_ = height_;
+                continue;
+            }
+
+            motion::Result r = motion::diff(ref_, gray_, width_, height_, BLOCK, CONFIG_IOT_MOTION_THRESHOLD);
+            motion::update_reference(ref_, gray_, (size_t)width_ * height_, REFERENCE_SHIFT);
+            int64_t now = esp_timer_get_time();
+            float cost = (float)(now - start);
+
+            bool moving = r.changed_blocks >= CONFIG_IOT_MOTION_MIN_BLOCKS;
+            int transition = 0; // 1 début, -1 fin
+            uint16_t peak = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                runs_++;
+                last_changed_ = r.changed_blocks;
+                last_total_ = r.total_blocks;
+                luma_ = (int)(motion::mean_x16(gray_, (size_t)width_ * height_) >> 4);
+                cost_us_ = cost_us_ == 0 ? cost : cost_us_ * 0.9f + cost * 0.1f;
+
+                if (moving)
+                {
+                    last_motion_us_ = now;
+                    if (r.changed_blocks > peak_changed_)
+                        peak_changed_ = r.changed_blocks;
+                    if (!active_)
+                    {
+                        active_ = true;
+                        transition = 1;
+                    }
+                }
+                else if (active_ && now - last_motion_us_ >= HOLD_US)
+                {
+                    active_ = false;
+                    transition = -1;
+                    peak = peak_changed_;
+                    peak_changed_ = 0;
+                }
+                if (transition)
+                    events_++;
+
+                // budget CPU : coût / intervalle <= IOT_MOTION_CPU_PCT
+                uint32_t min_interval_ms = (uint32_t)(cost_us_ * 100 / CONFIG_IOT_MOTION_CPU_PCT / 1000);
+                interval_ms_ = min_interval_ms > CONFIG_IOT_MOTION_INTERVAL_MS ? min_interval_ms : CONFIG_IOT_MOTION_INTERVAL_MS;
+            }
+
+            if (transition > 0)
+                emit(true, r.changed_blocks, r.total_blocks);
+            else if (transition < 0)
+                emit(false, peak, r.total_blocks);
+        }
+    }
+#else
+    void MotionDetector::loop()
+    {
+        vTaskDelete(nullptr);
+    }
+#endif
+
+    bool MotionDetector::isActive()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return active_;
+    }
+
+    int MotionDetector::luma()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return luma_;
+    }
+
+    void MotionDetector::stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cJSON_AddBoolToObject(obj, "active", active_);
+        cJSON_AddNumberToObject(obj, "runs", runs_);
+        cJSON_AddNumberToObject(obj, "events", events_);
+        cJSON_AddNumberToObject(obj, "decode_errors", decode_errors_);
+        cJSON_AddNumberToObject(obj, "changed_blocks", last_changed_);
+        cJSON_AddNumberToObject(obj, "total_blocks", last_total_);
+        cJSON_AddNumberToObject(obj, "grid_w", width_);
+        cJSON_AddNumberToObject(obj, "grid_h", height_);
+        cJSON_AddNumberToObject(obj, "luma", luma_);
+        cJSON_AddNumberToObject(obj, "cost_us", cost_us_);
+        cJSON_AddNumberToObject(obj, "interval_ms", interval_ms_);
+        cJSON_AddNumberToObject(obj, "cpu_pct", interval_ms_ ? cost_us_ / 10.0f / interval_ms_ : 0);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#ifndef __IOT_MOTION_H__
+#define __IOT_MOTION_H__
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "cJSON.h"
+#include "event_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+namespace camera
+{
+    /**
+     * Détection de mouvement : toutes les IOT_MOTION_INTERVAL_MS, la dernière
+     * image est décodée à l'échelle 1/8 (coefficients DC uniquement, aucune
+     * IDCT) en niveaux de gris puis comparée par blocs à une référence
+     * glissante (motion_kernel.h).
+     *
+     * CAMERA_MOTION est émis au début du mouvement puis à la fin, après
+     * IOT_MOTION_HOLD_MS sans bloc changé. Si le coût dépasse IOT_MOTION_CPU_PCT
+     * d'un cœur, l'intervalle est allongé.
+     */
+    class MotionDetector
+    {
+    public:
+        static constexpr const char *TAG = "[Motion]";
+
+        static MotionDetector &getInstance()
+        {
+            static MotionDetector instance;
+            return instance;
+        }
+
+        bool isActive();
+        // Luminosité moyenne de la dernière image analysée (0-255), -1 si aucune
+        int luma();
+        void stats_to_json(cJSON *obj);
+
+        static void on_event(const Event *evt);
+        struct register_event_bus
+        {
+            register_event_bus()
+            {
+                EventBus::getInstance().subscribe(on_event, TAG);
+            }
+        };
+        inline static register_event_bus _register_event_bus;
+
+    private:
+        MotionDetector() = default;
+        MotionDetector(const MotionDetector &) = delete;
+        MotionDetector &operator=(const MotionDetector &) = delete;
+
+        static void task(void *arg);
+        void loop();
+        bool decode(const uint8_t *jpg, size_t len);
+        void emit(bool active, uint16_t changed, uint16_t total);
+
+        std::mutex mutex_;
+        TaskHandle_t task_ = nullptr;
+
+        // image décodée courante et référence (tâche de détection uniquement)
+        uint8_t *gray_ = nullptr;
+        uint8_t *ref_ = nullptr;
+        uint16_t width_ = 0;
+        uint16_t height_ = 0;
+        uint16_t ref_width_ = 0;
+        uint16_t ref_height_ = 0;
+
+        bool active_ = false;
+        int64_t last_motion_us_ = 0;
+        uint16_t peak_changed_ = 0;
+
+#ifdef CONFIG_IOT_MOTION_ENABLE
+        uint32_t interval_ms_ = CONFIG_IOT_MOTION_INTERVAL_MS;
+#else
+        uint32_t interval_ms_ = 0;
+#endif
+        uint32_t runs_ = 0;
+        uint32_t decode_errors_ = 0;
+        uint32_t events_ = 0;
+        uint16_t last_changed_ = 0;
+        uint16_t last_total_ = 0;
+        int luma_ = -1;
+        float cost_us_ = 0; // moyenne glissante décodage + noyau
+    };
+}
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef __IOT_MOTION_KERNEL_H__
+#define __IOT_MOTION_KERNEL_H__
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Noyau de détection de mouvement, sans dépendance ESP-IDF (compilable et
+ * testable sur l'hôte avec des images enregistrées).
+ *
+ * Entrée : deux images en niveaux de gris de même taille (ici la sortie DC du
+ * décodeur JPEG, 1 pixel par MCU 8x8). Arithmétique entière uniquement,
+ * boucle interne sur des lignes contiguës : vectorisable par le compilateur.
+ */
+namespace camera::motion
+{
+    struct Result
+    {
+        uint16_t changed_blocks;
+        uint16_t total_blocks;
+        uint32_t max_block_diff; // moyenne |diff| du bloc le plus changé, x16
+    };
+
+    // Moyenne des pixels (x16 pour garder 4 bits de fraction)
+    inline uint32_t mean_x16(const uint8_t *img, size_t pixels)
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < pixels; ++i)
+            sum += img[i];
+        return pixels ? (sum << 4) / pixels : 0;
+    }
+
+    /**
+     * Compare cur à ref par blocs de block x block pixels. Un bloc est changé
+     * si sa différence absolue moyenne, après compensation de la luminosité
+     * globale (auto-exposition), dépasse threshold (niveaux de gris).
+     */
+    inline Result diff(const uint8_t *ref, const uint8_t *cur, uint16_t width, uint16_t height,
+                       uint8_t block, uint8_t threshold)
+    {
+        Result r = {};
+        if (!block || width < block || height < block)
+            return r;
+        size_t pixels = (size_t)width * height;
+        // décalage global en x16, appliqué à cur
+        int32_t offset_x16 = (int32_t)mean_x16(ref, pixels) - (int32_t)mean_x16(cur, pixels);
+        const uint32_t limit_x16 = (uint32_t)threshold * block * block * 16;
+
+        for (uint16_t by = 0; by + block <= height; by += block)
+        {
+            for (uint16_t bx = 0; bx + block <= width; bx += block)
+            {
+                uint32_t sad_x16 = 0;
+                for (uint8_t y = 0; y < block; ++y)
+                {
+                    const uint8_t *a = ref + (size_t)(by + y) * width + bx;
+                    const uint8_t *b = cur + (size_t)(by + y) * width + bx;
+                    for (uint8_t x = 0; x < block; ++x)
+                    {
+                        int32_t d = ((int32_t)b[x] << 4) + offset_x16 - ((int32_t)a[x] << 4);
+                        sad_x16 += (uint32_t)(d < 0 ? -d : d);
+                    }
+                }
+                r.total_blocks++;
+                if (sad_x16 > limit_x16)
+                    r.changed_blocks++;
+                uint32_t avg = sad_x16 / (block * block);
+                if (avg > r.max_block_diff)
+                    r.max_block_diff = avg;
+            }
+        }
+        return r;
+    }
+
+    // Référence = moyenne glissante (poids 1/2^shift) : suit les changements lents de lumière
+    inline void update_reference(uint8_t *ref, const uint8_t *cur, size_t pixels, uint8_t shift)
+    {
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            int32_t d = (int32_t)cur[i] - ref[i];
+            // arrondi vers cur pour converger exactement
+            ref[i] = (uint8_t)(ref[i] + (d >= 0 ? (d + (1 << shift) - 1) >> shift : -((-d + (1 << shift) - 1) >> shift)));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,368 @@
+#include "presets.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "http_async.h"
+#include "macro.h"
+#include "persistence.h"
+#ifdef CONFIG_IOT_MOTION_ENABLE
+#include "motion.h"
+#endif
+#ifdef CONFIG_IOT_MQTT_RPC_ENABLE
+#include "MqttRpc.h"
+#endif
+
+#ifdef CONFIG_IOT_FEATURE_SD
+#define CAMERA_PRESETS_PATH "/sd/camera_presets.bin"
+#else
+#define CAMERA_PRESETS_PATH "/fs/camera_presets.bin"
+#endif
+
+using namespace camera_controller;
+namespace camera
+{
+#ifdef CONFIG_IOT_CAMERA_PRESET_CHECK_S
+    static constexpr TickType_t CHECK_PERIOD = pdMS_TO_TICKS(CONFIG_IOT_CAMERA_PRESET_CHECK_S * 1000);
+#endif
+    // mesures consécutives avant une bascule sur la luminosité (nuages, phares...)
+    static constexpr uint8_t LUMA_CONFIRM = 3;
+
+    void PresetManager::on_event(const Event *evt)
+    {
+#ifdef CONFIG_IOT_CAMERA_PRESET_CHECK_S
+        if (evt->type == EventType::CAMERA_INIT_DONE)
+            getInstance().start();
+#endif
+    }
+
+    void PresetManager::start()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (started_)
+                return;
+            started_ = true;
+            if (!persist::load_struct(CAMERA_PRESETS_PATH, &data_, sizeof(data_)) ||
+                data_.count > MAX_PRESETS || data_.rule_count > MAX_PRESET_RULES)
+                data_ = {};
+            ESP_LOGI(TAG, "%u presets, %u rules", data_.count, data_.rule_count);
+        }
+        registerRpc();
+        xTaskCreate(schedule_task, "cam_presets", 3072, this, 2, nullptr);
+    }
+
+    // mutex_ tenu
+    bool PresetManager::save()
+    {
+        persist::Batch batch;
+        batch.add(CAMERA_PRESETS_PATH, &data_, sizeof(data_));
+        return batch.commit();
+    }
+
+    // mutex_ tenu
+    int PresetManager::find(const char *name) const
+    {
+        for (int i = 0; i < data_.count; ++i)
+            if (strncmp(data_.presets[i].name, name, PRESET_NAME_LEN) == 0)
+                return i;
+        return -1;
+    }
+
+    // mutex_ tenu
+    bool PresetManager::applyIndex(int index, const char *reason)
+    {
+        int64_t start = esp_timer_get_time();
+        SettingsTransaction tx;
+        tx.setConfig(data_.presets[index].cfg);
+        bool ok = tx.commit();
+        last_apply_us_ = esp_timer_get_time() - start;
+        active_ = index;
+        switches_++;
+        ESP_LOGI(TAG, "preset %s (%s): %u writes, %u unchanged, %lld us", data_.presets[index].name, reason,
+                 tx.written(), tx.skipped(), (long long)last_apply_us_);
+        return ok;
+    }
+
+    bool PresetManager::apply(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int index = find(name);
+        return index >= 0 && applyIndex(index, "manual");
+    }
+
+    bool PresetManager::saveCurrent(const char *name)
+    {
+        if (!name || !name[0] || strlen(name) >= PRESET_NAME_LEN)
+            return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        int index = find(name);
+        if (index < 0)
+        {
+            if (data_.count >= MAX_PRESETS)
+                return false;
+            index = data_.count++;
+            memset(&data_.presets[index], 0, sizeof(data_.presets[index]));
+            strncpy(data_.presets[index].name, name, PRESET_NAME_LEN - 1);
+        }
+        CameraController::getInstance().extract_config(data_.presets[index].cfg);
+        active_ = index;
+        return save();
+    }
+
+    bool PresetManager::remove(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int index = find(name);
+        if (index < 0)
+            return false;
+        for (int i = index; i + 1 < data_.count; ++i)
+            data_.presets[i] = data_.presets[i + 1];
+        data_.count--;
+
+        // règles : supprimer celles du preset, renuméroter les suivantes
+        uint8_t kept = 0;
+        for (uint8_t i = 0; i < data_.rule_count; ++i)
+        {
+            camera_preset_rule_t rule = data_.rules[i];
+            if (rule.preset == index)
+                continue;
+            if (rule.preset > index)
+                rule.preset--;
+            data_.rules[kept++] = rule;
+        }
+        data_.rule_count = kept;
+        if (active_ == index)
+            active_ = -1;
+        else if (active_ > index)
+            active_--;
+        last_rule_ = -1;
+        return save();
+    }
+
+    bool PresetManager::setRules(const cJSON *rules)
+    {
+        if (!cJSON_IsArray(rules) || cJSON_GetArraySize(rules) > (int)MAX_PRESET_RULES)
+            return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        camera_preset_rule_t parsed[MAX_PRESET_RULES];
+        uint8_t count = 0;
+        const cJSON *item = nullptr;
+        cJSON_ArrayForEach(item, rules)
+        {
+            const cJSON *preset = cJSON_GetObjectItemCaseSensitive(item, "preset");
+            const cJSON *at = cJSON_GetObjectItemCaseSensitive(item, "at");
+            const cJSON *below = cJSON_GetObjectItemCaseSensitive(item, "luma_below");
+            const cJSON *above = cJSON_GetObjectItemCaseSensitive(item, "luma_above");
+            int index = cJSON_IsString(preset) ? find(preset->valuestring) : -1;
+            if (index < 0)
+                return false;
+            camera_preset_rule_t &rule = parsed[count++];
+            rule.preset = index;
+            unsigned h = 0, m = 0;
+            if (cJSON_IsString(at) && sscanf(at->valuestring, "%u:%u", &h, &m) == 2 && h < 24 && m < 60)
+            {
+                rule.kind = PresetRuleKind::AT_TIME;
+                rule.value = h * 60 + m;
+            }
+            else if (cJSON_IsNumber(below) && below->valueint >= 0 && below->valueint <= 255)
+            {
+                rule.kind = PresetRuleKind::LUMA_BELOW;
+                rule.value = below->valueint;
+            }
+            else if (cJSON_IsNumber(above) && above->valueint >= 0 && above->valueint <= 255)
+            {
+                rule.kind = PresetRuleKind::LUMA_ABOVE;
+                rule.value = above->valueint;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        memcpy(data_.rules, parsed, sizeof(parsed[0]) * count);
+        data_.rule_count = count;
+        last_rule_ = -1;
+        return save();
+    }
+
+    void PresetManager::schedule_task(void *arg)
+    {
+#ifdef CONFIG_IOT_CAMERA_PRESET_CHECK_S
+        auto *self = static_cast<PresetManager *>(arg);
+        while (true)
+        {
+            vTaskDelay(CHECK_PERIOD);
+            self->checkRules();
+        }
+#else
+        vTaskDelete(nullptr);
+#endif
+    }
+
+    void PresetManager::checkRules()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (data_.rule_count == 0)
+            return;
+
+        // heure : la règle la plus récente de la journée (celle de la veille avant la première)
+        int rule = -1;
+        time_t now = time(nullptr);
+        struct tm local;
+        localtime_r(&now, &local);
+        if (local.tm_year + 1900 >= 2020) // heure SNTP valide
+        {
+            int minute = local.tm_hour * 60 + local.tm_min;
+            int best = -1, latest = -1;
+            for (int i = 0; i < data_.rule_count; ++i)
+            {
+                const auto &r = data_.rules[i];
+                if (r.kind != PresetRuleKind::AT_TIME)
+                    continue;
+                if (r.value <= minute && (best < 0 || r.value > data_.rules[best].value))
+                    best = i;
+                if (latest < 0 || r.value > data_.rules[latest].value)
+                    latest = i;
+            }
+            rule = best >= 0 ? best : latest;
+        }
+
+        // luminosité : prioritaire sur l'heure, confirmée sur LUMA_CONFIRM mesures
+#ifdef CONFIG_IOT_MOTION_ENABLE
+        int luma = MotionDetector::getInstance().luma();
+        int luma_rule = -1;
+        for (int i = 0; luma >= 0 && i < data_.rule_count; ++i)
+        {
+            const auto &r = data_.rules[i];
+            if ((r.kind == PresetRuleKind::LUMA_BELOW && luma < r.value) ||
+                (r.kind == PresetRuleKind::LUMA_ABOVE && luma > r.value))
+            {
+                luma_rule = i;
+                break;
+            }
+        }
+        if (luma_rule >= 0)
+        {
+            if (luma_rule != last_rule_ && ++luma_hits_ < LUMA_CONFIRM)
+                return;
+            rule = luma_rule;
+        }
+        luma_hits_ = 0;
+#endif
+
+        if (rule < 0 || rule == last_rule_)
+            return;
+        last_rule_ = rule;
+        int preset = data_.rules[rule].preset;
+        if (preset != active_ && preset < data_.count)
+        {
+            scheduled_++;
+            applyIndex(preset, "schedule");
+        }
+    }
+
+    void PresetManager::to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cJSON_AddStringToObject(obj, "active", active_ >= 0 ? data_.presets[active_].name : "");
+        cJSON *names = cJSON_AddArrayToObject(obj, "presets");
+        for (int i = 0; i < data_.count; ++i)
+            cJSON_AddItemToArray(names, cJSON_CreateString(data_.presets[i].name));
+        cJSON *rules = cJSON_AddArrayToObject(obj, "rules");
+        for (int i = 0; i < data_.rule_count; ++i)
+        {
+            const auto &r = data_.rules[i];
+            cJSON *rule = cJSON_CreateObject();
+            cJSON_AddStringToObject(rule, "preset", data_.presets[r.preset].name);
+            if (r.kind == PresetRuleKind::AT_TIME)
+            {
+                char at[6];
+                snprintf(at, sizeof(at), "%02u:%02u", r.value / 60, r.value % 60);
+                cJSON_AddStringToObject(rule, "at", at);
+            }
+            else
+            {
+                cJSON_AddNumberToObject(rule, r.kind == PresetRuleKind::LUMA_BELOW ? "luma_below" : "luma_above", r.value);
+            }
+            cJSON_AddItemToArray(rules, rule);
+        }
+        cJSON_AddNumberToObject(obj, "switches", switches_);
+        cJSON_AddNumberToObject(obj, "scheduled", scheduled_);
+        cJSON_AddNumberToObject(obj, "last_apply_us", (double)last_apply_us_);
+    }
+
+    void PresetManager::registerRpc()
+    {
+#ifdef CONFIG_IOT_MQTT_RPC_ENABLE
+        auto &rpc = MqttRpc::getInstance();
+        rpc.registerMethod("camera.preset.list", [this](const cJSON *, cJSON *result)
+                           { to_json(result); return ESP_OK; });
+        rpc.registerMethod("camera.preset.apply", [this](const cJSON *params, cJSON *result)
+                           {
+                               const cJSON *name = cJSON_GetObjectItemCaseSensitive(params, "name");
+                               if (!cJSON_IsString(name))
+                                   return ESP_ERR_INVALID_ARG;
+                               if (!apply(name->valuestring))
+                                   return ESP_ERR_NOT_FOUND;
+                               cJSON_AddStringToObject(result, "active", name->valuestring);
+                               return ESP_OK; });
+        rpc.registerMethod("camera.preset.save", [this](const cJSON *params, cJSON *result)
+                           {
+                               const cJSON *name = cJSON_GetObjectItemCaseSensitive(params, "name");
+                               if (!cJSON_IsString(name))
+                                   return ESP_ERR_INVALID_ARG;
+                               return saveCurrent(name->valuestring) ? ESP_OK : ESP_FAIL; });
+#endif
+    }
+
+    esp_err_t PresetManager::get_handler(httpd_req_t *req)
+    {
+        cJSON *root = cJSON_CreateObject();
+        getInstance().to_json(root);
+        char *json = cJSON_PrintUnformatted(root);
+        cJSON_Delete(root);
+        if (!json)
+            return httpd_resp_send_500(req);
+        SET_RESP_HEADERS(req);
+        esp_err_t err = httpd_resp_send(req, json, strlen(json));
+        cJSON_free(json);
+        return err;
+    }
+
+    // Application et écriture du fichier hors de la tâche httpd
+    esp_err_t PresetManager::post_handler(httpd_req_t *req)
+    {
+        HTTP_RUN_ASYNC(req, post_handler);
+        HTTP_RECV_BODY_OR_FAIL(req, body, TAG, "body failed");
+
+        cJSON *root = cJSON_ParseWithLength(body.data(), body.size());
+        if (!root)
+        {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "invalid JSON");
+            return ESP_FAIL;
+        }
+        auto &pm = getInstance();
+        const cJSON *item = nullptr;
+        bool ok = true;
+        if ((item = cJSON_GetObjectItemCaseSensitive(root, "save")) && cJSON_IsString(item))
+            ok = pm.saveCurrent(item->valuestring);
+        else if ((item = cJSON_GetObjectItemCaseSensitive(root, "delete")) && cJSON_IsString(item))
+            ok = pm.remove(item->valuestring);
+        else if ((item = cJSON_GetObjectItemCaseSensitive(root, "rules")))
+            ok = pm.setRules(item);
+        else if ((item = cJSON_GetObjectItemCaseSensitive(root, "apply")) && cJSON_IsString(item))
+            ok = pm.apply(item->valuestring);
+        else
+            ok = false;
+        cJSON_Delete(root);
+
+        if (!ok)
+        {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown preset or invalid request");
+            return ESP_FAIL;
+        }
+        return get_handler(req);
+    }
+}
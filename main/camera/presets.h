@@ -0,0 +1,116 @@
+#pragma once
+#ifndef __IOT_CAMERA_PRESETS_H__
+#define __IOT_CAMERA_PRESETS_H__
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "cJSON.h"
+#include "esp_http_server.h"
+#include "event_bus.h"
+#include "camera_controller.h"
+
+namespace camera
+{
+    static constexpr size_t PRESET_NAME_LEN = 16;
+    static constexpr size_t MAX_PRESETS = 8;
+    static constexpr size_t MAX_PRESET_RULES = 8;
+
+    struct camera_preset_t
+    {
+        char name[PRESET_NAME_LEN];
+        camera_controller::camera_config_persist cfg;
+    };
+
+    enum class PresetRuleKind : uint8_t
+    {
+        AT_TIME,    // à partir de value = minute du jour (heure locale)
+        LUMA_BELOW, // luminosité d'image < value
+        LUMA_ABOVE, // luminosité d'image > value
+    };
+
+    struct camera_preset_rule_t
+    {
+        uint8_t preset;
+        PresetRuleKind kind;
+        uint16_t value;
+    };
+
+    struct camera_presets_persist
+    {
+        uint8_t count;
+        uint8_t rule_count;
+        camera_preset_t presets[MAX_PRESETS];
+        camera_preset_rule_t rules[MAX_PRESET_RULES];
+    };
+
+    /**
+     * Profils caméra nommés (jour, nuit...) : un seul fichier, chargé en RAM
+     * au démarrage sous forme de camera_config_persist. Changer de profil ne
+     * relit ni ne parse rien : une SettingsTransaction n'écrit que les
+     * registres qui diffèrent.
+     *
+     * Bascule par /iot/camera/presets, RPC MQTT (camera.preset.*) ou règles :
+     * heure de la journée, ou luminosité d'image mesurée par la détection de
+     * mouvement (pas de capteur de lux sur la carte). Une règle ne s'applique
+     * qu'à son déclenchement : un choix manuel tient jusqu'à la règle suivante.
+     */
+    class PresetManager
+    {
+    public:
+        static constexpr const char *TAG = "[Presets]";
+
+        static PresetManager &getInstance()
+        {
+            static PresetManager instance;
+            return instance;
+        }
+
+        bool apply(const char *name);
+        // Enregistre l'état courant du capteur sous ce nom (crée ou remplace)
+        bool saveCurrent(const char *name);
+        bool remove(const char *name);
+        // Remplace les règles : [{"preset":"night","at":"19:30"}, {"preset":"day","luma_above":90}]
+        bool setRules(const cJSON *rules);
+        void to_json(cJSON *obj);
+
+        static esp_err_t get_handler(httpd_req_t *req);
+        // {"apply":name} | {"save":name} | {"delete":name} | {"rules":[...]}
+        static esp_err_t post_handler(httpd_req_t *req);
+
+        static void on_event(const Event *evt);
+        struct register_event_bus
+        {
+            register_event_bus()
+            {
+                EventBus::getInstance().subscribe(on_event, TAG);
+            }
+        };
+        inline static register_event_bus _register_event_bus;
+
+    private:
+        PresetManager() = default;
+        PresetManager(const PresetManager &) = delete;
+        PresetManager &operator=(const PresetManager &) = delete;
+
+        void start();
+        bool save();
+        int find(const char *name) const;
+        bool applyIndex(int index, const char *reason);
+        void registerRpc();
+        static void schedule_task(void *arg);
+        void checkRules();
+
+        std::mutex mutex_;
+        bool started_ = false;
+        camera_presets_persist data_ = {};
+        int active_ = -1;
+        int last_rule_ = -1; // dernière règle déclenchée
+        uint8_t luma_hits_ = 0;
+
+        uint32_t switches_ = 0;
+        uint32_t scheduled_ = 0;
+        int64_t last_apply_us_ = 0;
+    };
+}
+
+#endif
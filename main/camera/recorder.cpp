@@ -0,0 +1,631 @@
+#include "recorder.h"
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "frame_broadcaster.h"
+#include "http_async.h"
+#include "json_stream.h"
+#include "macro.h"
+
+namespace camera
+{
+#ifdef CONFIG_IOT_REC_ENABLE
+    static constexpr size_t BLOCK_SIZE = CONFIG_IOT_REC_BUFFER_KB * 1024;
+    static constexpr uint32_t SEGMENT_MAX = (uint32_t)CONFIG_IOT_REC_SEGMENT_MB * 1024 * 1024;
+    static constexpr int64_t SYNC_US = (int64_t)CONFIG_IOT_REC_SYNC_S * 1000 * 1000;
+    static constexpr int64_t TIMELAPSE_US = (int64_t)CONFIG_IOT_REC_TIMELAPSE_S * 1000 * 1000;
+    static constexpr TickType_t TRIGGER_INTERVAL = pdMS_TO_TICKS(1000 / CONFIG_IOT_REC_TRIGGER_FPS);
+    static_assert(BLOCK_SIZE % 512 == 0, "recorder writes must be sector-aligned");
+    // avant 2020 : horloge pas encore réglée par SNTP
+    static constexpr int64_t CLOCK_VALID_US = 1577836800LL * 1000 * 1000;
+    // écart toléré entre temps réel et esp_timer d'une image à l'autre
+    static constexpr int64_t CLOCK_JUMP_US = 1000 * 1000;
+#endif
+    static constexpr const char *CATALOG = "/sd/rec/catalog.idx";
+    static constexpr size_t EXPORT_CHUNK = 4096;
+    static constexpr uint32_t EXPORT_MAX_FRAMES = 1000;
+
+    static void segment_path(char *out, size_t len, uint32_t id, const char *ext)
+    {
+        snprintf(out, len, "%s/%08" PRIu32 ".%s", Recorder::DIR, id, ext);
+    }
+
+    static bool read_at(int fd, uint32_t offset, void *out, size_t len)
+    {
+        if (lseek(fd, offset, SEEK_SET) < 0)
+            return false;
+        uint8_t *p = static_cast<uint8_t *>(out);
+        while (len > 0)
+        {
+            ssize_t n = read(fd, p, len);
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static bool write_at(int fd, uint32_t offset, const void *data, size_t len)
+    {
+        if (lseek(fd, offset, SEEK_SET) < 0)
+            return false;
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        while (len > 0)
+        {
+            ssize_t n = write(fd, p, len);
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static uint32_t file_size(int fd)
+    {
+        struct stat st;
+        return fstat(fd, &st) == 0 ? (uint32_t)st.st_size : 0;
+    }
+
+    void Recorder::on_event(const Event *evt)
+    {
+#ifdef CONFIG_IOT_REC_ENABLE
+        auto &rec = getInstance();
+        if (evt->type == EventType::SD_READY)
+            rec.sd_ready_ = true;
+        else if (evt->type == EventType::CAMERA_INIT_DONE)
+            rec.camera_ready_ = true;
+#ifdef CONFIG_IOT_REC_ON_MOTION
+        else if (evt->type == EventType::CAMERA_MOTION && evt->data_len == sizeof(camera_motion_t))
+        {
+            rec.setMotion(reinterpret_cast<const camera_motion_t *>(evt->data)->active);
+            return;
+        }
+#endif
+        else
+            return;
+        if (rec.sd_ready_ && rec.camera_ready_ && !rec.task_)
+            xTaskCreate(task, "cam_rec", 4096, &rec, 3, &rec.task_);
+#endif
+    }
+
+    void Recorder::trigger(uint32_t duration_ms)
+    {
+        int64_t until = esp_timer_get_time() + (int64_t)duration_ms * 1000;
+        TaskHandle_t task = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (until > trigger_until_us_)
+                trigger_until_us_ = until;
+            task = task_;
+        }
+        if (task)
+            xTaskNotifyGive(task);
+    }
+
+    void Recorder::setMotion(bool active)
+    {
+        TaskHandle_t task = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // fin du mouvement : le détecteur a déjà attendu IOT_MOTION_HOLD_MS
+            trigger_until_us_ = active ? INT64_MAX : esp_timer_get_time();
+            task = task_;
+        }
+        if (task)
+            xTaskNotifyGive(task);
+    }
+
+    bool Recorder::isTriggered()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return esp_timer_get_time() < trigger_until_us_;
+    }
+
+    void Recorder::task(void *arg)
+    {
+        static_cast<Recorder *>(arg)->loop();
+    }
+
+#ifdef CONFIG_IOT_REC_ENABLE
+    void Recorder::loop()
+    {
+        if (!start())
+        {
+            ESP_LOGE(TAG, "recorder disabled");
+            vTaskDelete(nullptr);
+            return;
+        }
+
+        auto &broadcaster = FrameBroadcaster::getInstance();
+        bool subscribed = false;
+        uint32_t last_seq = 0;
+        int64_t next_timelapse = esp_timer_get_time();
+        int64_t next_sync = esp_timer_get_time() + SYNC_US;
+
+        while (true)
+        {
+            FramePtr frame;
+            if (isTriggered())
+            {
+                if (!subscribed)
+                {
+                    broadcaster.subscribe();
+                    subscribed = true;
+                }
+                frame = broadcaster.waitNext(last_seq, pdMS_TO_TICKS(1000));
+            }
+            else
+            {
+                if (subscribed)
+                {
+                    broadcaster.unsubscribe();
+                    subscribed = false;
+                }
+                if (TIMELAPSE_US > 0 && esp_timer_get_time() >= next_timelapse)
+                {
+                    frame = broadcaster.snapshot(CONFIG_IOT_CAPTURE_MAX_AGE_MS * 1000, pdMS_TO_TICKS(2000));
+                    next_timelapse += TIMELAPSE_US;
+                    if (next_timelapse < esp_timer_get_time())
+                        next_timelapse = esp_timer_get_time() + TIMELAPSE_US;
+                }
+            }
+
+            if (frame)
+            {
+                last_seq = frame->seq;
+                int64_t ts = frame->wall_us();
+                if (ts < CLOCK_VALID_US)
+                    unsynced_++;
+                else if (!append(frame->data, frame->len, ts, frame->captured_us))
+                    dropped_++;
+            }
+            frame.reset();
+
+            // données partielles rendues lisibles (et survivant à une coupure) périodiquement
+            if (data_fd_ >= 0 && esp_timer_get_time() >= next_sync)
+            {
+                if (!flushData(true) || !flushIndex())
+                    write_errors_++;
+                fsync(data_fd_);
+                fsync(index_fd_);
+                next_sync = esp_timer_get_time() + SYNC_US;
+            }
+
+            if (subscribed)
+            {
+                vTaskDelay(TRIGGER_INTERVAL);
+            }
+            else
+            {
+                // réveillé par trigger() ou à la prochaine échéance
+                int64_t wait_us = TIMELAPSE_US > 0 ? next_timelapse - esp_timer_get_time() : SYNC_US;
+                if (wait_us > SYNC_US)
+                    wait_us = SYNC_US;
+                TickType_t ticks = wait_us > 0 ? pdMS_TO_TICKS(wait_us / 1000) : 0;
+                ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+            }
+        }
+    }
+
+    bool Recorder::start()
+    {
+        buffer_ = static_cast<uint8_t *>(heap_caps_malloc(BLOCK_SIZE, MALLOC_CAP_SPIRAM));
+        if (!buffer_)
+            buffer_ = static_cast<uint8_t *>(malloc(BLOCK_SIZE));
+        if (!buffer_)
+        {
+            ESP_LOGE(TAG, "no memory for %u byte write buffer", (unsigned)BLOCK_SIZE);
+            return false;
+        }
+        if (mkdir(DIR, 0775) != 0 && errno != EEXIST)
+        {
+            ESP_LOGE(TAG, "mkdir %s failed (%d)", DIR, errno);
+            return false;
+        }
+        recover();
+        ESP_LOGI(TAG, "recording to %s, next segment %" PRIu32, DIR, next_id_);
+        return true;
+    }
+
+    // Relit le catalogue ; un segment non fermé (coupure) y est ajouté depuis son index
+    void Recorder::recover()
+    {
+        int fd = open(CATALOG, O_RDONLY);
+        if (fd >= 0)
+        {
+            uint32_t count = file_size(fd) / sizeof(rec_segment_t);
+            rec_segment_t last;
+            if (count > 0 && read_at(fd, (count - 1) * sizeof(rec_segment_t), &last, sizeof(last)))
+                next_id_ = last.id + 1;
+            close(fd);
+        }
+
+        char path[32];
+        segment_path(path, sizeof(path), next_id_, "idx");
+        int idx = open(path, O_RDONLY);
+        if (idx < 0)
+            return;
+        rec_segment_t seg = {next_id_, file_size(idx) / (uint32_t)sizeof(rec_index_t), 0, 0};
+        rec_index_t first, last;
+        if (seg.frames > 0 &&
+            read_at(idx, 0, &first, sizeof(first)) &&
+            read_at(idx, (seg.frames - 1) * sizeof(rec_index_t), &last, sizeof(last)))
+        {
+            seg.start_us = first.ts_us;
+            seg.end_us = last.ts_us;
+            int cat = open(CATALOG, O_WRONLY | O_CREAT | O_APPEND, 0664);
+            if (cat >= 0)
+            {
+                write(cat, &seg, sizeof(seg));
+                fsync(cat);
+                close(cat);
+            }
+            ESP_LOGW(TAG, "recovered unclosed segment %" PRIu32 " (%" PRIu32 " frames)", seg.id, seg.frames);
+        }
+        close(idx);
+        next_id_++;
+    }
+
+    bool Recorder::openSegment(int64_t ts_us)
+    {
+        char path[32];
+        segment_path(path, sizeof(path), next_id_, "mjp");
+        data_fd_ = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+        segment_path(path, sizeof(path), next_id_, "idx");
+        index_fd_ = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+        if (data_fd_ < 0 || index_fd_ < 0)
+        {
+            ESP_LOGE(TAG, "cannot open segment %" PRIu32, next_id_);
+            if (data_fd_ >= 0)
+                close(data_fd_);
+            if (index_fd_ >= 0)
+                close(index_fd_);
+            data_fd_ = index_fd_ = -1;
+            return false;
+        }
+        buffered_ = 0;
+        file_offset_ = 0;
+        index_buffered_ = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_ = {next_id_++, 0, ts_us, ts_us};
+        flushed_frames_ = 0;
+        return true;
+    }
+
+    void Recorder::closeSegment()
+    {
+        if (data_fd_ < 0)
+            return;
+        if (!flushData(true) || !flushIndex())
+            write_errors_++;
+        fsync(data_fd_);
+        fsync(index_fd_);
+        close(data_fd_);
+        close(index_fd_);
+        data_fd_ = index_fd_ = -1;
+
+        rec_segment_t seg;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            seg = current_;
+            current_ = {};
+            flushed_frames_ = 0;
+        }
+        if (seg.frames == 0)
+            return;
+        int cat = open(CATALOG, O_WRONLY | O_CREAT | O_APPEND, 0664);
+        if (cat < 0 || write(cat, &seg, sizeof(seg)) != sizeof(seg))
+            write_errors_++;
+        if (cat >= 0)
+        {
+            fsync(cat);
+            close(cat);
+        }
+        segments_++;
+    }
+
+    bool Recorder::append(const uint8_t *data, size_t len, int64_t ts_us, int64_t mono_us)
+    {
+        if (data_fd_ >= 0 && (uint64_t)file_offset_ + buffered_ + len > SEGMENT_MAX)
+            closeSegment();
+        // horloge recalée (SNTP, réglage manuel) : l'index doit rester trié pour lower_bound()
+        if (data_fd_ >= 0)
+        {
+            int64_t drift = (ts_us - current_.end_us) - (mono_us - last_mono_us_);
+            if (ts_us < current_.end_us || drift > CLOCK_JUMP_US || drift < -CLOCK_JUMP_US)
+            {
+                ESP_LOGW(TAG, "clock moved by %lld ms, new segment", (long long)(drift / 1000));
+                clock_jumps_++;
+                closeSegment();
+            }
+        }
+        if (data_fd_ < 0 && !openSegment(ts_us))
+            return false;
+
+        rec_index_t entry = {ts_us, file_offset_ + (uint32_t)buffered_, (uint32_t)len};
+        while (len > 0)
+        {
+            size_t n = BLOCK_SIZE - buffered_;
+            if (n > len)
+                n = len;
+            memcpy(buffer_ + buffered_, data, n);
+            buffered_ += n;
+            data += n;
+            len -= n;
+            if (buffered_ == BLOCK_SIZE && !flushData(false))
+            {
+                write_errors_++;
+                closeSegment();
+                return false;
+            }
+        }
+
+        index_buf_[index_buffered_++] = entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            current_.frames++;
+            current_.end_us = ts_us;
+        }
+        last_mono_us_ = mono_us;
+        frames_++;
+        bytes_ += entry.size;
+        if (index_buffered_ == sizeof(index_buf_) / sizeof(index_buf_[0]) && !flushIndex())
+            write_errors_++;
+        return true;
+    }
+
+    /**
+     * Chaque écriture commence sur une frontière de bloc : un bloc plein est
+     * écrit puis on avance ; un bloc partiel (sync, fermeture) est écrit à la
+     * même position et sera réécrit complet au prochain flush.
+     */
+    bool Recorder::flushData(bool partial)
+    {
+        if (buffered_ == 0)
+            return true;
+        if (!partial && buffered_ < BLOCK_SIZE)
+            return true;
+        int64_t start = esp_timer_get_time();
+        bool ok = write_at(data_fd_, file_offset_, buffer_, buffered_);
+        flush_us_ += esp_timer_get_time() - start;
+        flushes_++;
+        if (ok && buffered_ == BLOCK_SIZE)
+        {
+            file_offset_ += BLOCK_SIZE;
+            buffered_ = 0;
+        }
+        return ok;
+    }
+
+    bool Recorder::flushIndex()
+    {
+        if (index_buffered_ == 0)
+            return true;
+        size_t len = index_buffered_ * sizeof(rec_index_t);
+        bool ok = lseek(index_fd_, 0, SEEK_END) >= 0 && write(index_fd_, index_buf_, len) == (ssize_t)len;
+        if (ok)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flushed_frames_ += index_buffered_;
+        }
+        index_buffered_ = 0;
+        return ok;
+    }
+#else
+    void Recorder::loop()
+    {
+        vTaskDelete(nullptr);
+    }
+#endif
+
+    bool Recorder::currentSegment(rec_segment_t *seg)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (current_.id == 0)
+            return false;
+        *seg = current_;
+        seg->frames = flushed_frames_;
+        return true;
+    }
+
+    void Recorder::stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cJSON_AddBoolToObject(obj, "running", task_ != nullptr);
+        cJSON_AddBoolToObject(obj, "triggered", esp_timer_get_time() < trigger_until_us_);
+        cJSON_AddNumberToObject(obj, "frames", frames_);
+        cJSON_AddNumberToObject(obj, "dropped", dropped_);
+        cJSON_AddNumberToObject(obj, "unsynced", unsynced_);
+        cJSON_AddNumberToObject(obj, "clock_jumps", clock_jumps_);
+        cJSON_AddNumberToObject(obj, "bytes", (double)bytes_);
+        cJSON_AddNumberToObject(obj, "segments_closed", segments_);
+        cJSON_AddNumberToObject(obj, "write_errors", write_errors_);
+        cJSON_AddNumberToObject(obj, "flushes", flushes_);
+        cJSON_AddNumberToObject(obj, "flush_avg_ms", flushes_ ? flush_us_ / 1000.0 / flushes_ : 0);
+        cJSON_AddNumberToObject(obj, "segment", current_.id);
+        cJSON_AddNumberToObject(obj, "segment_frames", current_.frames);
+    }
+
+    static void segment_to_json(JsonStream &w, const rec_segment_t &seg)
+    {
+        w.beginObject();
+        w.number("id", seg.id);
+        w.number("frames", seg.frames);
+        w.number("start", seg.start_us / 1e6);
+        w.number("end", seg.end_us / 1e6);
+        w.endObject();
+    }
+
+    // Flux JSON : les segments sont lus du catalogue sans le charger en mémoire
+    esp_err_t Recorder::list_handler(httpd_req_t *req)
+    {
+        HTTP_RUN_ASYNC(req, list_handler);
+
+        // ?last=N : les N derniers segments (50 par défaut)
+        uint32_t last = 50;
+        char query[32], value[12];
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "last", value, sizeof(value)) == ESP_OK)
+            last = strtoul(value, nullptr, 10);
+
+        cJSON *stats = cJSON_CreateObject();
+        getInstance().stats_to_json(stats);
+        char *stats_str = cJSON_PrintUnformatted(stats);
+        cJSON_Delete(stats);
+
+        SET_RESP_HEADERS(req);
+        JsonStream w(req);
+        w.beginObject();
+        if (stats_str)
+        {
+            w.raw("stats", stats_str, strlen(stats_str));
+            cJSON_free(stats_str);
+        }
+        w.beginArray("segments");
+        int fd = open(CATALOG, O_RDONLY);
+        if (fd >= 0)
+        {
+            uint32_t count = file_size(fd) / sizeof(rec_segment_t);
+            uint32_t first = count > last ? count - last : 0;
+            rec_segment_t seg;
+            for (uint32_t i = first; i < count && read_at(fd, i * sizeof(seg), &seg, sizeof(seg)); ++i)
+                segment_to_json(w, seg);
+            close(fd);
+        }
+        rec_segment_t current;
+        if (getInstance().currentSegment(&current))
+            segment_to_json(w, current);
+        w.endArray();
+        w.endObject();
+        return w.finish();
+    }
+
+    // Première entrée de l'index avec ts >= from_us (recherche dichotomique, index trié par segment)
+    static uint32_t lower_bound(int idx_fd, uint32_t count, int64_t from_us)
+    {
+        uint32_t lo = 0, hi = count;
+        while (lo < hi)
+        {
+            uint32_t mid = lo + (hi - lo) / 2;
+            rec_index_t entry;
+            if (!read_at(idx_fd, mid * sizeof(entry), &entry, sizeof(entry)))
+                return count;
+            if (entry.ts_us < from_us)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    // Envoie les images du segment dans [from_us, to_us] ; false si le client est parti
+    static bool export_segment(httpd_req_t *req, const rec_segment_t &seg, int64_t from_us, int64_t to_us,
+                               uint8_t *buf, uint32_t *sent)
+    {
+        char path[32];
+        segment_path(path, sizeof(path), seg.id, "idx");
+        int idx = open(path, O_RDONLY);
+        segment_path(path, sizeof(path), seg.id, "mjp");
+        int data = open(path, O_RDONLY);
+        bool ok = true;
+        if (idx >= 0 && data >= 0)
+        {
+            uint32_t count = file_size(idx) / sizeof(rec_index_t);
+            if (count > seg.frames)
+                count = seg.frames;
+            uint32_t data_size = file_size(data);
+            rec_index_t entry;
+            for (uint32_t i = lower_bound(idx, count, from_us);
+                 ok && i < count && *sent < EXPORT_MAX_FRAMES && read_at(idx, i * sizeof(entry), &entry, sizeof(entry)); ++i)
+            {
+                if (entry.ts_us > to_us)
+                    break;
+                // index en avance sur les données (coupure) : fin du segment
+                if ((uint64_t)entry.offset + entry.size > data_size)
+                    break;
+                char header[128];
+                int len = snprintf(header, sizeof(header),
+                                   "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %" PRIu32 "\r\nX-Timestamp: %lld.%06lld\r\n\r\n",
+                                   entry.size, (long long)(entry.ts_us / 1000000), (long long)(entry.ts_us % 1000000));
+                ok = httpd_resp_send_chunk(req, header, len) == ESP_OK;
+                for (uint32_t done = 0; ok && done < entry.size;)
+                {
+                    size_t n = entry.size - done < EXPORT_CHUNK ? entry.size - done : EXPORT_CHUNK;
+                    ok = read_at(data, entry.offset + done, buf, n) &&
+                         httpd_resp_send_chunk(req, reinterpret_cast<const char *>(buf), n) == ESP_OK;
+                    done += n;
+                }
+                ok = ok && httpd_resp_send_chunk(req, "\r\n", 2) == ESP_OK;
+                (*sent)++;
+            }
+        }
+        if (idx >= 0)
+            close(idx);
+        if (data >= 0)
+            close(data);
+        return ok;
+    }
+
+    // multipart/x-mixed-replace : lisible tel quel par un navigateur ou ffmpeg
+    esp_err_t Recorder::export_handler(httpd_req_t *req)
+    {
+        HTTP_RUN_ASYNC(req, export_handler);
+
+        char query[64], value[24];
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+            httpd_query_key_value(query, "from", value, sizeof(value)) != ESP_OK)
+        {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "from=<epoch s>[&to=<epoch s>]");
+            return ESP_FAIL;
+        }
+        int64_t from_us = (int64_t)(strtod(value, nullptr) * 1e6);
+        int64_t to_us = INT64_MAX;
+        if (httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK)
+            to_us = (int64_t)(strtod(value, nullptr) * 1e6);
+
+        uint8_t *buf = static_cast<uint8_t *>(malloc(EXPORT_CHUNK));
+        if (!buf)
+            return httpd_resp_send_500(req);
+
+        SET_CORS_HEADERS(req);
+        httpd_resp_set_type(req, "multipart/x-mixed-replace; boundary=frame");
+        uint32_t sent = 0;
+        bool ok = true;
+        int cat = open(CATALOG, O_RDONLY);
+        if (cat >= 0)
+        {
+            uint32_t count = file_size(cat) / sizeof(rec_segment_t);
+            rec_segment_t seg;
+            for (uint32_t i = 0; ok && i < count && read_at(cat, i * sizeof(seg), &seg, sizeof(seg)); ++i)
+            {
+                if (seg.end_us < from_us)
+                    continue;
+                // pas de break : chaque segment est trié, mais un recalage d'horloge
+                // ouvre un segment dont les dates peuvent précéder les précédents
+                if (seg.start_us > to_us)
+                    continue;
+                ok = export_segment(req, seg, from_us, to_us, buf, &sent);
+            }
+            close(cat);
+        }
+        rec_segment_t current;
+        if (ok && getInstance().currentSegment(&current) && current.start_us <= to_us)
+            ok = export_segment(req, current, from_us, to_us, buf, &sent);
+        free(buf);
+
+        ESP_LOGI(TAG, "export: %" PRIu32 " frames", sent);
+        if (!ok)
+            return ESP_FAIL;
+        return httpd_resp_send_chunk(req, nullptr, 0);
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#ifndef __IOT_RECORDER_H__
+#define __IOT_RECORDER_H__
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "cJSON.h"
+#include "esp_http_server.h"
+#include "event_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+/**
+ * Enregistrement des images sur la carte SD (time-lapse et déclenchement).
+ *
+ * Pas un fichier JPEG par image : chaque segment est un couple
+ *   /sd/rec/NNNNNNNN.mjp  JPEG concaténés, écrits par blocs alignés de IOT_REC_BUFFER_KB
+ *   /sd/rec/NNNNNNNN.idx  rec_index_t (horodatage, offset, taille) à taille fixe
+ * et /sd/rec/catalog.idx liste les segments fermés (rec_segment_t).
+ *
+ * Un export par plage horaire lit le catalogue, puis fait une recherche
+ * dichotomique dans l'index du segment : aucun parcours de répertoire.
+ * Rien n'est enregistré avant la mise à l'heure (SNTP) et un recalage de
+ * l'horloge ferme le segment : les horodatages d'un segment sont croissants.
+ */
+namespace camera
+{
+    struct rec_index_t
+    {
+        int64_t ts_us; // temps réel, µs depuis epoch
+        uint32_t offset;
+        uint32_t size;
+    };
+    static_assert(sizeof(rec_index_t) == 16, "rec_index_t is an on-disk format");
+
+    struct rec_segment_t
+    {
+        uint32_t id;
+        uint32_t frames;
+        int64_t start_us;
+        int64_t end_us;
+    };
+    static_assert(sizeof(rec_segment_t) == 24, "rec_segment_t is an on-disk format");
+
+    class Recorder
+    {
+    public:
+        static constexpr const char *TAG = "[Recorder]";
+        static constexpr const char *DIR = "/sd/rec";
+
+        static Recorder &getInstance()
+        {
+            static Recorder instance;
+            return instance;
+        }
+
+        // Enregistre à IOT_REC_TRIGGER_FPS pendant duration_ms (prolonge si déjà actif)
+        void trigger(uint32_t duration_ms);
+        bool isTriggered();
+        // CAMERA_MOTION : enregistre tant que le mouvement dure
+        void setMotion(bool active);
+        void stats_to_json(cJSON *obj);
+
+        // GET /iot/rec : état + segments ; GET /iot/rec/export?from=&to= (secondes epoch)
+        static esp_err_t list_handler(httpd_req_t *req);
+        static esp_err_t export_handler(httpd_req_t *req);
+
+        static void on_event(const Event *evt);
+        struct register_event_bus
+        {
+            register_event_bus()
+            {
+                EventBus::getInstance().subscribe(on_event, TAG);
+            }
+        };
+        inline static register_event_bus _register_event_bus;
+
+    private:
+        Recorder() = default;
+        Recorder(const Recorder &) = delete;
+        Recorder &operator=(const Recorder &) = delete;
+
+        static void task(void *arg);
+        void loop();
+        bool start();
+        void recover();
+        bool openSegment(int64_t ts_us);
+        void closeSegment();
+        // ts_us : temps réel ; mono_us : esp_timer à la capture (détection des sauts d'horloge)
+        bool append(const uint8_t *data, size_t len, int64_t ts_us, int64_t mono_us);
+        bool flushData(bool final);
+        bool flushIndex();
+
+        // lecture seule de l'index d'un segment, bornée au contenu déjà écrit
+        uint32_t readableFrames(const rec_segment_t &seg);
+        bool currentSegment(rec_segment_t *seg);
+
+        std::mutex mutex_;
+        TaskHandle_t task_ = nullptr;
+        bool sd_ready_ = false;
+        bool camera_ready_ = false;
+        int64_t trigger_until_us_ = 0;
+
+        // segment courant (tâche d'enregistrement uniquement, sauf mention)
+        int data_fd_ = -1;
+        int index_fd_ = -1;
+        uint8_t *buffer_ = nullptr;
+        size_t buffered_ = 0;
+        uint32_t file_offset_ = 0; // octets déjà écrits dans .mjp (multiple du bloc)
+        rec_index_t index_buf_[32];
+        size_t index_buffered_ = 0;
+        uint32_t next_id_ = 1;
+        rec_segment_t current_ = {}; // protégé par mutex_
+        uint32_t flushed_frames_ = 0; // protégé par mutex_ : images lisibles sur la carte
+        int64_t last_mono_us_ = 0;     // esp_timer de la dernière image du segment
+
+        uint32_t frames_ = 0;
+        uint32_t dropped_ = 0;
+        uint32_t unsynced_ = 0;    // images ignorées avant la mise à l'heure SNTP
+        uint32_t clock_jumps_ = 0; // segments coupés sur un recalage d'horloge
+        uint32_t write_errors_ = 0;
+        uint32_t segments_ = 0;
+        uint64_t bytes_ = 0;
+        uint32_t flushes_ = 0;
+        int64_t flush_us_ = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+#ifndef __IOT_SEND_IOV_H__
+#define __IOT_SEND_IOV_H__
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "esp_timer.h"
+
+/**
+ * Envoi vectorisé sur socket non bloquant, sans autre dépendance que les
+ * sockets et esp_timer : compilé tel quel sur l'hôte (host_test/camera) pour
+ * être exercé avec des envois partiels et EAGAIN.
+ */
+namespace camera
+{
+    // Appels sendmsg et attentes de place dans le buffer TCP pour une image
+    struct WriteCounters
+    {
+        uint32_t calls = 0;
+        uint32_t waits = 0;
+    };
+
+    // Attend que le socket accepte des données jusqu'à deadline_us (esp_timer)
+    inline bool wait_writable(int fd, int64_t deadline_us)
+    {
+        int64_t remaining = deadline_us - esp_timer_get_time();
+        if (remaining <= 0)
+            return false;
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(fd, &wfds);
+        struct timeval tv = {.tv_sec = (time_t)(remaining / 1000000), .tv_usec = (suseconds_t)(remaining % 1000000)};
+        return select(fd + 1, nullptr, &wfds, nullptr, &tv) >= 0;
+    }
+
+    // Envoi complet d'un vecteur sur socket non bloquant : un seul sendmsg
+    // (donc une seule écriture lwIP) dans le cas courant, reprise sur envoi
+    // partiel. iov est consommé en place. false si erreur ou échéance dépassée.
+    inline bool send_all_iov(int fd, struct iovec *iov, int iovcnt, int64_t deadline_us, WriteCounters &counters)
+    {
+        while (iovcnt > 0)
+        {
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+            ssize_t n = sendmsg(fd, &msg, MSG_DONTWAIT);
+            counters.calls++;
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    return false;
+                counters.waits++;
+                if (!wait_writable(fd, deadline_us))
+                    return false;
+                continue;
+            }
+            // avance dans le vecteur
+            size_t done = n;
+            while (iovcnt > 0 && done >= iov->iov_len)
+            {
+                done -= iov->iov_len;
+                iov++;
+                iovcnt--;
+            }
+            if (iovcnt > 0)
+            {
+                iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + done;
+                iov->iov_len -= done;
+            }
+        }
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,195 @@
+#include "stream_pacing.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "camera_controller.h"
+
+using namespace camera_controller;
+namespace camera
+{
+    static constexpr float EWMA_ALPHA = 0.25f;
+    static constexpr float INTERVAL_HEADROOM = 1.2f; // marge pour ne pas remplir le buffer TCP
+    static constexpr int64_t WINDOW_US = 2 * 1000 * 1000;
+#ifdef CONFIG_IOT_STREAM_ADAPTIVE
+    static constexpr int QUALITY_STEP = 5;
+#endif
+    static constexpr int64_t MIN_INTERVAL_US = 1000000 / CONFIG_IOT_STREAM_MAX_FPS;
+
+    void LinkEstimator::onSent(size_t bytes, int64_t elapsed_us)
+    {
+        if (elapsed_us <= 0)
+            elapsed_us = 1;
+        float sample = bytes * 1e6f / elapsed_us;
+        bytes_per_s = bytes_per_s == 0 ? sample : bytes_per_s + EWMA_ALPHA * (sample - bytes_per_s);
+    }
+
+    float LinkEstimator::sustainableFps(size_t frame_bytes) const
+    {
+        if (bytes_per_s <= 0 || frame_bytes == 0)
+            return 0;
+        return bytes_per_s / (frame_bytes * INTERVAL_HEADROOM);
+    }
+
+    int64_t LinkEstimator::intervalUs(size_t frame_bytes) const
+    {
+        float fps = sustainableFps(frame_bytes);
+        int64_t interval = fps > 0 ? (int64_t)(1e6f / fps) : MIN_INTERVAL_US;
+        return interval < MIN_INTERVAL_US ? MIN_INTERVAL_US : interval;
+    }
+
+    void StreamQuality::clientStarted()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (clients_++ > 0)
+            return;
+        sensor_t *s = CameraController::getInstance().getSensor();
+        if (s)
+        {
+            base_quality_ = s->status.quality;
+            base_framesize_ = s->status.framesize;
+        }
+        quality_ = base_quality_;
+        framesize_ = base_framesize_;
+        window_start_us_ = esp_timer_get_time();
+        window_has_sample_ = false;
+    }
+
+    void StreamQuality::clientStopped()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (clients_ == 0 || --clients_ > 0)
+            return;
+#ifdef CONFIG_IOT_STREAM_ADAPTIVE
+        SettingsTransaction tx;
+        tx.markPacing();
+        tx.setFrameSize(base_framesize_);
+        tx.setQuality(base_quality_);
+        tx.commit();
+#endif
+    }
+
+    void StreamQuality::report(float sustainable_fps)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!window_has_sample_ || sustainable_fps < window_min_fps_)
+            window_min_fps_ = sustainable_fps;
+        window_has_sample_ = true;
+
+        int64_t now = esp_timer_get_time();
+        if (now - window_start_us_ < WINDOW_US)
+            return;
+        last_min_fps_ = window_min_fps_;
+        window_start_us_ = now;
+        window_has_sample_ = false;
+#ifdef CONFIG_IOT_STREAM_ADAPTIVE
+        adjust(last_min_fps_);
+#endif
+    }
+
+#ifdef CONFIG_IOT_STREAM_ADAPTIVE
+    // mutex_ tenu
+    void StreamQuality::adjust(float min_fps)
+    {
+        SettingsTransaction tx;
+        tx.markPacing();
+        const float target = CONFIG_IOT_STREAM_TARGET_FPS;
+        // quality : plus la valeur est grande, plus l'image est compressée
+        if (min_fps < target * 0.8f)
+        {
+            if (quality_ < CONFIG_IOT_STREAM_QUALITY_WORST)
+            {
+                quality_ += QUALITY_STEP;
+                if (quality_ > CONFIG_IOT_STREAM_QUALITY_WORST)
+                    quality_ = CONFIG_IOT_STREAM_QUALITY_WORST;
+                tx.setQuality(quality_);
+            }
+            else if (framesize_ > CONFIG_IOT_STREAM_FRAMESIZE_MIN)
+            {
+                framesize_ = static_cast<framesize_t>(framesize_ - 1);
+                tx.setFrameSize(framesize_);
+            }
+            else
+            {
+                return;
+            }
+            tx.commit();
+            degraded_++;
+            ESP_LOGI(TAG, "slowest link %.1f fps: quality %d, framesize %d", min_fps, quality_, (int)framesize_);
+        }
+        else if (min_fps > target * 1.5f)
+        {
+            // jamais au-delà des réglages de l'utilisateur
+            if (framesize_ < base_framesize_)
+            {
+                framesize_ = static_cast<framesize_t>(framesize_ + 1);
+                tx.setFrameSize(framesize_);
+            }
+            else if (quality_ > base_quality_)
+            {
+                quality_ -= QUALITY_STEP;
+                if (quality_ < base_quality_)
+                    quality_ = base_quality_;
+                tx.setQuality(quality_);
+            }
+            else
+            {
+                return;
+            }
+            tx.commit();
+            improved_++;
+            ESP_LOGI(TAG, "slowest link %.1f fps: quality %d, framesize %d", min_fps, quality_, (int)framesize_);
+        }
+    }
+#endif
+
+    void StreamQuality::baseChanged(int quality, int framesize)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (quality >= 0)
+            base_quality_ = quality_ = quality;
+        if (framesize >= 0)
+            base_framesize_ = framesize_ = static_cast<framesize_t>(framesize);
+        // la fenêtre en cours mesurait les anciens réglages
+        window_start_us_ = esp_timer_get_time();
+        window_has_sample_ = false;
+    }
+
+    bool StreamQuality::baseSettings(int &quality, framesize_t &framesize)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (clients_ == 0)
+            return false;
+        quality = base_quality_;
+        framesize = base_framesize_;
+        return true;
+    }
+
+    void StreamQuality::countDeadlineMiss()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deadline_misses_++;
+    }
+
+    void StreamQuality::countWrite(const WriteCounters &counters)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_sent_++;
+        send_calls_ += counters.calls;
+        send_waits_ += counters.waits;
+    }
+
+    void StreamQuality::stats_to_json(cJSON *obj)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cJSON_AddNumberToObject(obj, "clients", clients_);
+        cJSON_AddNumberToObject(obj, "quality", clients_ ? quality_ : base_quality_);
+        cJSON_AddNumberToObject(obj, "framesize", clients_ ? framesize_ : base_framesize_);
+        cJSON_AddNumberToObject(obj, "slowest_fps", last_min_fps_);
+        cJSON_AddNumberToObject(obj, "degraded", degraded_);
+        cJSON_AddNumberToObject(obj, "improved", improved_);
+        cJSON_AddNumberToObject(obj, "deadline_misses", deadline_misses_);
+        cJSON_AddNumberToObject(obj, "frames_sent", frames_sent_);
+        // 1.0 = chaque image part en un seul sendmsg
+        cJSON_AddNumberToObject(obj, "calls_per_frame", frames_sent_ ? (double)send_calls_ / frames_sent_ : 0);
+        cJSON_AddNumberToObject(obj, "waits_per_frame", frames_sent_ ? (double)send_waits_ / frames_sent_ : 0);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef __IOT_STREAM_PACING_H__
+#define __IOT_STREAM_PACING_H__
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "cJSON.h"
+#include "esp_camera.h"
+#include "sdkconfig.h"
+#include "send_iov.h"
+
+namespace camera
+{
+    /**
+     * Estimation du débit d'un client MJPEG : EWMA des octets / durée d'envoi
+     * (attente du socket comprise). L'intervalle entre images suit ce que le
+     * lien peut écouler, borné par IOT_STREAM_MAX_FPS.
+     */
+    struct LinkEstimator
+    {
+        float bytes_per_s = 0;
+
+        void onSent(size_t bytes, int64_t elapsed_us);
+        // Images/s que ce lien peut tenir à cette taille d'image
+        float sustainableFps(size_t frame_bytes) const;
+        int64_t intervalUs(size_t frame_bytes) const;
+    };
+
+    /**
+     * Qualité JPEG et résolution communes à tous les flux : sur une fenêtre, si
+     * le client le plus lent ne tient pas IOT_STREAM_TARGET_FPS on dégrade
+     * (qualité d'abord, puis résolution) ; s'il a de la marge on remonte
+     * (résolution d'abord). Les réglages d'origine sont restaurés au départ du
+     * dernier client.
+     *
+     * Les réglages de base suivent tout commit hors pacing (API, preset) : une
+     * dégradation en cours repart de la nouvelle base, et une sauvegarde pendant
+     * un flux enregistre la base, jamais la valeur dégradée.
+     */
+    class StreamQuality
+    {
+    public:
+        static constexpr const char *TAG = "[StreamQuality]";
+
+        static StreamQuality &getInstance()
+        {
+            static StreamQuality instance;
+            return instance;
+        }
+
+        void clientStarted();
+        void clientStopped();
+        void report(float sustainable_fps);
+        void countDeadlineMiss();
+        void countWrite(const WriteCounters &counters);
+        // Commit hors pacing : -1 = inchangé
+        void baseChanged(int quality, int framesize);
+        // false hors flux : le capteur porte alors les réglages de base
+        bool baseSettings(int &quality, framesize_t &framesize);
+        void stats_to_json(cJSON *obj);
+
+    private:
+        StreamQuality() = default;
+#ifdef CONFIG_IOT_STREAM_ADAPTIVE
+        void adjust(float min_fps);
+#endif
+
+        std::mutex mutex_;
+        uint32_t clients_ = 0;
+        int64_t window_start_us_ = 0;
+        float window_min_fps_ = 0;
+        bool window_has_sample_ = false;
+
+        // réglages utilisateur à restaurer
+        int base_quality_ = 0;
+        framesize_t base_framesize_ = FRAMESIZE_SVGA;
+        int quality_ = 0;
+        framesize_t framesize_ = FRAMESIZE_SVGA;
+
+        uint32_t degraded_ = 0;
+        uint32_t improved_ = 0;
+        uint32_t deadline_misses_ = 0;
+        uint32_t frames_sent_ = 0;
+        uint32_t send_calls_ = 0;
+        uint32_t send_waits_ = 0;
+        float last_min_fps_ = 0;
+    };
+}
+
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 #ifndef __MACRO_H__
 #define __MACRO_H__
+#include "sdkconfig.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "esp_log.h"
@@ -37,14 +38,31 @@ using http_handler_t = esp_err_t (*)(httpd_req_t *);
 /**
  *
  */
-#define HTTP_RECV_BODY_OR_FAIL(req, body_var, log_tag, error_msg) \
-    int __len = req->content_len;                                 \
-    std::string body_var(__len, '\0');                            \
-    if (httpd_req_recv(req, &body_var[0], __len) <= 0)            \
-    {                                                             \
-        ESP_LOGE(log_tag, "%s", error_msg);                       \
-        httpd_resp_send_500(req);                                 \
-        return ESP_FAIL;                                          \
+#define HTTP_RECV_BODY_OR_FAIL(req, body_var, log_tag, error_msg)                      \
+    size_t __len = req->content_len;                                                   \
+    if (__len == 0 || __len > CONFIG_IOT_HTTP_BODY_BUF_SIZE)                           \
+    {                                                                                  \
+        ESP_LOGE(log_tag, "%s (len %u)", error_msg, (unsigned)__len);                  \
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, error_msg);                    \
+        return ESP_FAIL;                                                               \
+    }                                                                                  \
+    std::string body_var(__len, '\0');                                                 \
+    size_t __got = 0;                                                                  \
+    int __timeouts = 0;                                                                \
+    while (__got < __len)                                                              \
+    {                                                                                  \
+        int __r = httpd_req_recv(req, &body_var[__got], __len - __got);               \
+        if (__r == HTTPD_SOCK_ERR_TIMEOUT && ++__timeouts <= 3)                        \
+            continue;                                                                  \
+        if (__r <= 0)                                                                  \
+            break;                                                                     \
+        __got += __r;                                                                  \
+    }                                                                                  \
+    if (__got != __len)                                                                \
+    {                                                                                  \
+        ESP_LOGE(log_tag, "%s", error_msg);                                            \
+        httpd_resp_send_500(req);                                                      \
+        return ESP_FAIL;                                                               \
     }
 /**
  *
@@ -5,6 +5,7 @@
 #include "Fs.h"
 // #include "wifi_manager.h"
 #include "MqttClient.hpp"
+#include "MqttRpc.h"
 #include "api.h"
 #include "LedManager.h"
 #include "WiFiConfig.h"
@@ -75,4 +76,22 @@ extern "C" void app_main(void)
             }
         },
         MqttClient::MqttActuatorFilter::SAME_IP);
+
+#ifdef CONFIG_IOT_MQTT_RPC_ENABLE
+    MqttRpc::getInstance().registerMethod("led.get", [](const cJSON *, cJSON *result)
+                                          {
+        cJSON_AddNumberToObject(result, "led", LedManager::getInstance().isOn());
+        return ESP_OK; });
+    MqttRpc::getInstance().registerMethod("led.set", [](const cJSON *params, cJSON *result)
+                                          {
+        cJSON *led = cJSON_GetObjectItemCaseSensitive(params, "led");
+        if (!cJSON_IsNumber(led))
+            return ESP_ERR_INVALID_ARG;
+        if (led->valueint == 1)
+            LedManager::getInstance().on();
+        else
+            LedManager::getInstance().off();
+        cJSON_AddNumberToObject(result, "led", LedManager::getInstance().isOn());
+        return ESP_OK; });
+#endif
 }
\ No newline at end of file
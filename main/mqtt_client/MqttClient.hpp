@@ -2,6 +2,8 @@
 
 #include "event_bus.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
@@ -9,18 +11,26 @@
 #include <mutex>
 #include <cstring>
 #include <map>
+#include <memory>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "cJSON.h"
 #include "types.h"
 #include "persistence.h"
 #include "utils.h"
 #include "macro.h"
+#include "features.hpp"
+#include "snapshot.h"
+#include "json_stream.h"
 
 #ifdef CONFIG_IOT_FEATURE_SD
 #define MQTT_CFG_PATH "/sd/mqtt.bin"
+#define MQTT_SESSION_PATH "/sd/mqtt_session.bin"
 #else
 #define MQTT_CFG_PATH "/fs/mqtt.bin"
+#define MQTT_SESSION_PATH "/fs/mqtt_session.bin"
 #endif
 
 class MqttClient final
@@ -29,13 +39,31 @@ public:
     enum class MqttActuatorFilter
     {
         NONE = 0,
-        SAME_IP = 0,
+        SAME_IP = 1,   // {"ip":"<ip du noeud>"}
+        DEVICE_ID = 2, // {"target":"<utils::device_id()>"}
     };
 
     using PublisherCallback = std::function<std::string(const char *)>;
     using SubscribeCallback = std::function<std::string(const char *topic, const char *payload, int len)>;
     using MqttJsonHandler = std::function<void(const cJSON *root, cJSON *resp)>;
 
+    // Compteurs du chemin MQTT (publication, dispatch, reconnexions)
+    struct Metrics
+    {
+        uint32_t published;       // remis à esp-mqtt
+        uint32_t publish_failed;  // refusés par esp-mqtt
+        uint32_t queue_dropped;   // queue de publication pleine
+        uint32_t offline_queued;  // mis en outbox hors connexion
+        uint32_t offline_dropped; // perdus hors connexion
+        uint32_t received;        // remis aux callbacks abonnés
+        uint32_t filtered;        // écartés par le filtre d'actionneur, sans copie
+        uint64_t dispatch_us_sum; // durée des callbacks abonnés
+        uint32_t dispatch_us_max;
+        uint32_t connects;
+        uint32_t disconnects;
+        uint32_t heap_min; // heap libre minimal observé aux (dé)connexions
+    };
+
     static MqttClient &getInstance()
     {
         static MqttClient instance;
@@ -61,7 +89,14 @@ public:
         cfg.broker.address.uri = mqtt_config.broker_uri;
         cfg.credentials.username = mqtt_config.username;
         cfg.credentials.authentication.password = mqtt_config.password;
-        cfg.credentials.client_id = utils::make_unique_client_id(mqtt_config.client_id).c_str();
+        // ID stable par appareil : le broker peut reprendre la session au reconnect.
+        // Le buffer est un membre, esp_mqtt_client_init ne garde que le pointeur.
+        snprintf(client_id_, sizeof(client_id_), "%s-%s", mqtt_config.client_id, utils::device_id());
+        cfg.credentials.client_id = client_id_;
+#ifdef CONFIG_IOT_MQTT_PERSISTENT_SESSION
+        cfg.session.disable_clean_session = true;
+        cfg.session.keepalive = CONFIG_IOT_MQTT_KEEPALIVE_S;
+#endif
         ESP_LOGI(TAG, "MQTT client id: %s \n uri : %s", cfg.credentials.client_id, mqtt_config.broker_uri);
         client_ = esp_mqtt_client_init(&cfg);
         esp_mqtt_client_register_event(client_, MQTT_EVENT_ANY, mqtt_event_handler, this);
@@ -79,7 +114,12 @@ public:
     {
         PublishMessage msg{};
         strncpy(msg.topic, topic, sizeof(msg.topic) - 1);
-        size_t len = strnlen(payload, sizeof(msg.payload) - 1);
+        size_t len = strnlen(payload, sizeof(msg.payload));
+        if (len >= sizeof(msg.payload))
+        {
+            ESP_LOGE(TAG, "Payload too large for %s, message dropped", topic);
+            return false;
+        }
         memcpy(msg.payload, payload, len);
         msg.payload[len] = '\0';
         msg.payload_len = len;
@@ -88,6 +128,7 @@ public:
 
         if (xQueueSend(publish_queue_, &msg, pdMS_TO_TICKS(100)) != pdTRUE)
         {
+            countMetric(&Metrics::queue_dropped);
             ESP_LOGE(TAG, "Queue publish full, message dropped");
             return false;
         }
@@ -103,58 +144,174 @@ public:
     void registerSubscriber(const char *topic, const char *answer_topic, SubscribeCallback cb)
     {
         std::lock_guard lock(sub_mutex_);
-        subscribers_[std::string(topic)] = SubscriberInfo{cb, std::string(answer_topic ? answer_topic : ""), false};
+        subscribers_[std::string(topic)] = SubscriberInfo{cb, std::string(answer_topic ? answer_topic : ""), false, MqttActuatorFilter::NONE, nullptr};
     }
+    // Le filtre est évalué par le dispatch MQTT_EVENT_DATA sur le payload brut
+    // (json_peek_*), avant toute copie, event bus ou cJSON_Parse : un message
+    // destiné à un autre noeud ne coûte aucune allocation (compteur "filtered").
+    // Un second abonnement "<topic_in>/<device_id>" reçoit les commandes adressées
+    // directement à ce noeud, sans filtre.
     void registerMqttActuator(const char *topic_in, const char *topic_out, MqttJsonHandler handler, MqttActuatorFilter filter = MqttActuatorFilter::NONE)
     {
-        registerSubscriber(topic_in, topic_out,
-                           [handler, filter](const char *topic, const char *payload, size_t) -> std::string
-                           {
-                               ESP_LOGI(TAG, "Received topic: %s payload: %s", topic, payload);
-                               std::string result;
-
-                               cJSON *root = cJSON_Parse(payload);
-                               if (!root || !cJSON_IsObject(root))
-                               {
-                                   ESP_LOGE(TAG, "Invalid JSON");
-                                   if (root)
-                                       cJSON_Delete(root);
-                                   return result;
-                               }
-
-                               cJSON *resp = cJSON_Duplicate(root, true);
-                               if (filter == MqttActuatorFilter::SAME_IP)
-                               {
-                                   cJSON *ip = cJSON_GetObjectItem(root, "ip");
-                                   if (ip)
-                                   {
-                                       char *ip_str = cJSON_GetStringValue(ip);
-                                       ESP_LOGI(TAG, "IP: %s, self IP: %s", ip_str, self_ip);
-                                       if (strcmp(ip_str, self_ip) == 0)
-                                       {
-                                           handler(root, resp);
-                                       }
-                                   }
-                               }
-                               else if (filter == MqttActuatorFilter::NONE)
-                               {
-                                   handler(root, resp);
-                               }
-
-                               char *raw = cJSON_PrintUnformatted(resp);
-                               if (raw)
-                               {
-                                   result = raw;
-                                   cJSON_free(raw);
-                               }
-
-                               cJSON_Delete(root);
-                               cJSON_Delete(resp);
-
-                               ESP_LOGI(TAG, "Response: %s", result.c_str());
-                               return result;
-                           });
+        auto stats = std::make_shared<FilterStats>();
+        stats->mode = filter;
+
+        auto callback = [handler](const char *topic, const char *payload, int len) -> std::string
+        {
+            std::string result;
+            ESP_LOGI(TAG, "Received topic: %s payload: %s", topic, payload);
+
+            cJSON *root = cJSON_ParseWithLength(payload, len);
+            if (!root || !cJSON_IsObject(root))
+            {
+                ESP_LOGE(TAG, "Invalid JSON");
+                if (root)
+                    cJSON_Delete(root);
+                return result;
+            }
+
+            cJSON *resp = cJSON_Duplicate(root, true);
+            handler(root, resp);
+
+            char *raw = cJSON_PrintUnformatted(resp);
+            if (raw)
+            {
+                result = raw;
+                cJSON_free(raw);
+            }
+
+            cJSON_Delete(root);
+            cJSON_Delete(resp);
+
+            ESP_LOGI(TAG, "Response: %s", result.c_str());
+            return result;
+        };
+
+        std::string addressed = std::string(topic_in) + "/" + utils::device_id();
+        registerSubscriber(topic_in, topic_out, callback);
+        registerSubscriber(addressed.c_str(), topic_out, callback);
+
+        std::lock_guard lock(sub_mutex_);
+        subscribers_[std::string(topic_in)].mode = filter;
+        subscribers_[std::string(topic_in)].filter = stats;
+        subscribers_[addressed].filter = stats;
+    }
+    // Accès direct à la config (shadow...) sans aller-retour JSON
+    static const mqtt_client_config_t &getConfig() { return mqtt_config; }
+    static bool parseConfig(const char *json, mqtt_client_config_t &cfg) { return mqtt_from_json(json, cfg); }
+    // persist = false : l'appelant sauvegarde lui-même (transaction /iot/config)
+    static void setConfig(const mqtt_client_config_t &cfg, bool persist = true)
+    {
+        mqtt_config = cfg;
+        publish_snapshot();
+        if (persist)
+            task_save_mqtt();
+    }
+
+    Metrics getMetrics()
+    {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        return metrics_;
+    }
+    void resetMetrics()
+    {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        metrics_ = {};
+    }
+    // Coupe et relance la connexion (tests de charge / reprise de session)
+    void forceReconnect()
+    {
+        if (!client_)
+            return;
+        esp_mqtt_client_disconnect(client_);
+        esp_mqtt_client_reconnect(client_);
     }
+    size_t queueUsage()
+    {
+        return publish_queue_ ? uxQueueMessagesWaiting(publish_queue_) : 0;
+    }
+
+    // Statut complet écrit en flux (GET /iot/mqtt_status), sans la limite de Event::data
+    void writeStatus(JsonStream &w)
+    {
+        w.beginObject();
+        w.boolean(enabled_key, mqtt_config.enabled);
+        w.string("client_id", client_id_);
+        w.boolean("connected", isConnected());
+
+        // Copies sous verrou, écriture après : JsonStream vide son tampon sur la
+        // socket et les callbacks de publication peuvent être lents
+        std::vector<std::pair<std::string, AutoPublisher>> publishers;
+        {
+            std::lock_guard<std::mutex> lock(pub_mutex_);
+            publishers.assign(autoPublishers_.begin(), autoPublishers_.end());
+        }
+        struct SubscriberStatus
+        {
+            std::string topic;
+            std::string answer_topic;
+            bool subscribed;
+            bool filtered;
+            FilterStats filter;
+        };
+        std::vector<SubscriberStatus> subscribers;
+        {
+            std::lock_guard<std::mutex> lock(sub_mutex_);
+            subscribers.reserve(subscribers_.size());
+            for (auto const &[topic, sub] : subscribers_)
+                subscribers.push_back({topic, sub.answer_topic, sub.subscribed, sub.filter != nullptr,
+                                       sub.filter ? *sub.filter : FilterStats{}});
+        }
+
+        w.beginArray("publishers");
+        for (auto const &[topic, pub] : publishers)
+        {
+            std::string payload = pub.callback(topic.c_str());
+            w.beginObject();
+            w.string("topic", topic.c_str());
+            w.string("payload", payload.c_str());
+            w.number("interval_ms", pub.interval);
+            w.number("lastPub", pub.lastPub);
+            w.endObject();
+        }
+        w.endArray();
+
+        w.beginArray("subscribers");
+        for (auto const &sub : subscribers)
+        {
+            w.beginObject();
+            w.string("topic", sub.topic.c_str());
+            w.string("answer_topic", sub.answer_topic.c_str());
+            w.boolean("subscribed", sub.subscribed);
+            if (sub.filtered)
+            {
+                w.number("filter", static_cast<int>(sub.filter.mode));
+                w.number("filter_hits", sub.filter.hits);
+                w.number("filter_misses", sub.filter.misses);
+            }
+            w.endObject();
+        }
+        w.endArray();
+
+        Metrics m = getMetrics();
+        w.beginObject("metrics");
+        w.number("published", m.published);
+        w.number("publish_failed", m.publish_failed);
+        w.number("queue_dropped", m.queue_dropped);
+        w.number("offline_queued", m.offline_queued);
+        w.number("offline_dropped", m.offline_dropped);
+        w.number("received", m.received);
+        w.number("filtered", m.filtered);
+        w.number("dispatch_avg_us", m.received ? (double)(m.dispatch_us_sum / m.received) : 0);
+        w.number("dispatch_max_us", m.dispatch_us_max);
+        w.number("connects", m.connects);
+        w.number("disconnects", m.disconnects);
+        w.number("heap_min", m.heap_min);
+        w.number("queue_usage", queueUsage());
+        w.endObject();
+        w.endObject();
+    }
+
     // Vérification de la connexion
     bool isConnected()
     {
@@ -172,7 +329,7 @@ private:
     struct PublishMessage
     {
         char topic[128];
-        char payload[256];
+        char payload[CONFIG_IOT_MQTT_PUBLISH_PAYLOAD_MAX];
         size_t payload_len;
         int qos;
         bool retain;
@@ -184,28 +341,66 @@ private:
         uint32_t interval;
         uint32_t lastPub;
     };
+    struct FilterStats
+    {
+        MqttActuatorFilter mode;
+        uint32_t hits;
+        uint32_t misses;
+    };
     struct SubscriberInfo
     {
         SubscribeCallback callback;
         std::string answer_topic;
         bool subscribed;
+        MqttActuatorFilter mode; // appliqué avant toute copie du message
+        std::shared_ptr<FilterStats> filter;
+    };
+
+    // Etat de session persisté : permet de savoir si les abonnements
+    // connus du broker correspondent encore aux nôtres
+    struct mqtt_session_state_t
+    {
+        char client_id[MAX_CLIENT_ID_LEN + 16];
+        uint32_t broker_hash;
+        uint32_t topics_hash;
     };
 
     esp_mqtt_client_handle_t client_;
     QueueHandle_t publish_queue_;
+    char client_id_[MAX_CLIENT_ID_LEN + 16] = {};
     bool is_initialized_;
     bool is_connected_;
 
     std::mutex mutex_;
     std::mutex pub_mutex_;
     std::mutex sub_mutex_;
+    std::mutex metrics_mutex_;
+    Metrics metrics_ = {};
 
     std::map<std::string, AutoPublisher> autoPublishers_;
-    std::map<std::string, SubscriberInfo> subscribers_;
+    // std::less<> : recherche par string_view depuis le dispatch, sans copie du topic
+    std::map<std::string, SubscriberInfo, std::less<>> subscribers_;
 
     static constexpr const char *TAG = "[MQTT]";
     inline static char self_ip[16];
     inline static char self_host[32];
+
+    static bool accept_payload(MqttActuatorFilter filter, const char *payload, int len)
+    {
+        char value[40];
+        switch (filter)
+        {
+        case MqttActuatorFilter::SAME_IP:
+            return utils::json_peek_string(payload, len, "ip", value, sizeof(value)) &&
+                   strcmp(value, self_ip) == 0;
+        case MqttActuatorFilter::DEVICE_ID:
+            return utils::json_peek_string(payload, len, "target", value, sizeof(value)) &&
+                   strcmp(value, utils::device_id()) == 0;
+        case MqttActuatorFilter::NONE:
+        default:
+            return true;
+        }
+    }
     MqttClient()
         : client_(nullptr), publish_queue_(nullptr), is_initialized_(false), is_connected_(false) {}
 
@@ -220,21 +415,81 @@ private:
             vQueueDelete(publish_queue_);
     }
 
+    void countMetric(uint32_t Metrics::*field)
+    {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        metrics_.*field += 1;
+    }
+    void sampleHeap(uint32_t Metrics::*counter)
+    {
+        uint32_t heap = esp_get_free_heap_size();
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        metrics_.*counter += 1;
+        if (metrics_.heap_min == 0 || heap < metrics_.heap_min)
+            metrics_.heap_min = heap;
+    }
+
+    // Hash des topics abonnés (map triée : indépendant de l'ordre d'enregistrement)
+    uint32_t subscribedTopicsHash() const
+    {
+        uint32_t h = 0;
+        for (auto const &[topic, sub] : subscribers_)
+            if (sub.subscribed)
+                h = (h * 31) ^ utils::hash_struct(topic.data(), topic.size());
+        return h;
+    }
+
+    // A la connexion : si le broker a repris une session dont les abonnements
+    // sont identiques aux nôtres, inutile de les rejouer. Sinon tout est refait
+    // (session neuve = plus aucun abonnement côté broker).
+    void resumeSession(bool session_present)
+    {
+        std::lock_guard lock(sub_mutex_);
+        bool resumed = false;
+#ifdef CONFIG_IOT_MQTT_PERSISTENT_SESSION
+        uint32_t broker_hash = utils::hash_struct(mqtt_config.broker_uri, strnlen(mqtt_config.broker_uri, sizeof(mqtt_config.broker_uri)));
+        resumed = session_present && session_state.topics_hash != 0 &&
+                  session_state.broker_hash == broker_hash &&
+                  strcmp(session_state.client_id, client_id_) == 0;
+#endif
+        for (auto &[topic, sub] : subscribers_)
+            sub.subscribed = resumed;
+        if (resumed && subscribedTopicsHash() != session_state.topics_hash)
+        {
+            // des topics ont changé depuis la dernière session : on rejoue tout
+            for (auto &[topic, sub] : subscribers_)
+                sub.subscribed = false;
+            resumed = false;
+        }
+        ESP_LOGI(TAG, "Session %s", resumed ? "resumed, subscriptions kept" : "new, resubscribing");
+    }
+
     void listenSubscribers()
     {
         std::lock_guard lock(sub_mutex_);
         if (!client_ || !is_connected_)
             return;
 
+        bool changed = false;
         for (auto &[topic, sub] : subscribers_)
         {
             if (!sub.subscribed)
             {
                 int msg_id = esp_mqtt_client_subscribe(client_, topic.c_str(), 1);
                 sub.subscribed = (msg_id >= 0);
+                changed |= sub.subscribed;
                 ESP_LOGI(TAG, "Subscribed to %s : %s", topic.c_str(), sub.subscribed ? "success" : "fail");
             }
         }
+#ifdef CONFIG_IOT_MQTT_PERSISTENT_SESSION
+        if (changed)
+        {
+            strncpy(session_state.client_id, client_id_, sizeof(session_state.client_id) - 1);
+            session_state.broker_hash = utils::hash_struct(mqtt_config.broker_uri, strnlen(mqtt_config.broker_uri, sizeof(mqtt_config.broker_uri)));
+            session_state.topics_hash = subscribedTopicsHash();
+            task_save_session();
+        }
+#endif
     }
 
     // Handler d'événements MQTT
@@ -247,8 +502,11 @@ private:
         {
         case MQTT_EVENT_CONNECTED:
         {
-            ESP_LOGI(TAG, "MQTT connected");
+            auto *event = static_cast<esp_mqtt_event_handle_t>(event_data);
+            ESP_LOGI(TAG, "MQTT connected (session_present=%d)", event->session_present);
             instance->is_connected_ = true;
+            instance->sampleHeap(&Metrics::connects);
+            instance->resumeSession(event->session_present);
             instance->listenSubscribers();
             utils::emitEvent(EventType::MQTT_CONNECTED);
             break;
@@ -258,6 +516,7 @@ private:
         {
             ESP_LOGW(TAG, "MQTT disconnected");
             instance->is_connected_ = false;
+            instance->sampleHeap(&Metrics::disconnects);
             utils::emitEvent(EventType::MQTT_DISCONNECTED);
             break;
         }
@@ -265,29 +524,47 @@ private:
         case MQTT_EVENT_DATA:
         {
             auto *event = static_cast<esp_mqtt_event_handle_t>(event_data);
-            std::string topic(event->topic, event->topic_len);
-            std::string payload(event->data, event->data_len);
+            auto it = instance->subscribers_.find(std::string_view(event->topic, event->topic_len));
+            if (it == instance->subscribers_.end())
+                break;
+            SubscriberInfo &sub = it->second;
+
+            // Filtre d'actionneur sur le payload brut, avant toute copie ou event :
+            // un message pour un autre noeud s'arrête ici
+            if (!accept_payload(sub.mode, event->data, event->data_len))
+            {
+                if (sub.filter)
+                    sub.filter->misses++;
+                instance->countMetric(&Metrics::filtered);
+                break;
+            }
+            if (sub.filter)
+                sub.filter->hits++;
 
             // Emit as EventBus event (universel)
             Event evt = {};
             evt.type = EventType::MQTT_MESSAGE;
 
             // Embeds as JSON in data
-            snprintf((char *)evt.data, sizeof(evt.data),
-                     "{\"topic\":\"%s\",\"payload\":\"%s\"}", topic.c_str(), payload.c_str());
+            snprintf((char *)evt.data, sizeof(evt.data), "{\"topic\":\"%.*s\",\"payload\":\"%.*s\"}",
+                     event->topic_len, event->topic, event->data_len, event->data);
             evt.data_len = strlen((char *)evt.data);
 
             EventBus::getInstance().emit(evt);
 
-            // Continue to local callbacks if needed (compat)
-            for (const auto &[sub_topic, sub] : instance->subscribers_)
+            // les callbacks reçoivent un payload terminé par '\0'
+            int64_t start = esp_timer_get_time();
+            std::string payload(event->data, event->data_len);
+            std::string res = sub.callback(it->first.c_str(), payload.c_str(), payload.length());
+            if (!res.empty())
+                esp_mqtt_client_publish(instance->client_, sub.answer_topic.c_str(), res.c_str(), res.length(), 1, 0);
+            uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
             {
-                if (sub_topic == topic)
-                {
-                    std::string res = sub.callback(topic.c_str(), payload.c_str(), topic.length());
-                    if (!res.empty())
-                        esp_mqtt_client_publish(instance->client_, sub.answer_topic.c_str(), res.c_str(), res.length(), 1, 0);
-                }
+                std::lock_guard<std::mutex> mlock(instance->metrics_mutex_);
+                instance->metrics_.received++;
+                instance->metrics_.dispatch_us_sum += elapsed;
+                if (elapsed > instance->metrics_.dispatch_us_max)
+                    instance->metrics_.dispatch_us_max = elapsed;
             }
             break;
         }
@@ -304,6 +581,17 @@ private:
         }
     }
 
+    // QoS>0 hors connexion : mis en outbox, envoyé par le client à la reconnexion
+    bool enqueueOffline(const PublishMessage &msg)
+    {
+#ifdef CONFIG_IOT_MQTT_PERSISTENT_SESSION
+        return msg.qos > 0 && client_ &&
+               esp_mqtt_client_enqueue(client_, msg.topic, msg.payload, msg.payload_len, msg.qos, msg.retain, true) >= 0;
+#else
+        return false;
+#endif
+    }
+
     // Tâche de publication asynchrone
     static void publisher_task(void *arg)
     {
@@ -320,15 +608,25 @@ private:
                         instance.client_, msg.topic, msg.payload, msg.payload_len, msg.qos, msg.retain);
                     if (msg_id == -1)
                     {
+                        instance.countMetric(&Metrics::publish_failed);
                         ESP_LOGE(TAG, "Publish failed");
                     }
+                    else
+                    {
+                        instance.countMetric(&Metrics::published);
+                    }
                     // else
                     // {
                     //     ESP_LOGI(TAG, "Published msg_id=%d", msg_id);
                     // }
                 }
+                else if (instance.enqueueOffline(msg))
+                {
+                    instance.countMetric(&Metrics::offline_queued);
+                }
                 else
                 {
+                    instance.countMetric(&Metrics::offline_dropped);
                     ESP_LOGW(TAG, "MQTT disconnected, dropping message");
                 }
             }
@@ -383,6 +681,19 @@ private:
     {
         return persist::save_struct(MQTT_CFG_PATH, &mqtt_config, sizeof(mqtt_config));
     }
+    static void task_save_session(void)
+    {
+        xTaskCreate([](void *)
+                    { persist::save_struct(MQTT_SESSION_PATH, &session_state, sizeof(session_state)); vTaskDelete(nullptr); },
+                    "save_mqtt_sess", 3072, nullptr, tskIDLE_PRIORITY + 1, nullptr);
+    }
+    // Snapshot servi par GET /iot/mqtt
+    static void publish_snapshot()
+    {
+        char json[512];
+        if (mqtt_to_json(json, sizeof(json)))
+            snapshot::publish(snapshot::Key::MQTT_CONFIG, json, strlen(json));
+    }
     static bool mqtt_to_json(char *out_buf, size_t buf_len)
     {
         cJSON *root = cJSON_CreateObject();
@@ -449,102 +760,6 @@ private:
         return true;
     }
 
-    static bool mqtt_status_to_json(char *out_buf, size_t buf_len)
-    {
-        cJSON *root = cJSON_CreateObject();
-        if (!root)
-            return false;
-
-        // parcourir autoPublishers_
-
-        cJSON_AddBoolToObject(root, enabled_key, mqtt_config.enabled);
-        // 3) parcourir les publishers
-        cJSON *arr = cJSON_CreateArray();
-        if (!arr)
-        {
-            cJSON_Delete(root);
-            return false;
-        }
-        cJSON_AddItemToObject(root, "publishers", arr);
-
-        // si votre map est protégée par un mutex :
-        // ============================
-        // PUBLISHERS
-        // ============================
-        {
-            auto &instance = MqttClient::getInstance();
-
-            std::lock_guard<std::mutex> lock(instance.pub_mutex_);
-            for (auto const &[topic, pub] : instance.autoPublishers_)
-            {
-                // appeler le callback pour récupérer la valeur actuelle
-                std::string payload = pub.callback(topic.c_str());
-
-                // créer l’objet JSON pour ce publisher
-                cJSON *obj = cJSON_CreateObject();
-                if (!obj)
-                    continue; // en cas d’erreur on skip
-
-                cJSON_AddStringToObject(obj, "topic", topic.c_str());
-                cJSON_AddStringToObject(obj, "payload", payload.c_str());
-                cJSON_AddNumberToObject(obj, "interval_ms", pub.interval);
-                cJSON_AddNumberToObject(obj, "lastPub", pub.lastPub);
-
-                // ajouter dans le tableau
-                cJSON_AddItemToArray(arr, obj);
-            }
-        }
-        // ============================
-        // SUBSCRIBERS
-        // ============================
-        {
-            auto &instance = MqttClient::getInstance();
-            cJSON *arr = cJSON_CreateArray();
-            if (!arr)
-            {
-                cJSON_Delete(root);
-                return false;
-            }
-            cJSON_AddItemToObject(root, "subscribers", arr);
-
-            std::lock_guard<std::mutex> lock(instance.sub_mutex_);
-            for (auto const &[topic, sub] : instance.subscribers_)
-            {
-                cJSON *obj = cJSON_CreateObject();
-                if (!obj)
-                    continue;
-
-                cJSON_AddStringToObject(obj, "topic", topic.c_str());
-                cJSON_AddStringToObject(obj, "answer_topic", sub.answer_topic.c_str());
-
-                cJSON_AddBoolToObject(obj, "subscribed", sub.subscribed);
-
-                // Tu peux ajouter ici d'autres métadonnées si présentes dans SubscriberInfo,
-                // comme un timestamp, compteur, etc. Exemples :
-                // cJSON_AddNumberToObject(obj, "message_count", sub.counter);
-                // cJSON_AddStringToObject(obj, "source", sub.source_id);
-
-                cJSON_AddItemToArray(arr, obj);
-            }
-        }
-        // 4) transformer en string
-        char *json_string = cJSON_PrintUnformatted(root);
-        cJSON_Delete(root);
-        if (!json_string)
-            return false;
-
-        // 5) copier dans out_buf si ça rentre
-        bool success = false;
-        size_t len = strlen(json_string);
-        if (len < buf_len)
-        {
-            memcpy(out_buf, json_string, len + 1);
-            success = true;
-        }
-        cJSON_free(json_string);
-        return success;
-    }
-
     inline static bool flag_iot_hosts_registred = false;
 
     static void on_event(const Event *evt)
@@ -559,6 +774,9 @@ private:
             {
                 ESP_LOGI(TAG, "MQTT config loaded");
             }
+            publish_snapshot();
+            if (!persist::load_struct(MQTT_SESSION_PATH, &session_state, sizeof(session_state)))
+                session_state = {};
         }
         else if (evt->type == EventType::WIFI_STA_CONNECTED)
         {
@@ -640,35 +858,25 @@ private:
         {
             if (evt->user_ctx)
             {
-                // 1) parser le JSON (evt.data, evt.data_len)
-                const char *json = reinterpret_cast<const char *>(evt->user_ctx);
-                // ex : sta_from_json(json);
-
-                // 2) appliquer la config Wi-Fi, écrire en flash…
+                // 1) corps référencé dans le pool HTTP (user_ctx est la queue de réponse)
+                const char *json = utils::event_body(evt, nullptr);
 
-                if (mqtt_from_json(json, mqtt_config))
+                // 2) appliquer la config, écrire en flash…
+                if (json && mqtt_from_json(json, mqtt_config))
                 {
+                    publish_snapshot();
                     task_save_mqtt();
                 }
-                // 3) envoyer l’ack
+                // 3) envoyer l’ack : la config effective
                 Event resp_evt{};
-                BIND_DATA_EVENT_JSON(resp_evt, json);
+                char answer[512];
+                if (!mqtt_to_json(answer, sizeof(answer)))
+                    strcpy(answer, "{}");
+                BIND_DATA_EVENT_JSON(resp_evt, answer);
                 resp_evt.type = EventType::MQTT_POST_ANSWER;
                 xQueueSend((QueueHandle_t)evt->user_ctx, &resp_evt, 0);
             }
         }
-        else if (evt->type == EventType::MQTT_STATUS_REQUEST_JSON)
-        {
-            if (evt->user_ctx)
-            {
-                Event resp_evt = {};
-                char json[512];
-                mqtt_status_to_json(json, sizeof(json));
-                BIND_DATA_EVENT_JSON(resp_evt, json);
-                resp_evt.type = EventType::MQTT_STATUS_ANSWER_JSON; // Envoie la réponse
-                xQueueSend((QueueHandle_t)evt->user_ctx, &resp_evt, 0);
-            }
-        }
     }
 
     struct register_event_bus
@@ -681,6 +889,8 @@ private:
 
     inline static register_event_bus register_event_bus_;
 
+    inline static mqtt_session_state_t session_state = {};
+
     inline static mqtt_client_config_t mqtt_config = {
         .broker_uri = CONFIG_IOT_MQTT_BROKER_URI,
         .username = CONFIG_IOT_MQTT_BROKER_USERNAME,
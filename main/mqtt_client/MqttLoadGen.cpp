@@ -0,0 +1,212 @@
+#include "MqttLoadGen.h"
+#ifdef CONFIG_IOT_MQTT_LOADGEN_ENABLE
+#include <cstdlib>
+#include <cstring>
+#include "MqttClient.hpp"
+#include "MqttRpc.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "utils.h"
+
+MqttLoadGen &MqttLoadGen::getInstance()
+{
+    static MqttLoadGen instance;
+    return instance;
+}
+
+static uint32_t param_u32(const cJSON *params, const char *key, uint32_t def, uint32_t min, uint32_t max)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(params, key);
+    if (!cJSON_IsNumber(item))
+        return def;
+    if (item->valuedouble < min)
+        return min;
+    if (item->valuedouble > max)
+        return max;
+    return (uint32_t)item->valuedouble;
+}
+
+void MqttLoadGen::start()
+{
+    if (started_)
+        return;
+
+    topic_ = std::string(CONFIG_IOT_MQTT_LOADGEN_TOPIC) + "/" + utils::device_id();
+    MqttClient::getInstance().registerSubscriber(topic_.c_str(), nullptr,
+                                                 [](const char *, const char *payload, int len) -> std::string
+                                                 {
+                                                     MqttLoadGen::getInstance().onLoopback(payload, len);
+                                                     return "";
+                                                 });
+
+    auto &rpc = MqttRpc::getInstance();
+    rpc.registerMethod("mqtt.load.start", [this](const cJSON *params, cJSON *result)
+                       { return begin(params, result); });
+    rpc.registerMethod("mqtt.load.result", [this](const cJSON *, cJSON *result)
+                       { resultToJson(result); return ESP_OK; });
+
+    started_ = true;
+}
+
+esp_err_t MqttLoadGen::begin(const cJSON *params, cJSON *result)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (result_.running)
+        return ESP_ERR_INVALID_STATE;
+
+    params_.rate_hz = param_u32(params, "rate_hz", 20, 1, 1000);
+    params_.duration_s = param_u32(params, "duration_s", 10, 1, 600);
+    params_.size = param_u32(params, "size", 64, 32, CONFIG_IOT_MQTT_PUBLISH_PAYLOAD_MAX - 1);
+    params_.qos = (int)param_u32(params, "qos", 1, 0, 1);
+    params_.reconnects = param_u32(params, "reconnects", 0, 0, 100);
+
+    result_ = {};
+    result_.running = true;
+    result_.heap_min = esp_get_free_heap_size();
+    last_seq_ = 0;
+    run_id_++;
+    MqttClient::getInstance().resetMetrics();
+
+    if (xTaskCreate(load_task, "mqtt_load", 4096, this, 4, nullptr) != pdPASS)
+    {
+        result_.running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    cJSON_AddNumberToObject(result, "run", run_id_);
+    cJSON_AddStringToObject(result, "topic", topic_.c_str());
+    return ESP_OK;
+}
+
+// Payload : {"run":R,"seq":N,"t":<us>,"pad":"xxx..."} complété jusqu'à size
+void MqttLoadGen::load_task(void *arg)
+{
+    auto &self = *static_cast<MqttLoadGen *>(arg);
+    auto &client = MqttClient::getInstance();
+
+    Params p;
+    uint32_t run;
+    {
+        std::lock_guard<std::mutex> lock(self.mutex_);
+        p = self.params_;
+        run = self.run_id_;
+    }
+
+    char payload[CONFIG_IOT_MQTT_PUBLISH_PAYLOAD_MAX];
+    TickType_t period = pdMS_TO_TICKS(1000 / p.rate_hz);
+    if (period == 0) // au-delà de la fréquence du tick : une publication par tick
+        period = 1;
+    const uint32_t total = p.rate_hz * p.duration_s;
+    const uint32_t reconnect_every = p.reconnects ? total / (p.reconnects + 1) : 0;
+    int64_t start = esp_timer_get_time();
+    TickType_t wake = xTaskGetTickCount();
+
+    for (uint32_t seq = 1; seq <= total; ++seq)
+    {
+        int n = snprintf(payload, sizeof(payload), "{\"run\":%lu,\"seq\":%lu,\"t\":%lld,\"pad\":\"",
+                         (unsigned long)run, (unsigned long)seq, (long long)esp_timer_get_time());
+        while (n < (int)p.size - 2)
+            payload[n++] = 'x';
+        payload[n++] = '"';
+        payload[n++] = '}';
+        payload[n] = '\0';
+
+        bool ok = client.publish(self.topic_.c_str(), payload, p.qos, false);
+
+        uint32_t heap = esp_get_free_heap_size();
+        {
+            std::lock_guard<std::mutex> lock(self.mutex_);
+            ok ? self.result_.sent++ : self.result_.rejected++;
+            if (heap < self.result_.heap_min)
+                self.result_.heap_min = heap;
+        }
+
+        if (reconnect_every && seq % reconnect_every == 0)
+        {
+            ESP_LOGI(TAG, "Forced reconnect at seq %lu", (unsigned long)seq);
+            client.forceReconnect();
+        }
+        vTaskDelayUntil(&wake, period);
+    }
+
+    // laisse le temps aux derniers messages de revenir
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    {
+        std::lock_guard<std::mutex> lock(self.mutex_);
+        self.result_.running = false;
+        self.result_.elapsed_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    }
+    ESP_LOGI(TAG, "Run %lu done", (unsigned long)run);
+    vTaskDelete(nullptr);
+}
+
+// Appelé depuis la tâche MQTT
+void MqttLoadGen::onLoopback(const char *payload, int len)
+{
+    size_t v_len = 0;
+    const char *run = utils::json_peek_raw(payload, len, "run", &v_len);
+    const char *seq = utils::json_peek_raw(payload, len, "seq", &v_len);
+    const char *t = utils::json_peek_raw(payload, len, "t", &v_len);
+    if (!run || !seq || !t)
+        return;
+
+    int64_t now = esp_timer_get_time();
+    uint32_t latency = (uint32_t)(now - strtoll(t, nullptr, 10));
+    uint32_t n = strtoul(seq, nullptr, 10);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (strtoul(run, nullptr, 10) != run_id_)
+        return; // message retenu par le broker d'un run précédent
+    result_.received++;
+    if (n <= last_seq_)
+        result_.out_of_order++;
+    else
+        last_seq_ = n;
+    result_.latency_us_sum += latency;
+    if (latency > result_.latency_us_max)
+        result_.latency_us_max = latency;
+}
+
+void MqttLoadGen::resultToJson(cJSON *out)
+{
+    Result r;
+    Params p;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        r = result_;
+        p = params_;
+    }
+    MqttClient::Metrics m = MqttClient::getInstance().getMetrics();
+
+    cJSON_AddNumberToObject(out, "run", run_id_);
+    cJSON_AddBoolToObject(out, "running", r.running);
+    cJSON_AddNumberToObject(out, "rate_hz", p.rate_hz);
+    cJSON_AddNumberToObject(out, "size", p.size);
+    cJSON_AddNumberToObject(out, "sent", r.sent);
+    cJSON_AddNumberToObject(out, "rejected", r.rejected);
+    cJSON_AddNumberToObject(out, "received", r.received);
+    cJSON_AddNumberToObject(out, "lost", r.sent > r.received ? r.sent - r.received : 0);
+    cJSON_AddNumberToObject(out, "out_of_order", r.out_of_order);
+    cJSON_AddNumberToObject(out, "rate_achieved", r.elapsed_ms ? (double)r.sent * 1000 / r.elapsed_ms : 0);
+    cJSON_AddNumberToObject(out, "latency_avg_us", r.received ? (double)(r.latency_us_sum / r.received) : 0);
+    cJSON_AddNumberToObject(out, "latency_max_us", r.latency_us_max);
+    cJSON_AddNumberToObject(out, "heap_min", r.heap_min);
+
+    cJSON *client = cJSON_AddObjectToObject(out, "client");
+    cJSON_AddNumberToObject(client, "published", m.published);
+    cJSON_AddNumberToObject(client, "publish_failed", m.publish_failed);
+    cJSON_AddNumberToObject(client, "queue_dropped", m.queue_dropped);
+    cJSON_AddNumberToObject(client, "offline_queued", m.offline_queued);
+    cJSON_AddNumberToObject(client, "offline_dropped", m.offline_dropped);
+    cJSON_AddNumberToObject(client, "dispatch_max_us", m.dispatch_us_max);
+    cJSON_AddNumberToObject(client, "disconnects", m.disconnects);
+    cJSON_AddNumberToObject(client, "heap_min", m.heap_min);
+}
+
+void MqttLoadGen::on_event(const Event *evt)
+{
+    if (evt->type == EventType::BOOT_CAN_START)
+        MqttLoadGen::getInstance().start();
+}
+
+#endif // CONFIG_IOT_MQTT_LOADGEN_ENABLE
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef __MQTT_LOAD_GEN_H__
+#define __MQTT_LOAD_GEN_H__
+#include "sdkconfig.h"
+#ifdef CONFIG_IOT_MQTT_LOADGEN_ENABLE
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "cJSON.h"
+#include "esp_err.h"
+#include "event_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * Générateur de charge MQTT embarqué, piloté par RPC.
+ *
+ *  mqtt.load.start  {"rate_hz":50,"duration_s":10,"size":128,"qos":1,"reconnects":0}
+ *  mqtt.load.result -> compteurs du dernier run
+ *
+ * Les messages sont publiés sur <topic>/<device_id>, topic auquel le noeud est
+ * lui-même abonné : on mesure le débit soutenu, la latence aller-retour broker,
+ * les pertes (queue pleine, hors connexion) et le heap minimal, y compris
+ * pendant des reconnexions forcées.
+ */
+class MqttLoadGen final
+{
+public:
+    static constexpr const char *TAG = "[MQTT_LOAD]";
+
+    static MqttLoadGen &getInstance();
+    MqttLoadGen(const MqttLoadGen &) = delete;
+    MqttLoadGen &operator=(const MqttLoadGen &) = delete;
+
+private:
+    struct Params
+    {
+        uint32_t rate_hz;
+        uint32_t duration_s;
+        uint32_t size;
+        int qos;
+        uint32_t reconnects;
+    };
+
+    struct Result
+    {
+        bool running;
+        uint32_t sent;
+        uint32_t rejected; // publish() refusé (queue pleine)
+        uint32_t received;
+        uint32_t out_of_order;
+        uint64_t latency_us_sum;
+        uint32_t latency_us_max;
+        uint32_t heap_min;
+        uint32_t elapsed_ms;
+    };
+
+    MqttLoadGen() = default;
+
+    void start();
+    esp_err_t begin(const cJSON *params, cJSON *result);
+    void onLoopback(const char *payload, int len);
+    void resultToJson(cJSON *out);
+
+    static void load_task(void *arg);
+    static void on_event(const Event *evt);
+
+    std::mutex mutex_;
+    std::string topic_;
+    bool started_ = false;
+    Params params_ = {};
+    Result result_ = {};
+    uint32_t last_seq_ = 0;
+    uint32_t run_id_ = 0;
+
+    struct register_event_bus
+    {
+        register_event_bus()
+        {
+            EventBus::getInstance().subscribe(on_event, TAG);
+        }
+    };
+    inline static register_event_bus register_event_bus_;
+};
+
+#endif // CONFIG_IOT_MQTT_LOADGEN_ENABLE
+#endif
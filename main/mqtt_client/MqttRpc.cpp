@@ -0,0 +1,371 @@
+#include "MqttRpc.h"
+#ifdef CONFIG_IOT_MQTT_RPC_ENABLE
+#include "MqttClient.hpp"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "utils.h"
+#include <cstring>
+
+static constexpr uint64_t SWEEP_PERIOD_US = 100 * 1000;
+static constexpr size_t RESPONSE_PREFIX_LEN = sizeof(CONFIG_IOT_MQTT_RPC_RESPONSE_TOPIC) - 1;
+
+// reply_to accepté : IOT_MQTT_RPC_RESPONSE_TOPIC/<suffixe>, sans joker
+static bool reply_topic_allowed(const char *topic)
+{
+    return strncmp(topic, CONFIG_IOT_MQTT_RPC_RESPONSE_TOPIC, RESPONSE_PREFIX_LEN) == 0 &&
+           topic[RESPONSE_PREFIX_LEN] == '/' && topic[RESPONSE_PREFIX_LEN + 1] != '\0' &&
+           !strpbrk(topic, "+#");
+}
+
+MqttRpc &MqttRpc::getInstance()
+{
+    static MqttRpc instance;
+    return instance;
+}
+
+void MqttRpc::registerMethod(const char *name, Handler handler, uint32_t timeout_ms)
+{
+    if (!name || strlen(name) >= MAX_METHOD_LEN)
+    {
+        ESP_LOGE(TAG, "Invalid method name");
+        return;
+    }
+    std::lock_guard<std::mutex> lock(methods_mutex_);
+    methods_[std::string(name)] = Method{handler, timeout_ms};
+}
+
+bool MqttRpc::hasMethod(const char *name)
+{
+    std::lock_guard<std::mutex> lock(methods_mutex_);
+    return methods_.find(name) != methods_.end();
+}
+
+void MqttRpc::start()
+{
+    if (started_)
+        return;
+
+    snprintf(request_topic_, sizeof(request_topic_), "%s/%s", CONFIG_IOT_MQTT_RPC_REQUEST_TOPIC, utils::device_id());
+    snprintf(response_topic_, sizeof(response_topic_), "%s/%s", CONFIG_IOT_MQTT_RPC_RESPONSE_TOPIC, utils::device_id());
+    work_queue_ = xQueueCreate(MAX_INFLIGHT, sizeof(uint8_t));
+    timeout_queue_ = xQueueCreate(MAX_INFLIGHT, sizeof(Expired));
+    if (!work_queue_ || !timeout_queue_)
+    {
+        ESP_LOGE(TAG, "Queue creation failed");
+        return;
+    }
+    for (int i = 0; i < CONFIG_IOT_MQTT_RPC_WORKERS; ++i)
+        xTaskCreate(worker_task, "mqtt_rpc_worker", CONFIG_IOT_MQTT_RPC_STACK_SIZE, this, 5, nullptr);
+    xTaskCreate(timeout_task, "mqtt_rpc_timeout", CONFIG_IOT_MQTT_RPC_STACK_SIZE, this, 5, nullptr);
+
+    // délais suivis hors des workers : un handler lent ne retarde pas le TIMEOUT des autres
+    esp_timer_create_args_t args = {};
+    args.callback = sweep_timer_cb;
+    args.arg = this;
+    args.name = "rpc_sweep";
+    if (esp_timer_create(&args, &sweep_timer_) != ESP_OK ||
+        esp_timer_start_periodic(sweep_timer_, SWEEP_PERIOD_US) != ESP_OK)
+        ESP_LOGE(TAG, "Timeout sweep timer failed");
+
+    registerMethod("rpc.list", [this](const cJSON *, cJSON *result)
+                   {
+                       cJSON *arr = cJSON_AddArrayToObject(result, "methods");
+                       std::lock_guard<std::mutex> lock(methods_mutex_);
+                       for (auto const &[name, m] : methods_)
+                           cJSON_AddItemToArray(arr, cJSON_CreateString(name.c_str()));
+                       return ESP_OK; });
+    registerMethod("rpc.stats", [this](const cJSON *, cJSON *result)
+                   { return statsToJson(result) ? ESP_OK : ESP_FAIL; });
+
+    MqttClient::getInstance().registerSubscriber(
+        request_topic_, nullptr,
+        [](const char *, const char *payload, int len) -> std::string
+        {
+            MqttRpc::getInstance().onRequest(payload, len);
+            return ""; // la réponse part par la queue de publication
+        });
+
+    started_ = true;
+    ESP_LOGI(TAG, "RPC listening on %s", request_topic_);
+}
+
+// Appelé depuis la tâche MQTT : aucune allocation cJSON ici
+void MqttRpc::onRequest(const char *payload, size_t len)
+{
+    char id[MAX_ID_LEN] = {};
+    char method[MAX_METHOD_LEN] = {};
+    char reply_to[MAX_TOPIC_LEN];
+    memcpy(reply_to, response_topic_, sizeof(reply_to));
+
+    // id : nombre ou string, recopié brut pour l'écho dans la réponse
+    size_t id_len = 0;
+    const char *raw_id = utils::json_peek_raw(payload, len, "id", &id_len);
+    if (raw_id && id_len < sizeof(id) && (raw_id[0] == '"' || raw_id[0] == '-' || (raw_id[0] >= '0' && raw_id[0] <= '9')))
+    {
+        memcpy(id, raw_id, id_len);
+        id[id_len] = '\0';
+    }
+    if (utils::json_peek_string(payload, len, "reply_to", reply_to, sizeof(reply_to)) && !reply_topic_allowed(reply_to))
+    {
+        memcpy(reply_to, response_topic_, sizeof(reply_to));
+        return reject(id, reply_to, INVALID_REQUEST, "reply_to outside " CONFIG_IOT_MQTT_RPC_RESPONSE_TOPIC "/");
+    }
+
+    if (len > CONFIG_IOT_MQTT_RPC_MAX_PAYLOAD)
+        return reject(id, reply_to, TOO_LARGE, "Request too large");
+
+    if (!utils::json_peek_string(payload, len, "method", method, sizeof(method)))
+        return reject(id, reply_to, INVALID_REQUEST, "Missing method");
+
+    uint32_t timeout_ms;
+    {
+        std::lock_guard<std::mutex> lock(methods_mutex_);
+        auto it = methods_.find(method);
+        if (it == methods_.end())
+            return reject(id, reply_to, METHOD_NOT_FOUND, "Method not found");
+        timeout_ms = it->second.timeout_ms;
+    }
+
+    uint8_t index = MAX_INFLIGHT;
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        uint32_t busy = 0;
+        for (uint8_t i = 0; i < MAX_INFLIGHT; ++i)
+        {
+            if (slots_[i].state != SlotState::FREE)
+                ++busy;
+            else if (index == MAX_INFLIGHT)
+                index = i;
+        }
+        if (index != MAX_INFLIGHT)
+        {
+            Slot &slot = slots_[index];
+            slot.state = SlotState::QUEUED;
+            slot.replied = false;
+            memcpy(slot.id, id, sizeof(slot.id));
+            memcpy(slot.method, method, sizeof(slot.method));
+            memcpy(slot.reply_to, reply_to, sizeof(slot.reply_to));
+            slot.payload.assign(payload, len);
+            slot.received_us = esp_timer_get_time();
+            slot.deadline_us = slot.received_us + (int64_t)timeout_ms * 1000;
+            stats_.calls++;
+            if (busy + 1 > stats_.inflight_peak)
+                stats_.inflight_peak = busy + 1;
+        }
+    }
+    if (index == MAX_INFLIGHT)
+        return reject(id, reply_to, BUSY, "Too many in-flight requests");
+
+    if (xQueueSend(work_queue_, &index, 0) != pdTRUE)
+    {
+        {
+            std::lock_guard<std::mutex> lock(slots_mutex_);
+            slots_[index].state = SlotState::FREE;
+            slots_[index].payload.clear();
+            stats_.calls--;
+        }
+        reject(id, reply_to, BUSY, "Worker queue full");
+    }
+}
+
+void MqttRpc::run(uint8_t index)
+{
+    Slot &slot = slots_[index];
+    char id[MAX_ID_LEN];
+    char reply_to[MAX_TOPIC_LEN];
+    Method method;
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        if (slot.replied) // expiré dans la queue
+        {
+            slot.state = SlotState::FREE;
+            slot.payload.clear();
+            return;
+        }
+        slot.state = SlotState::RUNNING;
+        memcpy(id, slot.id, sizeof(id));
+        memcpy(reply_to, slot.reply_to, sizeof(reply_to));
+
+        std::lock_guard<std::mutex> mlock(methods_mutex_);
+        auto it = methods_.find(slot.method);
+        if (it != methods_.end())
+            method = it->second;
+    }
+
+    int code = 0;
+    const char *message = nullptr;
+    char *result_str = nullptr;
+
+    cJSON *root = cJSON_ParseWithLength(slot.payload.data(), slot.payload.size());
+    if (!root || !cJSON_IsObject(root))
+    {
+        code = PARSE_ERROR;
+        message = "Parse error";
+    }
+    else if (!method.handler)
+    {
+        code = METHOD_NOT_FOUND;
+        message = "Method not found";
+    }
+    else
+    {
+        cJSON *result = cJSON_CreateObject();
+        esp_err_t err = method.handler(cJSON_GetObjectItemCaseSensitive(root, "params"), result);
+        if (err == ESP_OK)
+            result_str = cJSON_PrintUnformatted(result);
+        else
+        {
+            code = (err == ESP_ERR_INVALID_ARG) ? INVALID_PARAMS : INTERNAL_ERROR;
+            message = esp_err_to_name(err);
+        }
+        cJSON_Delete(result);
+    }
+    if (root)
+        cJSON_Delete(root);
+
+    bool send = false;
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        if (!slot.replied)
+        {
+            slot.replied = true;
+            send = true;
+            uint32_t latency = (uint32_t)(esp_timer_get_time() - slot.received_us);
+            stats_.latency_sum_us += latency;
+            if (latency > stats_.latency_max_us)
+                stats_.latency_max_us = latency;
+            if (code == 0)
+                stats_.ok++;
+            else
+                stats_.errors++;
+        }
+        slot.state = SlotState::FREE;
+        slot.payload.clear();
+    }
+
+    if (send)
+    {
+        if (code == 0)
+        {
+            std::string body = "\"result\":";
+            body += result_str ? result_str : "{}";
+            sendReply(id, reply_to, body.c_str());
+        }
+        else
+        {
+            reject(id, reply_to, code, message);
+        }
+    }
+    if (result_str)
+        cJSON_free(result_str);
+}
+
+// Tâche esp_timer : marque les appels expirés, sans publier ni attendre
+void MqttRpc::sweepTimeouts()
+{
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    for (auto &slot : slots_)
+    {
+        if (slot.state == SlotState::FREE || slot.replied || now < slot.deadline_us)
+            continue;
+        // Le slot reste occupé jusqu'à la fin du handler ; seule la réponse part maintenant
+        slot.replied = true;
+        stats_.timeouts++;
+        Expired expired;
+        memcpy(expired.id, slot.id, sizeof(slot.id));
+        memcpy(expired.reply_to, slot.reply_to, sizeof(slot.reply_to));
+        if (xQueueSend(timeout_queue_, &expired, 0) != pdTRUE)
+            ESP_LOGW(TAG, "Timeout reply for %s dropped", slot.id[0] ? slot.id : "-");
+    }
+}
+
+void MqttRpc::reject(const char *id, const char *reply_to, int code, const char *message)
+{
+    if (code == BUSY || code == TOO_LARGE || code == METHOD_NOT_FOUND || code == INVALID_REQUEST)
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        stats_.rejected++;
+    }
+    char body[128];
+    snprintf(body, sizeof(body), "\"error\":{\"code\":%d,\"message\":\"%s\"}", code, message ? message : "");
+    sendReply(id, reply_to, body);
+}
+
+void MqttRpc::sendReply(const char *id, const char *reply_to, const char *body)
+{
+    if (!id[0]) // notification : pas de réponse
+        return;
+
+    std::string out = "{\"id\":";
+    out += id;
+    out += ',';
+    out += body;
+    out += '}';
+    if (!MqttClient::getInstance().publish(reply_to, out.c_str(), 1, false))
+        ESP_LOGW(TAG, "Reply to %s dropped", id);
+}
+
+bool MqttRpc::statsToJson(cJSON *result)
+{
+    Stats s;
+    uint32_t inflight = 0;
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        s = stats_;
+        for (auto &slot : slots_)
+            if (slot.state != SlotState::FREE)
+                ++inflight;
+    }
+    uint32_t done = s.ok + s.errors;
+    cJSON_AddNumberToObject(result, "calls", s.calls);
+    cJSON_AddNumberToObject(result, "ok", s.ok);
+    cJSON_AddNumberToObject(result, "errors", s.errors);
+    cJSON_AddNumberToObject(result, "rejected", s.rejected);
+    cJSON_AddNumberToObject(result, "timeouts", s.timeouts);
+    cJSON_AddNumberToObject(result, "inflight", inflight);
+    cJSON_AddNumberToObject(result, "inflight_peak", s.inflight_peak);
+    cJSON_AddNumberToObject(result, "latency_avg_us", done ? (double)(s.latency_sum_us / done) : 0);
+    cJSON_AddNumberToObject(result, "latency_max_us", s.latency_max_us);
+    return true;
+}
+
+void MqttRpc::worker_task(void *arg)
+{
+    auto &instance = *static_cast<MqttRpc *>(arg);
+    uint8_t index;
+
+    while (true)
+    {
+        if (xQueueReceive(instance.work_queue_, &index, portMAX_DELAY) == pdTRUE && index < MAX_INFLIGHT)
+            instance.run(index);
+    }
+}
+
+void MqttRpc::timeout_task(void *arg)
+{
+    auto &instance = *static_cast<MqttRpc *>(arg);
+    Expired expired;
+
+    while (true)
+    {
+        if (xQueueReceive(instance.timeout_queue_, &expired, portMAX_DELAY) != pdTRUE)
+            continue;
+        ESP_LOGW(TAG, "Call %s timed out", expired.id[0] ? expired.id : "-");
+        instance.reject(expired.id, expired.reply_to, TIMEOUT, "Timeout");
+    }
+}
+
+void MqttRpc::sweep_timer_cb(void *arg)
+{
+    static_cast<MqttRpc *>(arg)->sweepTimeouts();
+}
+
+void MqttRpc::on_event(const Event *evt)
+{
+    if (evt->type == EventType::BOOT_CAN_START)
+        MqttRpc::getInstance().start();
+}
+
+#endif // CONFIG_IOT_MQTT_RPC_ENABLE
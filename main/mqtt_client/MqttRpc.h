@@ -0,0 +1,161 @@
+#pragma once
+#ifndef __MQTT_RPC_H__
+#define __MQTT_RPC_H__
+#include "sdkconfig.h"
+#ifdef CONFIG_IOT_MQTT_RPC_ENABLE
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include "cJSON.h"
+#include "esp_err.h"
+#include "event_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+
+/**
+ * Couche RPC au-dessus de MqttClient.
+ *
+ * Requête  : {"id":1,"method":"led.set","params":{...},"reply_to":"topic"}
+ * Réponse  : {"id":1,"result":{...}} ou {"id":1,"error":{"code":-32601,"message":"..."}}
+ *
+ * Les requêtes sont lues sur IOT_MQTT_RPC_REQUEST_TOPIC/<device_id> : chaque
+ * nœud n'exécute que les appels qui lui sont adressés. reply_to doit rester
+ * sous IOT_MQTT_RPC_RESPONSE_TOPIC/ (sinon INVALID_REQUEST) : un émetteur ne
+ * peut pas faire publier le nœud sur un topic d'actionneur.
+ *
+ * Le payload est pré-analysé sans allocation (méthode, id, reply_to) : les requêtes
+ * inconnues, trop grosses ou en surnombre sont rejetées avant tout cJSON_Parse.
+ * Les appels acceptés occupent un slot "in-flight" et sont exécutés par un pool de
+ * workers ; un appel qui dépasse son délai reçoit une erreur TIMEOUT : un timer
+ * esp_timer marque l'appel expiré et une tâche dédiée publie la réponse, qui
+ * part même si tous les workers sont bloqués (aucune publication, donc aucune
+ * attente sur la queue MqttClient, dans la tâche esp_timer).
+ * Les réponses passent par MqttClient::publish (queue asynchrone).
+ */
+class MqttRpc final
+{
+public:
+    static constexpr const char *TAG = "[RPC]";
+
+    // Codes d'erreur (JSON-RPC 2.0 + codes serveur)
+    enum ErrorCode : int
+    {
+        PARSE_ERROR = -32700,
+        INVALID_REQUEST = -32600,
+        METHOD_NOT_FOUND = -32601,
+        INVALID_PARAMS = -32602,
+        INTERNAL_ERROR = -32603,
+        BUSY = -32000,
+        TIMEOUT = -32001,
+        TOO_LARGE = -32002,
+    };
+
+    // params peut être nullptr ; result est un objet vide à remplir.
+    // ESP_ERR_INVALID_ARG -> INVALID_PARAMS, autre erreur -> INTERNAL_ERROR
+    using Handler = std::function<esp_err_t(const cJSON *params, cJSON *result)>;
+
+    static MqttRpc &getInstance();
+    MqttRpc(const MqttRpc &) = delete;
+    MqttRpc &operator=(const MqttRpc &) = delete;
+
+    void registerMethod(const char *name, Handler handler, uint32_t timeout_ms = CONFIG_IOT_MQTT_RPC_TIMEOUT_MS);
+    bool hasMethod(const char *name);
+
+    // Point d'entrée brut (utilisé par l'abonnement MQTT)
+    void onRequest(const char *payload, size_t len);
+
+private:
+    static constexpr size_t MAX_INFLIGHT = CONFIG_IOT_MQTT_RPC_MAX_INFLIGHT;
+    static constexpr size_t MAX_METHOD_LEN = 32;
+    static constexpr size_t MAX_ID_LEN = 24;
+    static constexpr size_t MAX_TOPIC_LEN = 64;
+
+    struct Method
+    {
+        Handler handler;
+        uint32_t timeout_ms;
+    };
+
+    enum class SlotState : uint8_t
+    {
+        FREE,
+        QUEUED,
+        RUNNING,
+    };
+
+    struct Slot
+    {
+        SlotState state;
+        bool replied;
+        char id[MAX_ID_LEN];         // token brut, renvoyé tel quel (vide = notification)
+        char method[MAX_METHOD_LEN];
+        char reply_to[MAX_TOPIC_LEN];
+        std::string payload;
+        int64_t received_us;
+        int64_t deadline_us;
+    };
+
+    // TIMEOUT à publier, copié hors du slot (qui reste occupé jusqu'à la fin du handler)
+    struct Expired
+    {
+        char id[MAX_ID_LEN];
+        char reply_to[MAX_TOPIC_LEN];
+    };
+
+    struct Stats
+    {
+        uint32_t calls;
+        uint32_t ok;
+        uint32_t errors;
+        uint32_t rejected;
+        uint32_t timeouts;
+        uint32_t inflight_peak;
+        uint64_t latency_sum_us;
+        uint32_t latency_max_us;
+    };
+
+    MqttRpc() = default;
+
+    void start();
+    void run(uint8_t index);
+    void sweepTimeouts();
+    void reject(const char *id, const char *reply_to, int code, const char *message);
+    void sendReply(const char *id, const char *reply_to, const char *body);
+    bool statsToJson(cJSON *result);
+
+    static void worker_task(void *arg);
+    static void sweep_timer_cb(void *arg);
+    static void timeout_task(void *arg);
+    static void on_event(const Event *evt);
+
+    char request_topic_[MAX_TOPIC_LEN] = {};
+    char response_topic_[MAX_TOPIC_LEN] = {}; // réponse par défaut
+
+    QueueHandle_t work_queue_ = nullptr;
+    esp_timer_handle_t sweep_timer_ = nullptr;
+    QueueHandle_t timeout_queue_ = nullptr; // Expired, du timer vers timeout_task
+    bool started_ = false;
+
+    std::mutex methods_mutex_;
+    std::map<std::string, Method> methods_;
+
+    std::mutex slots_mutex_;
+    Slot slots_[MAX_INFLIGHT] = {};
+    Stats stats_ = {};
+
+    struct register_event_bus
+    {
+        register_event_bus()
+        {
+            EventBus::getInstance().subscribe(on_event, TAG);
+        }
+    };
+    inline static register_event_bus register_event_bus_;
+};
+
+#endif // CONFIG_IOT_MQTT_RPC_ENABLE
+#endif
@@ -4,15 +4,23 @@
 #include "esp_ota_ops.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <cstring>
 
 static constexpr const char* TAG = "[OTA]";
 
 namespace ota_manager
 {
+    // L'URL appartenait au buffer de pile du handler HTTP : recopiée ici
+    static char s_url[512];
+    static bool s_running = false;
+
     static void ota_task(void* param)
     {
         const char* url = static_cast<const char*>(param);
+        esp_http_client_config_t http_config = {};
+        http_config.url = url;
         esp_https_ota_config_t config = {};
+        config.http_config = &http_config;
         
         ESP_LOGI(TAG, "Starting OTA from: %s", url);
 
@@ -27,14 +35,24 @@ namespace ota_manager
         {
             ESP_LOGE(TAG, "OTA failed: %s", esp_err_to_name(ret));
         }
+        s_running = false;
 
         vTaskDelete(nullptr);
     }
 
     void start_update(const char* url)
     {
+        if (s_running)
+        {
+            ESP_LOGW(TAG, "OTA already running");
+            return;
+        }
+        strncpy(s_url, url, sizeof(s_url) - 1);
+        s_url[sizeof(s_url) - 1] = '\0';
+        s_running = true;
         // On lance la tâche OTA
-        xTaskCreate(ota_task, "ota_task", 8192, (void*)url, 5, nullptr);
+        if (xTaskCreate(ota_task, "ota_task", 8192, s_url, 5, nullptr) != pdPASS)
+            s_running = false;
     }
 
     void validate_image()
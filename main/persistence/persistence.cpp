@@ -1,6 +1,65 @@
 #include "persistence.h"
+#include <cstring>
+#include <unistd.h>
+#include "esp_log.h"
 
 namespace persist
 {
-   
+    static constexpr const char *TAG = "[PERSIST]";
+
+    void Batch::add(const char *path, const void *obj, size_t size)
+    {
+        Entry e;
+        strncpy(e.path, path, sizeof(e.path) - 1);
+        e.path[sizeof(e.path) - 1] = '\0';
+        const uint8_t *bytes = static_cast<const uint8_t *>(obj);
+        e.data.assign(bytes, bytes + size);
+        entries_.push_back(std::move(e));
+    }
+
+    static void tmp_path(const char *path, char *out, size_t len)
+    {
+        snprintf(out, len, "%s%s", path, TMP_SUFFIX);
+    }
+
+    bool Batch::commit()
+    {
+        char tmp[MAX_PATH_LEN + 8];
+        // phase 1 : toutes les données sur le support
+        for (size_t i = 0; i < entries_.size(); ++i)
+        {
+            tmp_path(entries_[i].path, tmp, sizeof(tmp));
+            FILE *f = fopen(tmp, "wb");
+            bool ok = f && fwrite(entries_[i].data.data(), 1, entries_[i].data.size(), f) == entries_[i].data.size();
+            if (f)
+                ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+            if (f)
+                ok = fclose(f) == 0 && ok;
+            if (!ok)
+            {
+                ESP_LOGE(TAG, "Write failed: %s", tmp);
+                for (size_t j = 0; j <= i; ++j)
+                {
+                    tmp_path(entries_[j].path, tmp, sizeof(tmp));
+                    unlink(tmp);
+                }
+                return false;
+            }
+        }
+
+        // phase 2 : remplacement (FAT refuse de renommer vers un fichier existant)
+        bool ok = true;
+        for (const auto &e : entries_)
+        {
+            tmp_path(e.path, tmp, sizeof(tmp));
+            unlink(e.path);
+            if (rename(tmp, e.path) != 0)
+            {
+                ESP_LOGE(TAG, "Rename failed: %s", e.path);
+                ok = false;
+            }
+        }
+        ESP_LOGI(TAG, "Committed %u files", (unsigned)entries_.size());
+        return ok;
+    }
 }
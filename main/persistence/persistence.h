@@ -3,14 +3,26 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <vector>
 
 namespace persist
 {
+    static constexpr const char *TMP_SUFFIX = ".tmp";
+    static constexpr size_t MAX_PATH_LEN = 64;
+
     static inline bool load_struct(const char *path, void *obj, size_t size)
     {
         FILE *f = fopen(path, "rb");
         if (!f)
-            return false;
+        {
+            // coupure entre l'effacement et le renommage d'un Batch : la version .tmp est complète
+            char tmp[MAX_PATH_LEN];
+            snprintf(tmp, sizeof(tmp), "%s%s", path, TMP_SUFFIX);
+            f = fopen(tmp, "rb");
+            if (!f)
+                return false;
+        }
         size_t n = fread(obj, 1, size, f);
         fclose(f);
         return n == size;
@@ -26,6 +38,25 @@ namespace persist
         return n == size;
     }
 
- 
+    /**
+     * Ecriture groupée de plusieurs structures : tout est d'abord écrit dans des
+     * fichiers .tmp ; si un seul échoue rien n'est remplacé. Les renommages ne
+     * se font qu'ensuite, tous d'un coup.
+     */
+    class Batch
+    {
+    public:
+        // Copie les octets : l'objet peut changer après l'appel
+        void add(const char *path, const void *obj, size_t size);
+        bool commit();
+        size_t size() const { return entries_.size(); }
 
-}
\ No newline at end of file
+    private:
+        struct Entry
+        {
+            char path[MAX_PATH_LEN];
+            std::vector<uint8_t> data;
+        };
+        std::vector<Entry> entries_;
+    };
+}
@@ -0,0 +1,495 @@
+#include "DeviceShadow.h"
+#ifdef CONFIG_IOT_SHADOW_ENABLE
+#include <cstdlib>
+#include <cstring>
+#include "esp_log.h"
+#include "LedManager.h"
+#include "MqttClient.hpp"
+#include "WiFiConfig.h"
+#include "persistence.h"
+#include "utils.h"
+
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+#include "camera_controller.h"
+#endif
+
+// ============================
+// SECTIONS
+// ============================
+static bool led_report(cJSON *out)
+{
+    cJSON_AddNumberToObject(out, "on", LedManager::getInstance().isOn());
+    return true;
+}
+
+static bool led_apply(const cJSON *state)
+{
+    const cJSON *on = cJSON_GetObjectItemCaseSensitive(state, "on");
+    if (!cJSON_IsNumber(on) && !cJSON_IsBool(on))
+        return false;
+    bool value = cJSON_IsBool(on) ? cJSON_IsTrue(on) : on->valueint != 0;
+    if (value)
+        LedManager::getInstance().on();
+    else
+        LedManager::getInstance().off();
+    return true;
+}
+
+static bool camera_report(cJSON *out)
+{
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+    auto &cam = camera_controller::CameraController::getInstance();
+    return cam.isInitialized() && cam.fill_json(out);
+#else
+    return false;
+#endif
+}
+
+static bool camera_apply(const cJSON *state)
+{
+#ifdef CONFIG_IOT_FEATURE_CAMERA
+    auto &cam = camera_controller::CameraController::getInstance();
+    if (!cam.isInitialized())
+        return false;
+    bool ok = cam.patch_json(state);
+    cam.request_save();
+    return ok;
+#else
+    return false;
+#endif
+}
+
+// Les mots de passe ne sont jamais reportés
+static bool wifi_report(cJSON *out)
+{
+    auto &cfg = WiFiConfig::getInstance();
+    const net_ap_config_t *ap = cfg.get_ap();
+    const net_sta_config_t *sta = cfg.get_sta();
+
+    cJSON *j_ap = cJSON_AddObjectToObject(out, "ap");
+    cJSON_AddStringToObject(j_ap, "ssid", ap->ssid);
+    cJSON_AddNumberToObject(j_ap, "channel", ap->channel);
+    cJSON_AddNumberToObject(j_ap, "max_connection", ap->max_connection);
+
+    // même forme que le desired : [{"ssid":"home"}], password en option à l'écriture
+    cJSON *arr = cJSON_AddArrayToObject(out, "stations");
+    for (size_t i = 0; i < sta->count && i < WIFI_MAX_NETWORKS; ++i)
+    {
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "ssid", sta->credentials[i].ssid);
+        cJSON_AddItemToArray(arr, item);
+    }
+    return true;
+}
+
+static void copy_str(char *dst, size_t len, const cJSON *item)
+{
+    if (cJSON_IsString(item))
+    {
+        strncpy(dst, item->valuestring, len - 1);
+        dst[len - 1] = '\0';
+    }
+}
+
+// Absent ou chaîne qui tient dans len (terminateur compris)
+static bool optional_str(const cJSON *item, size_t len)
+{
+    return !item || (cJSON_IsString(item) && strlen(item->valuestring) < len);
+}
+
+static bool optional_range(const cJSON *item, int min, int max)
+{
+    return !item || (cJSON_IsNumber(item) && item->valuedouble >= min && item->valuedouble <= max);
+}
+
+// Section refusée en bloc si un champ est invalide : rien n'est appliqué ni sauvé
+static bool wifi_ap_apply(const cJSON *j_ap)
+{
+    auto &cfg = WiFiConfig::getInstance();
+    const cJSON *ssid = cJSON_GetObjectItemCaseSensitive(j_ap, "ssid");
+    const cJSON *pwd = cJSON_GetObjectItemCaseSensitive(j_ap, "password");
+    const cJSON *chn = cJSON_GetObjectItemCaseSensitive(j_ap, "channel");
+    const cJSON *max = cJSON_GetObjectItemCaseSensitive(j_ap, "max_connection");
+    if (!optional_str(ssid, WIFI_MAX_SSID_LEN) || !optional_str(pwd, WIFI_MAX_PASS_LEN) ||
+        !optional_range(chn, 1, 13) || !optional_range(max, 1, 10))
+        return false;
+
+    net_ap_config_t ap = *cfg.get_ap();
+    copy_str(ap.ssid, sizeof(ap.ssid), ssid);
+    copy_str(ap.password, sizeof(ap.password), pwd);
+    if (chn)
+        ap.channel = (uint8_t)chn->valueint;
+    if (max)
+        ap.max_connection = (uint8_t)max->valueint;
+    if (!WiFiConfig::ap_valid(&ap))
+        return false;
+    cfg.update_ap(&ap);
+    cfg.task_save_ap();
+    return true;
+}
+
+// Un réseau sans "password" garde le mot de passe enregistré pour ce SSID
+static bool wifi_sta_apply(const cJSON *j_sta)
+{
+    auto &cfg = WiFiConfig::getInstance();
+    if (cJSON_GetArraySize(j_sta) > WIFI_MAX_NETWORKS)
+        return false;
+
+    const net_sta_config_t *current = cfg.get_sta();
+    net_sta_config_t sta = {};
+    const cJSON *item;
+    cJSON_ArrayForEach(item, j_sta)
+    {
+        const cJSON *ssid = cJSON_GetObjectItemCaseSensitive(item, "ssid");
+        const cJSON *pwd = cJSON_GetObjectItemCaseSensitive(item, "password");
+        if (!cJSON_IsObject(item) || !cJSON_IsString(ssid) || !ssid->valuestring[0] ||
+            !optional_str(ssid, WIFI_MAX_SSID_LEN) || !optional_str(pwd, WIFI_MAX_PASS_LEN))
+            return false;
+
+        net_credential_t &c = sta.credentials[sta.count++];
+        copy_str(c.ssid, sizeof(c.ssid), ssid);
+        if (pwd)
+        {
+            copy_str(c.password, sizeof(c.password), pwd);
+            continue;
+        }
+        for (size_t i = 0; i < current->count && i < WIFI_MAX_NETWORKS; ++i)
+        {
+            if (strncmp(current->credentials[i].ssid, c.ssid, sizeof(c.ssid)) == 0)
+            {
+                memcpy(c.password, current->credentials[i].password, sizeof(c.password));
+                break;
+            }
+        }
+    }
+    cfg.update_sta(&sta);
+    cfg.task_save_sta();
+    return true;
+}
+
+static bool wifi_apply(const cJSON *state)
+{
+    bool ok = true;
+    const cJSON *j_ap = cJSON_GetObjectItemCaseSensitive(state, "ap");
+    if (j_ap)
+        ok = cJSON_IsObject(j_ap) && wifi_ap_apply(j_ap);
+
+    const cJSON *j_sta = cJSON_GetObjectItemCaseSensitive(state, "stations");
+    if (j_sta)
+        ok = cJSON_IsArray(j_sta) && wifi_sta_apply(j_sta) && ok;
+    return ok;
+}
+
+static bool mqtt_report(cJSON *out)
+{
+    const mqtt_client_config_t &cfg = MqttClient::getConfig();
+    cJSON_AddStringToObject(out, "broker_uri", cfg.broker_uri);
+    cJSON_AddStringToObject(out, "username", cfg.username);
+    cJSON_AddStringToObject(out, "client_id", cfg.client_id);
+    cJSON_AddBoolToObject(out, "enabled", cfg.enabled);
+    return true;
+}
+
+// Prise en compte au prochain démarrage du client ; rien n'est appliqué si invalide
+static bool mqtt_apply(const cJSON *state)
+{
+    mqtt_client_config_t cfg = MqttClient::getConfig();
+    copy_str(cfg.broker_uri, sizeof(cfg.broker_uri), cJSON_GetObjectItemCaseSensitive(state, "broker_uri"));
+    copy_str(cfg.username, sizeof(cfg.username), cJSON_GetObjectItemCaseSensitive(state, "username"));
+    copy_str(cfg.password, sizeof(cfg.password), cJSON_GetObjectItemCaseSensitive(state, "password"));
+    copy_str(cfg.client_id, sizeof(cfg.client_id), cJSON_GetObjectItemCaseSensitive(state, "client_id"));
+    const cJSON *enabled = cJSON_GetObjectItemCaseSensitive(state, "enabled");
+    if (cJSON_IsBool(enabled))
+        cfg.enabled = cJSON_IsTrue(enabled);
+    // même règle que /iot/config : sans broker, le noeud ne serait plus joignable
+    // qu'avec un accès physique
+    if (cfg.enabled && !cfg.broker_uri[0])
+        return false;
+    MqttClient::setConfig(cfg);
+    return true;
+}
+
+const DeviceShadow::SectionDef DeviceShadow::SECTIONS[SECTION_COUNT] = {
+    {"led", led_report, led_apply},
+    {"camera", camera_report, camera_apply},
+    {"wifi", wifi_report, wifi_apply},
+    {"mqtt", mqtt_report, mqtt_apply},
+};
+
+// ============================
+// SHADOW
+// ============================
+DeviceShadow &DeviceShadow::getInstance()
+{
+    static DeviceShadow instance;
+    return instance;
+}
+
+void DeviceShadow::start()
+{
+    if (started_)
+        return;
+
+    base_topic_ = std::string(CONFIG_IOT_SHADOW_TOPIC_PREFIX) + "/" + utils::device_id();
+
+    for (uint8_t i = 0; i < SECTION_COUNT; ++i)
+    {
+        std::string topic = base_topic_ + "/desired/" + SECTIONS[i].name;
+        Section section = static_cast<Section>(i);
+        MqttClient::getInstance().registerSubscriber(topic.c_str(), nullptr,
+                                                     [section](const char *, const char *payload, int len) -> std::string
+                                                     {
+                                                         DeviceShadow::getInstance().onDesired(section, payload, len);
+                                                         return "";
+                                                     });
+    }
+
+    xTaskCreate(shadow_task, "shadow_task", 4096, this, tskIDLE_PRIORITY + 2, &task_);
+    started_ = true;
+    ESP_LOGI(TAG, "Shadow on %s", base_topic_.c_str());
+}
+
+void DeviceShadow::load()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!persist::load_struct(SHADOW_CFG_PATH, &versions_, sizeof(versions_)))
+    {
+        ESP_LOGW(TAG, "No shadow versions, starting from 0");
+        versions_ = {};
+    }
+    versions_.boot_count++;
+    // les versions d'un bloc réservé mais pas entièrement utilisé sont perdues
+    reported_ = versions_.reported;
+    versions_.reported += REPORTED_BLOCK;
+    loaded_ = true;
+    xTaskCreate(save_task, "shadow_save", 3072, nullptr, tskIDLE_PRIORITY + 1, nullptr);
+}
+
+void DeviceShadow::save_task(void *)
+{
+    auto &instance = DeviceShadow::getInstance();
+    shadow_versions_t copy;
+    {
+        std::lock_guard<std::mutex> lock(instance.mutex_);
+        copy = instance.versions_;
+    }
+    persist::save_struct(SHADOW_CFG_PATH, &copy, sizeof(copy));
+    vTaskDelete(nullptr);
+}
+
+void DeviceShadow::notifyChanged(Section section)
+{
+    if (section >= SECTION_COUNT)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sections_[section].dirty = true;
+    }
+    if (task_)
+        xTaskNotifyGive(task_);
+}
+
+// Appelé depuis la tâche MQTT
+void DeviceShadow::onDesired(Section section, const char *payload, int len)
+{
+    size_t v_len = 0;
+    const char *v = utils::json_peek_raw(payload, len, "v", &v_len);
+    if (!v || v[0] < '0' || v[0] > '9')
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.invalid++;
+        return;
+    }
+    uint32_t version = strtoul(v, nullptr, 10);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (version <= versions_.desired[section])
+        {
+            stats_.stale++;
+            return;
+        }
+    }
+
+    cJSON *root = cJSON_ParseWithLength(payload, len);
+    const cJSON *state = cJSON_GetObjectItemCaseSensitive(root, "state");
+    if (!cJSON_IsObject(state))
+    {
+        cJSON_Delete(root);
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.invalid++;
+        return;
+    }
+
+    // La version est consommée même en cas d'échec partiel, pour ne pas boucler
+    if (!SECTIONS[section].apply(state))
+        ESP_LOGW(TAG, "Desired %s v%lu partially applied", SECTIONS[section].name, (unsigned long)version);
+    cJSON_Delete(root);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        versions_.desired[section] = version;
+        sections_[section].dirty = true;
+        stats_.applied++;
+    }
+    xTaskCreate(save_task, "shadow_save", 3072, nullptr, tskIDLE_PRIORITY + 1, nullptr);
+    if (task_)
+        xTaskNotifyGive(task_);
+}
+
+// Sous mutex_ ; réserve le bloc suivant avant d'en épuiser le dernier numéro
+uint32_t DeviceShadow::nextReportedVersion()
+{
+    if (++reported_ >= versions_.reported)
+    {
+        versions_.reported = reported_ + REPORTED_BLOCK;
+        xTaskCreate(save_task, "shadow_save", 3072, nullptr, tskIDLE_PRIORITY + 1, nullptr);
+    }
+    return reported_;
+}
+
+// Objet contenant uniquement les clés de cur absentes ou différentes dans last
+cJSON *DeviceShadow::diff(const cJSON *last, const cJSON *cur)
+{
+    cJSON *delta = nullptr;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, cur)
+    {
+        const cJSON *prev = cJSON_GetObjectItemCaseSensitive(last, item->string);
+        if (prev && cJSON_Compare(prev, item, true))
+            continue;
+        if (!delta)
+            delta = cJSON_CreateObject();
+        cJSON_AddItemToObject(delta, item->string, cJSON_Duplicate(item, true));
+    }
+    return delta;
+}
+
+bool DeviceShadow::publishState(const char *topic, uint32_t version, const char *key, cJSON *state, bool retain)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return false;
+    cJSON_AddNumberToObject(root, "v", version);
+    cJSON *container = root;
+    if (key)
+        container = cJSON_AddObjectToObject(root, "state");
+    cJSON_AddItemReferenceToObject(container, key ? key : "state", state);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json)
+        return false;
+    bool ok = MqttClient::getInstance().publish(topic, json, 1, retain);
+    cJSON_free(json);
+    return ok;
+}
+
+void DeviceShadow::sync()
+{
+    // avant FS_READY le compteur reported n'est pas encore relu
+    if (!loaded_ || !MqttClient::getInstance().isConnected())
+        return;
+
+    std::string delta_topic = base_topic_ + "/delta";
+    for (uint8_t i = 0; i < SECTION_COUNT; ++i)
+    {
+        const SectionDef &def = SECTIONS[i];
+        SectionState &st = sections_[i];
+
+        cJSON *cur = cJSON_CreateObject();
+        if (!cur || !def.report(cur))
+        {
+            cJSON_Delete(cur);
+            continue;
+        }
+
+        bool full;
+        uint32_t version;
+        cJSON *delta = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            full = st.force_full || !st.last;
+            if (!full)
+                delta = diff(st.last, cur);
+            st.dirty = false;
+            if (!full && !delta)
+            {
+                cJSON_Delete(cur);
+                continue;
+            }
+            version = nextReportedVersion();
+        }
+
+        std::string topic = base_topic_ + "/reported/" + def.name;
+        bool ok = publishState(topic.c_str(), version, nullptr, cur, true);
+        if (delta)
+        {
+            ok = publishState(delta_topic.c_str(), version, def.name, delta, false) && ok;
+            cJSON_Delete(delta);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ok) // on retentera un état complet au prochain passage
+        {
+            st.force_full = true;
+            cJSON_Delete(cur);
+            continue;
+        }
+        full ? stats_.full++ : stats_.deltas++;
+        st.force_full = false;
+        cJSON_Delete(st.last);
+        st.last = cur;
+    }
+}
+
+bool DeviceShadow::statsToJson(cJSON *obj)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cJSON_AddNumberToObject(obj, "boot", versions_.boot_count);
+    cJSON_AddNumberToObject(obj, "reported", reported_);
+    cJSON_AddNumberToObject(obj, "applied", stats_.applied);
+    cJSON_AddNumberToObject(obj, "stale", stats_.stale);
+    cJSON_AddNumberToObject(obj, "invalid", stats_.invalid);
+    cJSON_AddNumberToObject(obj, "deltas", stats_.deltas);
+    cJSON_AddNumberToObject(obj, "full", stats_.full);
+    cJSON *desired = cJSON_AddObjectToObject(obj, "desired");
+    for (uint8_t i = 0; i < SECTION_COUNT; ++i)
+        cJSON_AddNumberToObject(desired, SECTIONS[i].name, versions_.desired[i]);
+    return true;
+}
+
+void DeviceShadow::shadow_task(void *arg)
+{
+    auto &instance = *static_cast<DeviceShadow *>(arg);
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_IOT_SHADOW_POLL_MS));
+        instance.sync();
+    }
+}
+
+void DeviceShadow::on_event(const Event *evt)
+{
+    auto &instance = DeviceShadow::getInstance();
+    if (evt->type == EventType::BOOT_CAN_START)
+    {
+        instance.start();
+    }
+    else if (evt->type == EventType::FS_READY)
+    {
+        instance.load();
+    }
+    else if (evt->type == EventType::MQTT_CONNECTED)
+    {
+        // les publications faites hors connexion ont été perdues : état complet
+        {
+            std::lock_guard<std::mutex> lock(instance.mutex_);
+            for (auto &st : instance.sections_)
+                st.force_full = true;
+        }
+        if (instance.task_)
+            xTaskNotifyGive(instance.task_);
+    }
+}
+
+#endif // CONFIG_IOT_SHADOW_ENABLE
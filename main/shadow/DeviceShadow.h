@@ -0,0 +1,126 @@
+#pragma once
+#ifndef __DEVICE_SHADOW_H__
+#define __DEVICE_SHADOW_H__
+#include "sdkconfig.h"
+#ifdef CONFIG_IOT_SHADOW_ENABLE
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "cJSON.h"
+#include "event_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef CONFIG_IOT_FEATURE_SD
+#define SHADOW_CFG_PATH "/sd/shadow.bin"
+#else
+#define SHADOW_CFG_PATH "/fs/shadow.bin"
+#endif
+
+/**
+ * Device shadow : état "desired" (piloté à distance) et "reported" (état réel)
+ * par section (led, camera, wifi, mqtt).
+ *
+ *  <prefix>/<device_id>/desired/<section>   (abonné)   {"v":12,"state":{...partiel...}}
+ *  <prefix>/<device_id>/reported/<section>  (retained) {"v":N,"state":{...complet...}}
+ *  <prefix>/<device_id>/delta               (non retained, uniquement les clés modifiées)
+ *
+ * Un desired dont la version n'est pas strictement supérieure à la dernière
+ * appliquée est ignoré (détecté sur le payload brut, sans parse).
+ * Les versions desired sont persistées ; la version reported est un compteur
+ * 32 bits réservé par blocs en flash (REPORTED_BLOCK) : monotone entre
+ * redémarrages, au prix d'un saut d'au plus un bloc après un reboot.
+ */
+class DeviceShadow final
+{
+public:
+    static constexpr const char *TAG = "[SHADOW]";
+    static constexpr uint32_t REPORTED_BLOCK = 256;
+
+    enum Section : uint8_t
+    {
+        LED,
+        CAMERA,
+        WIFI,
+        MQTT,
+        SECTION_COUNT
+    };
+
+    static DeviceShadow &getInstance();
+    DeviceShadow(const DeviceShadow &) = delete;
+    DeviceShadow &operator=(const DeviceShadow &) = delete;
+
+    // Demande une synchro immédiate du reported (sinon périodique)
+    void notifyChanged(Section section);
+    bool statsToJson(cJSON *obj);
+
+private:
+    struct SectionDef
+    {
+        const char *name;
+        bool (*report)(cJSON *out);
+        bool (*apply)(const cJSON *state);
+    };
+
+    struct shadow_versions_t
+    {
+        uint32_t boot_count;
+        uint32_t reported;     // versions reported réservées jusqu'ici (exclu)
+        uint32_t desired[SECTION_COUNT];
+    };
+
+    struct SectionState
+    {
+        cJSON *last;           // dernier reported publié
+        bool dirty;
+        bool force_full;
+    };
+
+    struct Stats
+    {
+        uint32_t applied;
+        uint32_t stale;
+        uint32_t invalid;
+        uint32_t deltas;
+        uint32_t full;
+    };
+
+    static const SectionDef SECTIONS[SECTION_COUNT];
+
+    DeviceShadow() = default;
+
+    void start();
+    void load();
+    void sync();
+    void onDesired(Section section, const char *payload, int len);
+    bool publishState(const char *topic, uint32_t version, const char *key, cJSON *state, bool retain);
+    uint32_t nextReportedVersion();
+
+    static cJSON *diff(const cJSON *last, const cJSON *cur);
+    static void shadow_task(void *arg);
+    static void save_task(void *arg);
+    static void on_event(const Event *evt);
+
+    std::mutex mutex_;
+    std::string base_topic_;
+    TaskHandle_t task_ = nullptr;
+    bool started_ = false;
+    bool loaded_ = false;
+    uint32_t reported_ = 0; // dernière version reported publiée
+    shadow_versions_t versions_ = {};
+    SectionState sections_[SECTION_COUNT] = {};
+    Stats stats_ = {};
+
+    struct register_event_bus
+    {
+        register_event_bus()
+        {
+            EventBus::getInstance().subscribe(on_event, TAG);
+        }
+    };
+    inline static register_event_bus register_event_bus_;
+};
+
+#endif // CONFIG_IOT_SHADOW_ENABLE
+#endif
@@ -139,8 +139,6 @@ enum class EventType : uint8_t
     MQTT_CONFIG_POST_ANSWER,
     MQTT_POST_REQUEST,
     MQTT_POST_ANSWER,
-    MQTT_STATUS_REQUEST_JSON,
-    MQTT_STATUS_ANSWER_JSON,
     MQTT_CONNECTED_REQUEST,
     MQTT_CONNECTED,
     MQTT_DISCONNECTED,
@@ -149,8 +147,12 @@ enum class EventType : uint8_t
     // MQTT_CONFIG_UPDATE,
     MQTT_MESSAGE,
     HTTPD_START,
+    HTTP_REQUEST_RELEASE, // handler expiré : libère queue de réponse + buffer body (data = slot)
+    CONFIG_BULK_APPLY,    // /iot/config : applique la transaction en attente (user_ctx = queue de réponse)
+    CONFIG_BULK_APPLIED,
 
     CAMERA_INIT_DONE,
+    CAMERA_MOTION, // data = camera_motion_t, émis au début et à la fin d'un mouvement
 
     // etc.
 };
@@ -167,6 +169,22 @@ struct Event
     // size_t user_ctx_len;
 };
 
+// Corps HTTP passé par référence dans Event::data (buffer du pool api/http_body,
+// valide pendant le traitement de l'event)
+struct http_body_ref_t
+{
+    const char *data;
+    size_t len;
+    uint8_t slot;
+};
+
+struct camera_motion_t
+{
+    bool active;
+    uint16_t changed_blocks; // blocs au-dessus du seuil (pic pendant le mouvement pour la fin)
+    uint16_t total_blocks;
+};
+
 // enum class MqttStatus
 // {
 //     CONNECTED,
@@ -1,8 +1,10 @@
 #include "utils.h"
+#include "esp_mac.h"
 #include <random>
 #include <sstream>
 #include <iomanip>
 #include <string>
+#include <cstring>
 
 namespace utils
 {
@@ -63,4 +65,144 @@ namespace utils
         return std::string(buf);
     }
 
+    const char *event_body(const Event *evt, size_t *len)
+    {
+        if (!evt || evt->data_len != sizeof(http_body_ref_t))
+            return nullptr;
+        http_body_ref_t ref;
+        memcpy(&ref, evt->data, sizeof(ref));
+        if (len)
+            *len = ref.len;
+        return ref.data;
+    }
+
+    const char *device_id()
+    {
+        static char id[13] = {};
+        if (!id[0])
+        {
+            uint8_t mac[6] = {};
+            esp_read_mac(mac, ESP_MAC_WIFI_STA);
+            snprintf(id, sizeof(id), "%02x%02x%02x%02x%02x%02x",
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        }
+        return id;
+    }
+
+    // Petit scanner JSON sans allocation : on ne descend jamais dans les valeurs,
+    // on se contente de sauter les tokens jusqu'à la clé recherchée.
+    static size_t skip_ws(const char *p, size_t i, size_t len)
+    {
+        while (i < len && (p[i] == ' ' || p[i] == '\t' || p[i] == '\r' || p[i] == '\n'))
+            ++i;
+        return i;
+    }
+
+    // i pointe sur le '"' ouvrant ; renvoie l'index après le '"' fermant ou len si tronqué
+    static size_t skip_string(const char *p, size_t i, size_t len)
+    {
+        for (++i; i < len; ++i)
+        {
+            if (p[i] == '\\')
+                ++i;
+            else if (p[i] == '"')
+                return i + 1;
+        }
+        return len;
+    }
+
+    static size_t skip_value(const char *p, size_t i, size_t len)
+    {
+        if (i >= len)
+            return len;
+        if (p[i] == '"')
+            return skip_string(p, i, len);
+        if (p[i] == '{' || p[i] == '[')
+        {
+            int depth = 0;
+            while (i < len)
+            {
+                char c = p[i];
+                if (c == '"')
+                {
+                    i = skip_string(p, i, len);
+                    continue;
+                }
+                if (c == '{' || c == '[')
+                    ++depth;
+                else if (c == '}' || c == ']')
+                {
+                    if (--depth == 0)
+                        return i + 1;
+                }
+                ++i;
+            }
+            return len;
+        }
+        while (i < len && p[i] != ',' && p[i] != '}' && p[i] != ']' &&
+               p[i] != ' ' && p[i] != '\t' && p[i] != '\r' && p[i] != '\n')
+            ++i;
+        return i;
+    }
+
+    const char *json_peek_raw(const char *json, size_t len, const char *key, size_t *value_len)
+    {
+        if (!json || !key)
+            return nullptr;
+        size_t key_len = strlen(key);
+        size_t i = skip_ws(json, 0, len);
+        if (i >= len || json[i] != '{')
+            return nullptr;
+        ++i;
+
+        while (true)
+        {
+            i = skip_ws(json, i, len);
+            if (i >= len || json[i] != '"')
+                return nullptr;
+            size_t k_start = i + 1;
+            i = skip_string(json, i, len);
+            if (i >= len)
+                return nullptr;
+            size_t k_len = i - 1 - k_start;
+
+            i = skip_ws(json, i, len);
+            if (i >= len || json[i] != ':')
+                return nullptr;
+            i = skip_ws(json, i + 1, len);
+
+            size_t v_start = i;
+            i = skip_value(json, i, len);
+            if (i == v_start)
+                return nullptr;
+
+            if (k_len == key_len && memcmp(json + k_start, key, key_len) == 0)
+            {
+                if (value_len)
+                    *value_len = i - v_start;
+                return json + v_start;
+            }
+
+            i = skip_ws(json, i, len);
+            if (i >= len || json[i] != ',')
+                return nullptr;
+            ++i;
+        }
+    }
+
+    bool json_peek_string(const char *json, size_t len, const char *key, char *out, size_t out_len)
+    {
+        size_t v_len = 0;
+        const char *v = json_peek_raw(json, len, key, &v_len);
+        if (!v || v_len < 2 || v[0] != '"' || v[v_len - 1] != '"')
+            return false;
+
+        size_t n = v_len - 2;
+        if (n >= out_len || memchr(v + 1, '\\', n))
+            return false;
+        memcpy(out, v + 1, n);
+        out[n] = '\0';
+        return true;
+    }
+
 }
\ No newline at end of file
@@ -27,6 +27,16 @@ namespace utils
         return true;
     }
     std::string mac_to_string(const uint8_t *mac);
+    // Identifiant stable du noeud : MAC STA en hexa minuscule (12 caractères)
+    const char *device_id();
+    // Corps HTTP d'un event *_POST_REQUEST (http_body_ref_t), nullptr sinon
+    const char *event_body(const Event *evt, size_t *len);
+
+    // Lecture d'une clé de premier niveau sans construire d'arbre cJSON.
+    // Renvoie le token brut (ex: 42, "abc", {...}) ou nullptr si absent/invalide.
+    const char *json_peek_raw(const char *json, size_t len, const char *key, size_t *value_len);
+    // Copie la valeur string (sans échappement) d'une clé de premier niveau dans out.
+    bool json_peek_string(const char *json, size_t len, const char *key, char *out, size_t out_len);
 
 }
 
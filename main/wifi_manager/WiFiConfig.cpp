@@ -6,6 +6,7 @@
 #include "freertos/task.h"
 #include "utils.h"
 #include "macro.h"
+#include "snapshot.h"
 // void WiFiConfig::emitEvent(EventType type, void *user_ctx)
 // {
 //     Event e{};
@@ -29,6 +30,7 @@ static void async_load_sta(void *p)
         utils::emitEvent(EventType::STA_LOAD_FAIL, WiFiConfig::getInstance().get_sta());
         ESP_LOGW(WiFiConfig::TAG, "No STA.bin using default.");
     }
+    WiFiConfig::getInstance().publish_snapshots();
 
     vTaskDelete(NULL);
 }
@@ -45,6 +47,7 @@ static void async_load_ap(void *p)
         utils::emitEvent(EventType::AP_LOAD_FAIL, WiFiConfig::getInstance().get_ap());
         ESP_LOGW(WiFiConfig::TAG, "No AP.bin using default.");
     }
+    WiFiConfig::getInstance().publish_snapshots();
     vTaskDelete(NULL);
 }
 
@@ -55,7 +58,8 @@ void WiFiConfig::task_load_sta()
 static void save_sta(void *)
 {
     auto sta_cfg = WiFiConfig::getInstance().get_sta();
-    persist::save_struct(STA_CFG_PATH, &sta_cfg, sizeof(sta_cfg));
+    persist::save_struct(STA_CFG_PATH, sta_cfg, sizeof(*sta_cfg));
+    vTaskDelete(NULL);
 }
 void WiFiConfig::task_save_sta()
 {
@@ -65,7 +69,8 @@ void WiFiConfig::task_save_sta()
 static void save_ap(void *)
 {
     auto ap_cfg = WiFiConfig::getInstance().get_ap();
-    persist::save_struct(AP_CFG_PATH, &ap_cfg, sizeof(ap_cfg));
+    persist::save_struct(AP_CFG_PATH, ap_cfg, sizeof(*ap_cfg));
+    vTaskDelete(NULL);
 }
 
 void WiFiConfig::task_save_ap()
@@ -91,15 +96,26 @@ bool WiFiConfig::load_ap(void)
 void WiFiConfig::update_sta(const net_sta_config_t *cfg)
 {
     memcpy(&sta_cfg, cfg, sizeof(*cfg));
+    publish_snapshots();
     utils::emitEvent(EventType::STA_CHANGED, &sta_cfg);
 }
 
 void WiFiConfig::update_ap(const net_ap_config_t *cfg)
 {
     memcpy(&ap_cfg, cfg, sizeof(*cfg));
+    publish_snapshots();
     utils::emitEvent(EventType::AP_CHANGED, &ap_cfg);
 }
 
+void WiFiConfig::publish_snapshots()
+{
+    char json[512];
+    if (sta_to_json(json, sizeof(json)))
+        snapshot::publish(snapshot::Key::WIFI_STA, json, strlen(json));
+    if (ap_to_json(json, sizeof(json)))
+        snapshot::publish(snapshot::Key::WIFI_AP, json, strlen(json));
+}
+
 bool WiFiConfig::sta_to_json(char *out_buf, size_t buf_len)
 {
     auto sta_cfg = WiFiConfig::getInstance().get_sta();
@@ -208,6 +224,15 @@ bool WiFiConfig::ap_from_json(const char *json, net_ap_config_t *cfg)
     return false;
 }
 
+bool WiFiConfig::ap_valid(const net_ap_config_t *cfg)
+{
+    size_t pwd_len = strnlen(cfg->password, WIFI_MAX_PASS_LEN);
+    // WPA2 : vide (réseau ouvert) ou au moins 8 caractères
+    return cfg->ssid[0] && (pwd_len == 0 || pwd_len >= 8) &&
+           cfg->channel >= 1 && cfg->channel <= 13 &&
+           cfg->max_connection >= 1 && cfg->max_connection <= 10;
+}
+
 void WiFiConfig::on_event(const Event *evt)
 {
 
@@ -243,15 +268,19 @@ void WiFiConfig::on_event(const Event *evt)
     {
         if (evt->user_ctx)
         {
-            const char *json = reinterpret_cast<const char *>(evt->data);
+            // corps référencé dans le pool HTTP, pas recopié dans l'event
+            const char *json = utils::event_body(evt, nullptr);
             auto sta_cfg = WiFiConfig::getInstance().get_sta();
 
-            if (sta_from_json(json, sta_cfg))
+            if (json && sta_from_json(json, sta_cfg))
             {
+                WiFiConfig::getInstance().publish_snapshots();
                 WiFiConfig::getInstance().task_save_sta();
             }
             Event resp_evt{};
-            BIND_DATA_EVENT_JSON(resp_evt, json);
+            char answer[512];
+            sta_to_json(answer, sizeof(answer));
+            BIND_DATA_EVENT_JSON(resp_evt, answer);
             resp_evt.type = EventType::STA_POST_ANSWER;
             xQueueSend((QueueHandle_t)evt->user_ctx, &resp_evt, 0);
         }
@@ -260,13 +289,18 @@ void WiFiConfig::on_event(const Event *evt)
     {
         if (evt->user_ctx)
         {
-            char json[512];
-            if (WiFiConfig::getInstance().ap_to_json(json, sizeof(json)))
+            // le corps était ignoré et la réponse portait le mauvais type (le handler répondait 500)
+            const char *body = utils::event_body(evt, nullptr);
+            net_ap_config_t ap = *WiFiConfig::getInstance().get_ap();
+            if (body && ap_from_json(body, &ap))
             {
+                WiFiConfig::getInstance().update_ap(&ap);
                 WiFiConfig::getInstance().task_save_ap();
             }
+            char json[512];
+            ap_to_json(json, sizeof(json));
             Event resp_evt = {};
-            resp_evt.type = EventType::AP_ANSWER_JSON;
+            resp_evt.type = EventType::AP_POST_ANSWER;
             BIND_DATA_EVENT_JSON(resp_evt, json);
             // Envoie la réponse
             xQueueSend((QueueHandle_t)evt->user_ctx, &resp_evt, 0);
@@ -59,9 +59,10 @@ public:
 private:
     void task_load_ap();
     void task_load_sta();
-    void task_save_sta();
-    void task_save_ap();    
+
 public:
+    void task_save_sta();
+    void task_save_ap();
     // void emitEvent(EventType type, void *user_ctx = nullptr);
     bool load_sta();
     bool load_ap();
@@ -70,11 +71,15 @@ public:
 
     void update_sta(const net_sta_config_t *);
     void update_ap(const net_ap_config_t *);
+    // Rafraîchit les snapshots servis par GET /iot/wifi_sta et /iot/wifi_ap
+    void publish_snapshots();
 
     static bool sta_to_json(char *, size_t);
     static bool sta_from_json(const char *, net_sta_config_t *);
     static bool ap_to_json(char *, size_t);
     static bool ap_from_json(const char *, net_ap_config_t *);
+    // SSID non vide, canal 1-13, 1-10 clients, mot de passe WPA2 vide ou >= 8
+    static bool ap_valid(const net_ap_config_t *);
 };
 
 #endif
\ No newline at end of file
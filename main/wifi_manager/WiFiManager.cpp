@@ -3,6 +3,8 @@
 #include "utils.h"
 #include "event_bus.h"
 #include "esp_log.h"
+#include "cJSON.h"
+#include "snapshot.h"
 const net_ap_config_t *ap_cfg = nullptr;
 const net_sta_config_t *sta_cfg = nullptr;
 WiFiStatus g_status = WiFiStatus::INIT;
@@ -15,6 +17,49 @@ const int MAX_RETRY_PER_NETWORK = 3;
 bool g_ap_ready = false;
 bool g_sta_ready = false;
 bool g_sta_ap_ready = false;
+char g_sta_ip[16] = "";
+
+static const char *status_name(WiFiStatus status)
+{
+    switch (status)
+    {
+    case WiFiStatus::INIT:
+        return "INIT";
+    case WiFiStatus::AP_STARTED:
+        return "AP_STARTED";
+    case WiFiStatus::STA_CONNECTING:
+        return "STA_CONNECTING";
+    case WiFiStatus::STA_CONNECTED:
+        return "STA_CONNECTED";
+    case WiFiStatus::STA_DISCONNECTED:
+        return "STA_DISCONNECTED";
+    case WiFiStatus::ALL_STA_FAILED:
+        return "ALL_STA_FAILED";
+    default:
+        return "ERROR";
+    }
+}
+
+// Chaque changement d'état rafraîchit le snapshot de GET /iot/wifi_status
+static void set_status(WiFiStatus status)
+{
+    g_status = status;
+    if (status != WiFiStatus::STA_CONNECTED)
+        g_sta_ip[0] = '\0';
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return;
+    cJSON_AddStringToObject(root, "status", status_name(status));
+    cJSON_AddStringToObject(root, "ip", g_sta_ip);
+    bool on_sta = sta_cfg && g_current_sta_index < sta_cfg->count &&
+                  (status == WiFiStatus::STA_CONNECTING || status == WiFiStatus::STA_CONNECTED);
+    cJSON_AddStringToObject(root, "ssid", on_sta ? sta_cfg->credentials[g_current_sta_index].ssid : "");
+    cJSON_AddStringToObject(root, "ap_ssid", ap_cfg ? ap_cfg->ssid : "");
+    cJSON_AddBoolToObject(root, "all_sta_failed", g_all_sta_failed);
+    snapshot::publish(snapshot::Key::WIFI_STATUS, root);
+    cJSON_Delete(root);
+}
 
 WiFiManager &WiFiManager::getInstance()
 {
@@ -80,14 +125,14 @@ void WiFiManager::connect_next_sta()
     if (sta_cfg->count == 0)
     {
         ESP_LOGW(TAG, "No STA networks configured, AP only.");
-        g_status = WiFiStatus::ALL_STA_FAILED;
         g_all_sta_failed = true;
+        set_status(WiFiStatus::ALL_STA_FAILED);
         return;
     }
     if (g_current_sta_index >= sta_cfg->count)
     {
-        g_status = WiFiStatus::ALL_STA_FAILED;
         g_all_sta_failed = true;
+        set_status(WiFiStatus::ALL_STA_FAILED);
         ESP_LOGW(TAG, "All STA failed, AP only.");
         return;
     }
@@ -104,7 +149,7 @@ void WiFiManager::connect_next_sta()
     ESP_LOGI(TAG, "Trying STA[%d/%d]: %s", (int)g_current_sta_index + 1, (int)sta_cfg->count, net.ssid);
     esp_wifi_set_config(WIFI_IF_STA, &sta_wifi_cfg);
     esp_wifi_connect();
-    g_status = WiFiStatus::STA_CONNECTING;
+    set_status(WiFiStatus::STA_CONNECTING);
 }
 
 void WiFiManager::on_wifi_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
@@ -114,7 +159,7 @@ void WiFiManager::on_wifi_event(void *arg, esp_event_base_t event_base, int32_t
         switch (event_id)
         {
         case WIFI_EVENT_AP_START:
-            g_status = WiFiStatus::AP_STARTED;
+            set_status(WiFiStatus::AP_STARTED);
             ESP_LOGI(TAG, "AP started");
             break;
         case WIFI_EVENT_STA_START:
@@ -123,6 +168,7 @@ void WiFiManager::on_wifi_event(void *arg, esp_event_base_t event_base, int32_t
             WiFiManager::getInstance().connect_next_sta();
             break;
         case WIFI_EVENT_STA_DISCONNECTED:
+            set_status(WiFiStatus::STA_DISCONNECTED);
 
             if (g_current_retry < MAX_RETRY_PER_NETWORK)
             {
@@ -142,10 +188,11 @@ void WiFiManager::on_wifi_event(void *arg, esp_event_base_t event_base, int32_t
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
-        g_status = WiFiStatus::STA_CONNECTED;
         char s_sta_ip[16];
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
         snprintf(s_sta_ip, sizeof(s_sta_ip), IPSTR, IP2STR(&event->ip_info.ip));
+        strncpy(g_sta_ip, s_sta_ip, sizeof(g_sta_ip) - 1);
+        set_status(WiFiStatus::STA_CONNECTED);
         ESP_LOGI(TAG, "STA got IP: %s", s_sta_ip);
         iot_mqtt_status_t status{};
         strncpy(status.ip, s_sta_ip, sizeof(status.ip) - 1);